@@ -0,0 +1,458 @@
+//
+//  MIT No Attribution License
+//
+//  Copyright 2025, Soren Kragh
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the
+//  “Software”), to deal in the Software without restriction, including
+//  without limitation the rights to use, copy, modify, merge, publish,
+//  distribute, sublicense, and/or sell copies of the Software, and to
+//  permit persons to whom the Software is furnished to do so.
+//
+
+// Kernel microbenchmarks. Each per-point kernel of the build phase is run in
+// isolation on a deterministic synthetic stream; every kernel gets one
+// warm-up run followed by a number of timed runs, and the best and median
+// time per point is reported. This makes it possible to see the effect of a
+// change to a single hot loop without the noise of a full chartus run.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include <chart_source.h>
+#include <chart_ensemble.h>
+#include <chart_main.h>
+#include <chart_axis.h>
+#include <chart_series.h>
+#include <chart_legend_box.h>
+#include <chart_raster.h>
+
+using namespace SVG;
+using namespace Chart;
+
+////////////////////////////////////////////////////////////////////////////////
+
+Chart::Source source;
+Chart::Ensemble ensemble{ &source };
+
+// Results are accumulated here so that the compiler cannot discard the work.
+volatile double sink = 0;
+
+const double chart_w = 1000;
+const double chart_h = 600;
+
+size_t reps = 5;
+
+// Run fn (which processes n points) once for warm-up and then reps times,
+// and print the best and median time per point. The median is returned.
+double Measure( const char* name, size_t n, const std::function< void() >& fn )
+{
+  fn();
+  std::vector< double > ns;
+  for ( size_t r = 0; r < reps; ++r ) {
+    auto t0 = std::chrono::steady_clock::now();
+    fn();
+    auto t1 = std::chrono::steady_clock::now();
+    ns.push_back(
+      std::chrono::duration< double, std::nano >( t1 - t0 ).count() / n
+    );
+  }
+  std::sort( ns.begin(), ns.end() );
+  double best = ns.front();
+  double median = ns[ ns.size() / 2 ];
+  std::printf(
+    "%-24s %10zu %10.2f %10.2f %10.1f\n",
+    name, n, best, median, 1e3 / median
+  );
+  return median;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void show_help( void )
+{
+  std::cout << R"EOF(Usage: chartus-kbench [POINTS [REPS]]
+
+Run the per-point kernels of chartus in isolation on deterministic synthetic
+data and report the time per point. POINTS (default 1000000) is the number of
+points per run and REPS (default 5) the number of timed runs following a
+single warm-up run. One line is reported per kernel:
+
+  kernel points best_ns/pt median_ns/pt Mpt/s
+)EOF";
+  exit( 0 );
+}
+
+int main( int argc, char* argv[] )
+{
+  size_t n = 1000000;
+
+  for ( int i = 1; i < argc; ++i ) {
+    std::string a( argv[ i ] );
+    if ( a == "-h" || a == "--help" ) show_help();
+    char* end;
+    unsigned long long v = std::strtoull( a.c_str(), &end, 10 );
+    if ( *end != '\0' || v == 0 ) {
+      std::cerr << "*** ERROR: invalid argument '" << a << "'\n";
+      exit( 1 );
+    }
+    if ( i == 1 ) n = v; else
+    if ( i == 2 ) reps = v; else
+    {
+      std::cerr << "*** ERROR: too many arguments\n";
+      exit( 1 );
+    }
+  }
+
+  // Synthetic data in chart coordinates: a noisy random walk with monotone
+  // X-values (typical line/area series), uniformly scattered points, and
+  // random segments of which roughly half cross the chart area boundary.
+  std::mt19937 gen{ 16 };
+  std::normal_distribution< double > step{ 0.0, 1.0 };
+  std::uniform_real_distribution< double > rnd_x{ 0.0, chart_w };
+  std::uniform_real_distribution< double > rnd_y{ 0.0, chart_h };
+  std::uniform_real_distribution< double > rnd_u{ 0.0, 1.0 };
+
+  std::vector< Point > walk( n );
+  std::vector< Point > scatter( n );
+  std::vector< Point > seg( n + 1 );
+  std::vector< double > values( n );
+  {
+    double y = chart_h / 2;
+    for ( size_t i = 0; i < n; ++i ) {
+      y += step( gen );
+      y = std::clamp( y, 0.0, chart_h );
+      walk[ i ] = Point( i * chart_w / n, y );
+      scatter[ i ] = Point( rnd_x( gen ), rnd_y( gen ) );
+      values[ i ] = 1e-3 + rnd_u( gen ) * 1e6;
+    }
+    for ( auto& p : seg ) {
+      p = Point(
+        2 * rnd_x( gen ) - chart_w / 2,
+        2 * rnd_y( gen ) - chart_h / 2
+      );
+    }
+  }
+
+  ensemble.NewChart( 0, 0, 0, 0 );
+  Main* chart = ensemble.LastChart();
+
+  auto new_series = [&]( SeriesType type )
+  {
+    Series* s = chart->AddSeries( type );
+    s->axis_x = chart->axis_x;
+    s->axis_y = chart->axis_y[ 0 ];
+    s->chart_area.min.x = 0;
+    s->chart_area.max.x = chart_w;
+    s->chart_area.min.y = 0;
+    s->chart_area.max.y = chart_h;
+    s->SetPruneDist( 0.3 );
+    return s;
+  };
+
+  std::printf(
+    "%-24s %10s %10s %10s %10s\n",
+    "kernel", "points", "best_ns/pt", "median_ns/pt", "Mpt/s"
+  );
+
+  //----------------------------------------------------------------------------
+
+  {
+    Series* s = new_series( SeriesType::Line );
+    Series::prune_state_t ps;
+    Measure( "PrunePolyAdd", n, [&]() {
+      for ( const Point& p : walk ) s->PrunePolyAdd( ps, p );
+      s->PrunePolyEnd( ps );
+      sink = sink + ps.points.size();
+    } );
+    s->SetPruneM4();
+    Measure( "PrunePolyAdd(M4)", n, [&]() {
+      for ( const Point& p : walk ) s->PrunePolyAdd( ps, p );
+      s->PrunePolyEnd( ps );
+      sink = sink + ps.points.size();
+    } );
+  }
+
+  {
+    Series* s = new_series( SeriesType::Line );
+    Series::prune_state_t ps;
+    Measure( "PrunePointsAdd(Line)", n, [&]() {
+      for ( const Point& p : walk ) s->PrunePointsAdd( ps, p );
+      s->PrunePointsEnd( ps );
+      sink = sink + ps.points.size();
+    } );
+  }
+
+  {
+    Series* s = new_series( SeriesType::Scatter );
+    Series::prune_state_t ps;
+    Measure( "PrunePointsAdd(Scatter)", n, [&]() {
+      for ( const Point& p : scatter ) s->PrunePointsAdd( ps, p );
+      s->PrunePointsEnd( ps );
+      sink = sink + ps.points.size();
+    } );
+  }
+
+  {
+    // Ten million points, of which the first run holds POINTS points and the
+    // rest come in short runs as for a series with frequent gaps; the set of
+    // isolated points left large by the first run is cleared per run.
+    const size_t total = 10000000;
+    const size_t run = 16;
+    Series* s = new_series( SeriesType::Scatter );
+    Series::prune_state_t ps;
+    Measure( "PrunePointsAdd(Runs)", total, [&]() {
+      size_t cnt = 0;
+      for ( size_t i = 0; i < total; ++i ) {
+        if ( i >= n && i % run == 0 ) {
+          s->PrunePointsEnd( ps );
+          cnt += ps.points.size();
+        }
+        s->PrunePointsAdd( ps, scatter[ i % n ] );
+      }
+      s->PrunePointsEnd( ps );
+      sink = sink + cnt + ps.points.size();
+    } );
+  }
+
+  //----------------------------------------------------------------------------
+
+  {
+    Series* s = new_series( SeriesType::XY );
+    Measure( "ClipLine", n, [&]() {
+      Point c1;
+      Point c2;
+      int cnt = 0;
+      for ( size_t i = 0; i < n; ++i ) {
+        cnt += s->ClipLine( c1, c2, seg[ i ], seg[ i + 1 ] );
+      }
+      sink = sink + cnt;
+    } );
+  }
+
+  {
+    // A typical number of candidate legend boxes spread over the chart area.
+    std::vector< LegendBox > lb_list( 8 );
+    for ( size_t i = 0; i < lb_list.size(); ++i ) {
+      U x = (i % 4) * chart_w / 4 + 20;
+      U y = (i / 4) * chart_h / 2 + 20;
+      lb_list[ i ].bb.min.x = x;
+      lb_list[ i ].bb.min.y = y;
+      lb_list[ i ].bb.max.x = x + 150;
+      lb_list[ i ].bb.max.y = y + 80;
+    }
+    Series* s = new_series( SeriesType::XY );
+    s->lb_list = &lb_list;
+    Measure( "UpdateLegendBoxes", n, [&]() {
+      for ( size_t i = 1; i < n; ++i ) {
+        s->UpdateLegendBoxes( walk[ i - 1 ], walk[ i ] );
+      }
+      sink = sink + lb_list[ 0 ].weight2;
+    } );
+  }
+
+  //----------------------------------------------------------------------------
+
+  {
+    Axis* axis = chart->axis_x;
+    axis->length = chart_w;
+    axis->min = 1e-3;
+    axis->max = 1e6;
+    axis->log_scale = false;
+    Measure( "Axis::Coor", n, [&]() {
+      double sum = 0;
+      for ( double v : values ) sum += axis->Coor( v );
+      sink = sink + sum;
+    } );
+    axis->log_scale = true;
+    Measure( "Axis::Coor(log)", n, [&]() {
+      double sum = 0;
+      for ( double v : values ) sum += axis->Coor( v );
+      sink = sink + sum;
+    } );
+    // The form used by the per-datum loops of BuildLine() etc.
+    Measure( "Axis::Mapper", n, [&]() {
+      const Axis::Mapper< false > map( axis );
+      double sum = 0;
+      for ( double v : values ) sum += map.Coor( v );
+      sink = sink + sum;
+    } );
+    Measure( "Axis::Mapper(log)", n, [&]() {
+      const Axis::Mapper< true > map( axis );
+      double sum = 0;
+      for ( double v : values ) sum += map.Coor( v );
+      sink = sink + sum;
+    } );
+  }
+
+  //----------------------------------------------------------------------------
+
+  {
+    // Datum parsing works directly on the source buffers, so the data is
+    // written to a temporary file and read the same way chartus reads input.
+    char file_name[] = "/tmp/chartus-kbench-XXXXXX";
+    int fd = mkstemp( file_name );
+    if ( fd < 0 ) {
+      std::cerr << "*** ERROR: cannot create temporary file\n";
+      exit( 1 );
+    }
+    close( fd );
+    std::string text;
+    {
+      char buf[ num_buf_size ];
+      std::ofstream f( file_name, std::ios::binary );
+      for ( size_t i = 0; i < n; ++i ) {
+        std::string line;
+        line += FmtInt( buf, i );
+        line += ' ';
+        line += FmtFixed( buf, values[ i ], 3 );
+        line += '\n';
+        f << line;
+        text += line;
+      }
+    }
+    source.AddFile( file_name );
+    source.ReadFiles();
+    source.LoadLine();
+    Source::position_t start = source.cur_pos;
+
+    Measure( "Source::GetDatum", n, [&]() {
+      std::string_view x;
+      std::string_view y;
+      size_t len = 0;
+      source.cur_pos = start;
+      source.LoadLine();
+      for ( size_t i = 0; i < n; ++i ) {
+        source.GetDatum( x, y, false, 0 );
+        len += x.size() + y.size();
+        source.NextLine();
+        source.SkipWS( true );
+      }
+      sink = sink + len;
+    } );
+
+    // The views point into a private copy of the data, so that they stay
+    // valid independent of which source segments are loaded.
+    std::vector< std::string_view > svs;
+    svs.reserve( 2 * n );
+    for ( size_t b = 0; b < text.size(); ) {
+      size_t e = text.find_first_of( " \n", b );
+      svs.emplace_back( text.data() + b, e - b );
+      b = e + 1;
+    }
+    Series* s = new_series( SeriesType::XY );
+    Measure( "DatumToDouble", svs.size(), [&]() {
+      double sum = 0;
+      for ( auto sv : svs ) sum += s->DatumToDouble( sv );
+      sink = sink + sum;
+    } );
+
+    unlink( file_name );
+  }
+
+  //----------------------------------------------------------------------------
+
+  {
+    // Number to text conversion as done for the SVG and HTML output, through
+    // a string stream and through FmtFixed()/FmtShortest(). The throughput of
+    // the produced text is reported in MB/s.
+    auto report = [&]( const char* name, size_t bytes, double ns_per_value )
+    {
+      std::printf(
+        "%-24s %10zu bytes %10.1f MB/s\n",
+        name, bytes, bytes * 1e3 / (ns_per_value * n)
+      );
+    };
+    size_t bytes = 0;
+    double ns = Measure( "ostringstream", n, [&]() {
+      std::ostringstream oss;
+      for ( double v : values ) oss << v << ',';
+      bytes = oss.str().size();
+      sink = sink + bytes;
+    } );
+    report( "ostringstream", bytes, ns );
+    char buf[ num_buf_size ];
+    std::string out;
+    ns = Measure( "FmtShortest", n, [&]() {
+      out.clear();
+      for ( double v : values ) {
+        out += FmtShortest( buf, v );
+        out += ',';
+      }
+      sink = sink + out.size();
+    } );
+    report( "FmtShortest", out.size(), ns );
+    ns = Measure( "FmtFixed", n, [&]() {
+      out.clear();
+      for ( double v : values ) {
+        out += FmtFixed( buf, v, 3 );
+        out += ',';
+      }
+      sink = sink + out.size();
+    } );
+    report( "FmtFixed", out.size(), ns );
+  }
+
+  //----------------------------------------------------------------------------
+
+  {
+    // A line series drawn into PNG, once through the SVG text and once handed
+    // directly to the raster backend as done for PNG only output.
+    std::string head =
+      "<svg width=\"" + std::to_string( int( chart_w ) ) +
+      "\" height=\"" + std::to_string( int( chart_h ) ) + "\">\n"
+      "<g stroke=\"#4169e1\" stroke-width=\"1\" fill=\"none\">\n";
+    std::string tail = "</g>\n</svg>\n";
+    char buf[ num_buf_size ];
+    std::string text = head + "<polyline points=\"";
+    for ( const Point& p : walk ) {
+      text += FmtFixed( buf, p.x, 3 );
+      text += ',';
+      text += FmtFixed( buf, p.y, 3 );
+      text += ' ';
+    }
+    text += "\"/>\n" + tail;
+    Measure( "Raster(svg)", n, [&]() {
+      Raster raster;
+      raster.SetThreads( 1 );
+      raster.Render( text );
+      sink = sink + raster.width;
+    } );
+
+    RasterDirect direct;
+    {
+      RasterDirect::shape_t shape;
+      shape.paths.emplace_back();
+      for ( const Point& p : walk ) {
+        shape.paths.back().pts.push_back( { p.x, p.y } );
+      }
+      direct.Add( std::move( shape ) );
+    }
+    std::string placeholder =
+      head +
+      "<line x1=\"0\" y1=\"0\" x2=\"1\" y2=\"1\" stroke-dasharray=\"" +
+      std::to_string( int( RasterDirect::placeholder_dash ) ) + " 1\"/>\n" +
+      tail;
+    Measure( "Raster(direct)", n, [&]() {
+      Raster raster;
+      raster.SetThreads( 1 );
+      raster.Render( placeholder, &direct );
+      sink = sink + raster.width;
+    } );
+  }
+
+  source.Quit( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -663,12 +663,11 @@ U Axis::Coor( double v )
 int32_t Axis::ComputeDecimals( double v, bool update )
 {
   if ( v > -lim && v < lim ) v = 0;
-  std::ostringstream oss;
-  oss << std::fixed << std::setprecision( precision ) << v;
+  char buf[ num_buf_size ];
   int dp = -1;
   int nz = -1;
   int i = 0;
-  for ( const char c : oss.str() ) {
+  for ( const char c : FmtFixed( buf, v, precision ) ) {
     if ( c != '0' && dp >= 0 ) nz = i;
     if ( c == '.' && dp <  0 ) dp = i;
     i++;
@@ -779,9 +778,8 @@ void Axis::ComputeNumFormat( void )
     for ( double v : v_list ) {
       int32_t exp = NormalizeExponent( v );
       ComputeDecimals( v, true );
-      std::ostringstream oss;
-      oss << exp;
-      exp_max_len = std::max( exp_max_len, int32_t( oss.str().length() ) );
+      char buf[ 24 ];
+      exp_max_len = std::max( exp_max_len, int32_t( FmtInt( buf, exp ).length() ) );
     }
   }
 
@@ -805,10 +803,8 @@ void Axis::ComputeNumFormat( void )
 std::string Axis::NumToStr( double v, bool showpos )
 {
   int32_t dec = std::max( ComputeDecimals( v ), decimals );
-  std::ostringstream oss;
-  if ( showpos && v > 0 ) oss << '+';
-  oss << std::fixed << std::setprecision( dec ) << v;
-  return oss.str();
+  char buf[ num_buf_size ];
+  return std::string( FmtFixed( buf, v, dec, showpos ) );
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -880,9 +876,8 @@ SVG::Group* Axis::BuildNum( SVG::Group* g, double v, bool bold )
     if ( num == 0 ) {
       s = "";
     } else {
-      std::ostringstream oss;
-      oss << exp;
-      s = oss.str();
+      char buf[ 24 ];
+      s = FmtInt( buf, exp );
     }
     if ( angle != 0 || num != 0 ) {
       int32_t trailing_ws = exp_max_len - s.length();
@@ -130,6 +130,55 @@ public:
     return v == num_skip;
   }
 
+  // Coor() and Valid() for the per-datum loops of the series. The scale is
+  // fixed at compile time and the loop invariants are computed once, but the
+  // results are exactly those of Coor() and Valid().
+  template< bool LogScale >
+  class Mapper
+  {
+  public:
+    explicit Mapper( const Axis* axis )
+      : min( axis->min )
+      , max( axis->max )
+      , length( axis->length )
+      , reverse( axis->reverse )
+    {
+      if constexpr ( LogScale ) {
+        log_min = std::log10( min );
+        log_max = std::log10( max );
+      }
+    }
+
+    SVG::U Coor( double v ) const
+    {
+      double c = -coor_hi;
+      if constexpr ( LogScale ) {
+        if ( v > 0 ) {
+          c = (std::log10( v ) - log_min) * length / (log_max - log_min);
+        }
+      } else {
+        c = (v - min) * length / (max - min);
+      }
+      c = reverse ? (length - c) : c;
+      c = std::max( -coor_hi, c );
+      c = std::min( +coor_hi, c );
+      return c;
+    }
+
+    bool Valid( double v ) const
+    {
+      return std::abs( v ) <= num_hi && (!LogScale || v >= num_lo);
+    }
+
+  private:
+    double min;
+    double max;
+    double log_min = 0;
+    double log_max = 0;
+    SVG::U length;
+    bool reverse;
+  };
+
   void BuildTicksHelper(
     double v, SVG::U v_coor, int32_t sn, bool at_zero,
     SVG::U min_coor, SVG::U max_coor, SVG::U eps_coor,
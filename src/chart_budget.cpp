@@ -0,0 +1,298 @@
+//
+//  MIT No Attribution License
+//
+//  Copyright 2025, Soren Kragh
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the
+//  “Software”), to deal in the Software without restriction, including
+//  without limitation the rights to use, copy, modify, merge, publish,
+//  distribute, sublicense, and/or sell copies of the Software, and to
+//  permit persons to whom the Software is furnished to do so.
+//
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <queue>
+#include <sstream>
+
+#include <chart_budget.h>
+#include <chart_axis.h>
+#include <chart_series.h>
+#include <chart_hash.h>
+
+using namespace Chart;
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+// Rough costs of building the output and of the resulting SVG; the times are
+// for a machine where an iteration of the calibration loop below takes
+// calib_ns, and are scaled by the speed of the actual machine.
+constexpr double fixed_ms     = 5;        // Layout, axes, legends, etc.
+constexpr double fixed_bytes  = 16384;
+constexpr double datum_ns     = 60;       // Reading, scaling, and pruning.
+constexpr double point_ns     = 40;       // Point of a poly line.
+constexpr double point_bytes  = 14;
+constexpr double object_ns    = 250;      // Marker, bar, etc.
+constexpr double object_bytes = 70;
+constexpr double tag_ns       = 2000;     // Including the placement.
+constexpr double tag_bytes    = 220;
+constexpr double snap_bytes   = 40;       // HTML snap point.
+constexpr double calib_ns     = 58;
+
+// Keeps the result of the calibration loop alive.
+volatile double calib_sink = 0;
+
+// Per-datum work typical of reading and pruning: parse a number, scale it,
+// and look up the grid square of the point. Returns the best time per
+// iteration in nanoseconds.
+double CalibrationLoop( void )
+{
+  const char* nums[] = {
+    "0.125", "17", "-3.5e2", "1024.75", "6.02e23", "-0.0009", "42.5", "99999"
+  };
+  constexpr size_t iterations = 8192;
+  double best = 0;
+  for ( int r = 0; r < 3; ++r ) {
+    FlatMap< uint64_t, double > grid;
+    double sum = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for ( size_t i = 0; i < iterations; ++i ) {
+      const char* s = nums[ i % 8 ];
+      double d = 0;
+      std::from_chars( s, s + std::strlen( s ), d );
+      double c = std::clamp( (d + i) * 0.001, -1e6, 1e6 );
+      uint64_t key = static_cast< uint64_t >( std::abs( c ) + i / 4 );
+      sum += *grid.Insert( key, c ).first;
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    calib_sink = sum;
+    double ns =
+      std::chrono::duration< double, std::nano >( t1 - t0 ).count() /
+      iterations;
+    if ( r == 0 || ns < best ) best = ns;
+  }
+  return best;
+}
+
+// Speed of this machine relative to the one the times above are for, as a
+// factor to scale the times with; measured once per process.
+double SpeedFactor( void )
+{
+  static const double factor =
+    std::clamp( CalibrationLoop() / calib_ns, 0.1, 10.0 );
+  return factor;
+}
+
+// Prune distance used for series with pruning disabled once the level of
+// detail must be lowered; the same as the default of Series.Prune.
+constexpr SVG::U base_prune_dist = 0.3;
+
+// Main::Build() disables tags on series with more datums than this.
+constexpr size_t max_tagged = 10000;
+
+bool IsPoly( SeriesType type )
+{
+  return
+    type == SeriesType::XY ||
+    type == SeriesType::Line ||
+    type == SeriesType::Area ||
+    type == SeriesType::StackedArea;
+}
+
+bool HasMarkers( SeriesType type )
+{
+  return
+    IsPoly( type ) ||
+    type == SeriesType::Scatter ||
+    type == SeriesType::Point ||
+    type == SeriesType::Lollipop;
+}
+
+bool IsBar( SeriesType type )
+{
+  return
+    type == SeriesType::Bar ||
+    type == SeriesType::StackedBar ||
+    type == SeriesType::LayeredBar ||
+    type == SeriesType::Lollipop;
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+SVG::U Budget::PruneDist( const series_t& s, int level )
+{
+  if ( level == 0 ) return s.prune_dist;
+  SVG::U dist = std::max( s.prune_dist, base_prune_dist );
+  return std::min( 100.0, dist * std::ldexp( 1.0, level - 1 ) );
+}
+
+SVG::U Budget::MarkerThin( const series_t& s, int level )
+{
+  if ( level == 0 ) return 0;
+  return s.series->marker_size * std::ldexp( 0.5, level - 1 );
+}
+
+Budget::cost_t Budget::Estimate( const series_t& s, int level )
+{
+  const Series* series = s.series;
+  double n = series->datum_num;
+  SeriesType type = series->type;
+
+  // Number of poly line points, of objects such as markers and bars, and of
+  // tags in the output.
+  double points = 0;
+  double objects = 0;
+  double tags = 0;
+  if ( !series->density ) {
+    SVG::U dist = PruneDist( s, level );
+    bool pruned = dist >= series->prune_dist_min;
+    if ( IsPoly( type ) ) {
+      points = pruned ? std::min( n, 4 * s.width / dist ) : n;
+    }
+    if ( HasMarkers( type ) && series->marker_size > 0 ) {
+      // One marker at most in each square of the marker grid; the markers of
+      // a line mostly lie in a band along the line.
+      SVG::U grid =
+        std::max( pruned ? dist : SVG::U( 0 ), MarkerThin( s, level ) );
+      double markers = n;
+      if ( grid > 0 ) {
+        double rows = s.height / grid;
+        if ( type != SeriesType::Scatter && type != SeriesType::Point ) {
+          rows = std::min( rows, 8.0 );
+        }
+        markers = std::min( n, std::max( 1.0, s.width / grid ) * rows );
+      }
+      objects += markers;
+    }
+    if ( IsBar( type ) ) objects += n;
+    if ( level == 0 && s.tag_enable && n <= max_tagged ) tags = n;
+  }
+
+  cost_t cost;
+  cost.ms =
+    (n * datum_ns + points * point_ns + objects * object_ns + tags * tag_ns) *
+    SpeedFactor() / 1e6;
+  cost.bytes =
+    points * point_bytes + objects * object_bytes + tags * tag_bytes;
+  if ( ensemble->enable_html && series->snap_enable ) {
+    cost.bytes += (points + objects) * snap_bytes;
+  }
+  return cost;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Budget::Apply( double elapsed_ms, std::ostream& os )
+{
+  if ( !Enabled() ) return;
+
+  std::vector< series_t > list;
+  uint32_t chart_idx = 0;
+  for ( auto& elem : ensemble->grid.element_list ) {
+    Main* chart = elem.chart;
+    if ( chart == nullptr ) continue;
+    uint32_t series_idx = 0;
+    bool swap = chart->AxisX()->angle != 0;
+    for ( Series* series : chart->series_list ) {
+      series_t s;
+      s.series = series;
+      s.chart_idx = chart_idx;
+      s.series_idx = series_idx++;
+      s.width = swap ? chart->chart_h : chart->chart_w;
+      s.height = swap ? chart->chart_w : chart->chart_h;
+      s.prune_dist = series->prune_dist;
+      s.tag_enable = series->tag_enable;
+      list.push_back( s );
+    }
+    chart_idx++;
+  }
+
+  double avail_ms = max_ms - elapsed_ms;
+  auto fits = [&]( const cost_t& t )
+  {
+    return
+      (max_ms <= 0 || t.ms <= avail_ms) &&
+      (max_bytes == 0 || t.bytes <= max_bytes);
+  };
+
+  // The cost of each series at its current level; the total is kept up to
+  // date as the levels are lowered.
+  std::vector< cost_t > cost( list.size() );
+  cost_t t{ fixed_ms * SpeedFactor(), fixed_bytes };
+  for ( size_t i = 0; i < list.size(); ++i ) {
+    cost[ i ] = Estimate( list[ i ], 0 );
+    t.ms += cost[ i ].ms;
+    t.bytes += cost[ i ].bytes;
+  }
+
+  // Series ordered by the saving of their next level, weighing time and size
+  // by their budgets; among equal savings the first series comes first. Only
+  // the series whose level was lowered needs to be reconsidered.
+  using step_t = std::pair< double, int64_t >;
+  std::priority_queue< step_t > steps;
+  auto consider = [&]( size_t i )
+  {
+    if ( list[ i ].level == max_level ) return;
+    cost_t c = Estimate( list[ i ], list[ i ].level + 1 );
+    double saving = 0;
+    if ( max_ms > 0 ) saving += (cost[ i ].ms - c.ms) / max_ms;
+    if ( max_bytes > 0 ) saving += (cost[ i ].bytes - c.bytes) / max_bytes;
+    if ( saving > 0 ) steps.push( { saving, -static_cast< int64_t >( i ) } );
+  };
+  if ( !fits( t ) ) {
+    for ( size_t i = 0; i < list.size(); ++i ) consider( i );
+  }
+
+  // Repeatedly lower the level of detail of the series where the next level
+  // saves the most.
+  while ( !fits( t ) && !steps.empty() ) {
+    size_t i = -steps.top().second;
+    steps.pop();
+    list[ i ].level++;
+    cost_t c = Estimate( list[ i ], list[ i ].level );
+    t.ms += c.ms - cost[ i ].ms;
+    t.bytes += c.bytes - cost[ i ].bytes;
+    cost[ i ] = c;
+    consider( i );
+  }
+
+  // The report is written in one go, as concurrent renderings share stderr.
+  std::ostringstream txt;
+  for ( auto& s : list ) {
+    if ( s.level == 0 ) continue;
+    Series* series = s.series;
+    series->SetPruneDist( PruneDist( s, s.level ) );
+    series->SetMarkerThin( MarkerThin( s, s.level ) );
+    series->SetTagEnable( false );
+    txt
+      << "budget: chart " << s.chart_idx << " series " << s.series_idx;
+    if ( !series->name.empty() ) txt << " '" << series->name << "'";
+    txt
+      << ": " << series->datum_num << " datums, prune "
+      << series->prune_dist;
+    if ( series->marker_size > 0 ) {
+      txt << ", markers thinned to " << series->marker_thin;
+    }
+    if ( s.tag_enable ) txt << ", tags off";
+    txt << '\n';
+  }
+  txt
+    << "budget: estimated " << std::fixed << std::setprecision( 0 )
+    << std::max( 0.0, elapsed_ms ) + t.ms << " ms";
+  if ( max_ms > 0 ) txt << " of " << max_ms;
+  txt << ", " << t.bytes << " bytes";
+  if ( max_bytes > 0 ) txt << " of " << max_bytes;
+  txt << (fits( t ) ? "" : "; budget cannot be met") << '\n';
+  os << txt.str() << std::flush;
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,81 @@
+//
+//  MIT No Attribution License
+//
+//  Copyright 2025, Soren Kragh
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the
+//  “Software”), to deal in the Software without restriction, including
+//  without limitation the rights to use, copy, modify, merge, publish,
+//  distribute, sublicense, and/or sell copies of the Software, and to
+//  permit persons to whom the Software is furnished to do so.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include <chart_ensemble.h>
+
+namespace Chart {
+
+// Adaptive level of detail. Once the input is parsed, and before the output is
+// built, the level of detail of the series is lowered as needed for the build
+// to finish within a time budget and the output to stay within a size budget.
+// Both are estimated from the number of datums of each series by a simple
+// cost model. The lower levels first suppress tags, then prune the lines
+// harder and thin the markers, starting with the series where it saves the
+// most. Datums are still read and bars are still drawn one by one, so a time
+// budget below the cost of that cannot be met.
+class Budget
+{
+public:
+
+  Budget( Ensemble* ensemble ) : ensemble( ensemble ) {}
+
+  // Time for reading, parsing, and building, in milliseconds, and size of the
+  // output in bytes; 0 means no limit.
+  void SetTime( double ms ) { max_ms = ms; }
+  void SetBytes( uint64_t bytes ) { max_bytes = bytes; }
+
+  bool Enabled( void ) { return max_ms > 0 || max_bytes > 0; }
+
+  // Lower the level of detail of the series given that elapsed_ms have already
+  // been spent on reading and parsing; the chosen settings are reported on os.
+  void Apply( double elapsed_ms, std::ostream& os );
+
+private:
+
+  struct series_t {
+    Series* series;
+    uint32_t chart_idx;
+    uint32_t series_idx;
+    SVG::U width;               // Chart area.
+    SVG::U height;
+    SVG::U prune_dist;          // As given.
+    bool tag_enable;            // As given.
+    int level = 0;
+  };
+
+  struct cost_t {
+    double ms = 0;
+    double bytes = 0;
+  };
+
+  // Level 0 is the level of detail as given; level 1 suppresses the tags and
+  // thins the markers slightly, and each following level doubles the prune
+  // distance and the marker thinning.
+  static constexpr int max_level = 8;
+
+  SVG::U PruneDist( const series_t& s, int level );
+  SVG::U MarkerThin( const series_t& s, int level );
+  cost_t Estimate( const series_t& s, int level );
+
+  Ensemble* ensemble;
+  double max_ms = 0;
+  uint64_t max_bytes = 0;
+};
+
+}
@@ -0,0 +1,130 @@
+//
+//  MIT No Attribution License
+//
+//  Copyright 2025, Soren Kragh
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the
+//  “Software”), to deal in the Software without restriction, including
+//  without limitation the rights to use, copy, modify, merge, publish,
+//  distribute, sublicense, and/or sell copies of the Software, and to
+//  permit persons to whom the Software is furnished to do so.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include <unistd.h>
+
+#include <chart_cache.h>
+
+using namespace Chart;
+
+namespace fs = std::filesystem;
+
+////////////////////////////////////////////////////////////////////////////////
+
+Cache::Cache( const std::string& dir, uint64_t max_bytes )
+{
+  this->dir = dir;
+  this->max_bytes = max_bytes;
+  std::error_code ec;
+  fs::create_directories( dir, ec );
+  std::lock_guard< std::mutex > lk( mutex );
+  Evict( "" );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool Cache::Get( const std::string& key, std::string& out )
+{
+  fs::path entry = fs::path( dir ) / key;
+  std::ifstream f( entry, std::ios::binary );
+  if ( !f ) return false;
+  out.assign(
+    std::istreambuf_iterator< char >( f ), std::istreambuf_iterator< char >()
+  );
+  if ( f.bad() ) return false;
+
+  // Mark the entry as recently used.
+  std::error_code ec;
+  fs::last_write_time( entry, fs::file_time_type::clock::now(), ec );
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Cache::Put( const std::string& key, const std::string& out )
+{
+  // The temporary name is unique per process and thread.
+  static std::atomic< uint64_t > tmp_cnt{ 0 };
+  fs::path tmp =
+    fs::path( dir ) /
+    (".tmp." + std::to_string( getpid() ) + "." + std::to_string( tmp_cnt++ ));
+  {
+    std::ofstream f( tmp, std::ios::binary );
+    f << out;
+    f.close();
+    std::error_code ec;
+    if ( !f ) {
+      fs::remove( tmp, ec );
+      return;
+    }
+    fs::rename( tmp, fs::path( dir ) / key, ec );
+    if ( ec ) {
+      fs::remove( tmp, ec );
+      return;
+    }
+  }
+  std::lock_guard< std::mutex > lk( mutex );
+  total += out.size();
+  if ( total > max_bytes ) Evict( key );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Cache::Evict( const std::string& keep )
+{
+  struct entry_t {
+    fs::path path;
+    uint64_t size;
+    fs::file_time_type time;
+  };
+  std::vector< entry_t > entries;
+  total = 0;
+
+  // Entries may be removed by other processes at any time, so errors are
+  // simply skipped. The iterator is advanced with increment() as operator++
+  // throws on error.
+  std::error_code ec;
+  fs::directory_iterator it( dir, ec );
+  for ( ; !ec && it != fs::directory_iterator(); it.increment( ec ) ) {
+    std::string name = it->path().filename().string();
+    if ( name[ 0 ] == '.' ) continue;
+    std::error_code entry_ec;
+    entry_t e;
+    e.path = it->path();
+    e.size = it->file_size( entry_ec );
+    if ( entry_ec ) continue;
+    e.time = it->last_write_time( entry_ec );
+    if ( entry_ec ) continue;
+    total += e.size;
+    if ( name != keep ) entries.push_back( std::move( e ) );
+  }
+  if ( total <= max_bytes ) return;
+
+  uint64_t target = max_bytes - max_bytes / 4;
+  std::sort(
+    entries.begin(), entries.end(),
+    []( const entry_t& a, const entry_t& b ) { return a.time < b.time; }
+  );
+  for ( const auto& e : entries ) {
+    if ( total <= target ) break;
+    if ( fs::remove( e.path, ec ) ) total -= e.size;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,57 @@
+//
+//  MIT No Attribution License
+//
+//  Copyright 2025, Soren Kragh
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the
+//  “Software”), to deal in the Software without restriction, including
+//  without limitation the rights to use, copy, modify, merge, publish,
+//  distribute, sublicense, and/or sell copies of the Software, and to
+//  permit persons to whom the Software is furnished to do so.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace Chart {
+
+// Content addressed cache of generated output stored as one file per entry in
+// a directory. Entries are written to a temporary file and renamed into place,
+// so any number of processes and threads can use the same directory
+// concurrently. The modification time of an entry is refreshed on each hit,
+// and when the total size exceeds the limit the least recently used entries
+// are removed. The total size is tracked incrementally from the entries put
+// by this process, so the directory is only listed when the tracked size
+// exceeds the limit; entries put by other processes are accounted for then.
+// Eviction goes down to 3/4 of the limit, so that the listing is not repeated
+// for each following entry.
+class Cache
+{
+public:
+
+  Cache( const std::string& dir, uint64_t max_bytes );
+
+  // Returns true and the cached output in out if key exists.
+  bool Get( const std::string& key, std::string& out );
+
+  void Put( const std::string& key, const std::string& out );
+
+private:
+
+  // List the directory and remove the least recently used entries, except
+  // keep, until the total size is within 3/4 of the limit. The total is set
+  // to the resulting size. Called with mutex held.
+  void Evict( const std::string& keep );
+
+  std::string dir;
+  uint64_t max_bytes;
+
+  std::mutex mutex;
+  uint64_t total = 0;
+};
+
+}
@@ -118,3 +118,34 @@ bool Chart::NormalWidthUTF8( const std::string_view s )
 }
 
 ////////////////////////////////////////////////////////////////////////////////
+
+std::string_view Chart::FmtFixed(
+  char* buf, double v, int32_t decimals, bool showpos
+)
+{
+  char* p = buf;
+  if ( showpos && v > 0 ) *p++ = '+';
+  decimals = std::clamp( decimals, 0, 64 );
+  auto r =
+    std::to_chars(
+      p, buf + num_buf_size, v, std::chars_format::fixed, decimals
+    );
+  if ( r.ec != std::errc() ) {
+    r = std::to_chars( p, buf + num_buf_size, v );
+  }
+  return std::string_view( buf, r.ptr - buf );
+}
+
+std::string_view Chart::FmtShortest( char* buf, double v )
+{
+  auto r = std::to_chars( buf, buf + num_buf_size, v );
+  return std::string_view( buf, r.ptr - buf );
+}
+
+std::string_view Chart::FmtInt( char* buf, int64_t v )
+{
+  auto r = std::to_chars( buf, buf + 24, v );
+  return std::string_view( buf, r.ptr - buf );
+}
+
+////////////////////////////////////////////////////////////////////////////////
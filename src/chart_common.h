@@ -19,25 +19,8 @@
 #include <chrono>
 #include <cstdio>
 #include <limits>
-
-inline auto last_checkpoint_time = std::chrono::high_resolution_clock::now();
-
-#define PERF_CHECKPOINT( msg ) \
-  do { \
-    auto current_time = std::chrono::high_resolution_clock::now(); \
-    auto elapsed = std::chrono::duration_cast< std::chrono::microseconds >(current_time - last_checkpoint_time).count(); \
-    std::cerr << "[PERF] " << __FILE__ << ":" << __LINE__ << " - " \
-              << msg << ": " << elapsed << " μs since last checkpoint" << std::endl; \
-    std::cerr << "Press Enter to continue..." << std::flush; \
-    std::cin.clear(); \
-    std::cin.ignore( std::numeric_limits< std::streamsize >::max(), '\n' ); \
-    last_checkpoint_time = std::chrono::high_resolution_clock::now(); \
-  } while( 0 )
-
-#define PERF_RESET() \
-  do { \
-    last_checkpoint_time = std::chrono::high_resolution_clock::now(); \
-  } while( 0 )
+#include <charconv>
+#include <string_view>
 
 //------------------------------------------------------------------------------
 
@@ -151,11 +134,25 @@ namespace Chart {
   // characters.
   bool NormalWidthUTF8( const std::string_view s );
 
-  struct PointHash {
-    size_t operator()( const SVG::Point& p ) const {
-      size_t hx = std::hash< double >()( p.x );
-      size_t hy = std::hash< double >()( p.y );
-      return hx ^ (hy << 1);
-    }
-  };
+  // Number formatting through std::to_chars into a caller supplied buffer of
+  // num_buf_size characters; no streams and no heap allocation. The returned
+  // view points into the buffer.
+  constexpr size_t num_buf_size = 400;
+  std::string_view FmtFixed(
+    char* buf, double v, int32_t decimals, bool showpos = false
+  );
+  std::string_view FmtShortest( char* buf, double v );
+  std::string_view FmtInt( char* buf, int64_t v );
+
+  // Append to an output string without intermediate temporaries.
+  inline void AppendNum( std::string& out, double v )
+  {
+    char buf[ num_buf_size ];
+    out += FmtShortest( buf, v );
+  }
+  inline void AppendInt( std::string& out, int64_t v )
+  {
+    char buf[ 24 ];
+    out += FmtInt( buf, v );
+  }
 }
@@ -12,9 +12,14 @@
 //
 
 #include <chart_ensemble.h>
+#include <chart_raster.h>
 
 #include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
 #include <numeric>
+#include <thread>
 
 using namespace SVG;
 using namespace Chart;
@@ -29,6 +34,9 @@ Ensemble::Ensemble( Source* source )
   canvas->settings.indent = false;
   canvas->settings.math_coor = true;
   top_g = canvas->TopGroup()->AddNewGroup();
+  back_g = top_g->AddNewGroup();
+  charts_g = top_g->AddNewGroup();
+  decor_g = top_g->AddNewGroup();
   html_db = new HTML( this );
   legend_obj = new Legend( this );
   legend_obj->pos1 = Pos::Auto;
@@ -48,6 +56,9 @@ Ensemble::~Ensemble( void )
   delete legend_obj;
   delete html_db;
   delete canvas;
+  for ( auto& s : split_list ) {
+    delete s.canvas;
+  }
   delete annotate;
 }
 
@@ -73,7 +84,19 @@ bool Ensemble::NewChart(
   }
 
   Grid::element_t elem;
-  elem.chart = new Main( this, top_g->AddNewGroup() );
+  if ( split ) {
+    split_t s;
+    s.canvas = new Canvas();
+    s.canvas->settings.indent = false;
+    s.canvas->settings.math_coor = true;
+    s.top_g = s.canvas->TopGroup()->AddNewGroup();
+    split_list.push_back( s );
+    elem.chart = new Main( this, s.top_g->AddNewGroup() );
+  } else {
+    slots.push_back( charts_g->AddNewGroup() );
+    elem.chart = new Main( this, slots.back()->AddNewGroup() );
+  }
+  elem.chart->id = grid.element_list.size();
   html_db->NewChart( elem.chart );
 
   // Note that the Y grid coordinates are in normal bottom to top "mathematical"
@@ -364,6 +387,7 @@ void Ensemble::InitGrid( void )
 
 void Ensemble::SolveGrid( void )
 {
+  Profile::Scope prof( "Grid::Solve" );
   grid.Solve( grid.cell_list_x );
   grid.Solve( grid.cell_list_y );
 }
@@ -397,7 +421,7 @@ void Ensemble::BuildLegends( void )
   BoundaryBox build_bb;
   BoundaryBox moved_bb;
 
-  Group* legend_g = top_g->AddNewGroup();
+  Group* legend_g = decor_g->AddNewGroup();
   legend_g->Attr()->TextFont()->SetSize( 14 * legend_obj->size );
 
   bool boxed =
@@ -535,16 +559,16 @@ void Ensemble::BuildLegends( void )
     {
       uint32_t n = 1;
       for ( auto& h : holes ) {
-        top_g->Add( new Rect( h.bb.min, h.bb.max ) );
-        top_g->Last()->Attr()->SetLineWidth( 2 );
-        top_g->Last()->Attr()->FillColor()->Clear();
-        top_g->Last()->Attr()->LineColor()->Set( ColorName::red );
+        decor_g->Add( new Rect( h.bb.min, h.bb.max ) );
+        decor_g->Last()->Attr()->SetLineWidth( 2 );
+        decor_g->Last()->Attr()->FillColor()->Clear();
+        decor_g->Last()->Attr()->LineColor()->Set( ColorName::red );
         std::ostringstream oss;
         oss << n;
-        top_g->Add( new Text( oss.str() ) );
-        top_g->Last()->Attr()->TextFont()->SetSize( 20 );
-        top_g->Last()->Attr()->TextColor()->Set( ColorName::black );
-        top_g->Last()->MoveTo(
+        decor_g->Add( new Text( oss.str() ) );
+        decor_g->Last()->Attr()->TextFont()->SetSize( 20 );
+        decor_g->Last()->Attr()->TextColor()->Set( ColorName::black );
+        decor_g->Last()->MoveTo(
           AnchorX::Mid, AnchorY::Mid,
           (h.bb.min.x + h.bb.max.x) / 2,
           (h.bb.min.y + h.bb.max.y) / 2
@@ -665,28 +689,28 @@ void Ensemble::BuildTitle( void )
   U y = bb.max.y + dy;
   if ( !sub_sub_title.empty() ) {
     Object* obj =
-      Label::CreateLabel( top_g, sub_sub_title, 14 * title_size );
+      Label::CreateLabel( decor_g, sub_sub_title, 14 * title_size );
     obj->MoveTo( a, AnchorY::Min, x, y );
     bb = obj->GetBB();
     y += bb.max.y - bb.min.y + spacing;
   }
   if ( !sub_title.empty() ) {
-    Object* obj = Label::CreateLabel( top_g, sub_title, 20 * title_size );
+    Object* obj = Label::CreateLabel( decor_g, sub_title, 20 * title_size );
     obj->MoveTo( a, AnchorY::Min, x, y );
     bb = obj->GetBB();
     y += bb.max.y - bb.min.y + spacing;
   }
   if ( !title.empty() ) {
-    Object* obj = Label::CreateLabel( top_g, title, 36 * title_size );
+    Object* obj = Label::CreateLabel( decor_g, title, 36 * title_size );
     obj->MoveTo( a, AnchorY::Min, x, y );
     bb = obj->GetBB();
   }
 
   if ( title_line ) {
     bb = TopBB();
-    top_g->Add( new Line( bb.min.x + dx, line_y, bb.max.x - dx, line_y ) );
-    top_g->Last()->Attr()->LineColor()->Set( ForegroundColor() );
-    top_g->Last()->Attr()->SetLineWidth( 1 );
+    decor_g->Add( new Line( bb.min.x + dx, line_y, bb.max.x - dx, line_y ) );
+    decor_g->Last()->Attr()->LineColor()->Set( ForegroundColor() );
+    decor_g->Last()->Attr()->SetLineWidth( 1 );
   }
 
   return;
@@ -704,11 +728,11 @@ void Ensemble::BuildFootnotes( void )
 
   if ( footnote_line ) {
     dy = dy / 2;
-    top_g->Add( new Line(
+    decor_g->Add( new Line(
       bb.min.x + dx, bb.min.y - dy, bb.max.x - dx, bb.min.y - dy
     ) );
-    top_g->Last()->Attr()->LineColor()->Set( ForegroundColor() );
-    top_g->Last()->Attr()->SetLineWidth( 1 );
+    decor_g->Last()->Attr()->LineColor()->Set( ForegroundColor() );
+    decor_g->Last()->Attr()->SetLineWidth( 1 );
   }
 
   for ( const auto& footnote : footnotes ) {
@@ -718,8 +742,8 @@ void Ensemble::BuildFootnotes( void )
     U x = bb.min.x + dx;
     U y = bb.min.y - dy;
     AnchorX a = AnchorX::Min;
-    Label::CreateLabel( top_g, footnote.txt, 14 * footnote_size );
-    top_g->Last()->Attr()->TextColor()->Set( ForegroundColor() );
+    Label::CreateLabel( decor_g, footnote.txt, 14 * footnote_size );
+    decor_g->Last()->Attr()->TextColor()->Set( ForegroundColor() );
     if ( footnote.pos == Pos::Center ) {
       x = (bb.min.x + bb.max.x) / 2;
       a = AnchorX::Mid;
@@ -728,7 +752,7 @@ void Ensemble::BuildFootnotes( void )
       x = bb.max.x - dx;
       a = AnchorX::Max;
     }
-    top_g->Last()->MoveTo( a, AnchorY::Max, x, y );
+    decor_g->Last()->MoveTo( a, AnchorY::Max, x, y );
 
     dy = spacing;
   }
@@ -738,7 +762,16 @@ void Ensemble::BuildFootnotes( void )
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void Ensemble::BuildBackground( void )
+void Ensemble::AddExtent( const BoundaryBox& bb )
+{
+  back_g->Add( new Rect( bb.min, bb.max ) );
+  back_g->Last()->Attr()->FillColor()->Clear();
+  back_g->Last()->Attr()->LineColor()->Clear();
+  back_g->Last()->Attr()->SetLineWidth( 0 );
+  back_g->FrontToBack();
+}
+
+void Ensemble::BuildBackground( bool html_extent )
 {
   BoundaryBox top_bb = TopBB();
 
@@ -770,14 +803,15 @@ void Ensemble::BuildBackground( void )
     bb.min.y -= delta;
     bb.max.y += delta;
 
+    html_bb = bb;
     if ( enable_html ) {
       for ( auto& elem : grid.element_list ) {
         if ( elem.chart ) {
-          bb.Update(
+          html_bb.Update(
             elem.area_bb.min.x + elem.chart->g_dx,
             elem.area_bb.min.y + elem.chart->g_dy
           );
-          bb.Update(
+          html_bb.Update(
             elem.area_bb.max.x + elem.chart->g_dx,
             elem.area_bb.max.y + elem.chart->g_dy
           );
@@ -785,11 +819,7 @@ void Ensemble::BuildBackground( void )
       }
     }
 
-    top_g->Add( new Rect( bb.min, bb.max ) );
-    top_g->Last()->Attr()->FillColor()->Clear();
-    top_g->Last()->Attr()->LineColor()->Clear();
-    top_g->Last()->Attr()->SetLineWidth( 0 );
-    top_g->FrontToBack();
+    AddExtent( html_extent ? html_bb : bb );
   }
 
   if ( draw_bg ) {
@@ -800,14 +830,14 @@ void Ensemble::BuildBackground( void )
     bb.min.y -= padding + border_width / 2;
     bb.max.y += padding + border_width / 2;
 
-    top_g->Add( new Rect( bb.min, bb.max, border_radius ) );
-    top_g->Last()->Attr()->SetLineWidth( border_width );
+    back_g->Add( new Rect( bb.min, bb.max, border_radius ) );
+    back_g->Last()->Attr()->SetLineWidth( border_width );
     if ( border_width > 0 ) {
-      top_g->Last()->Attr()->LineColor()->Set( BorderColor() );
+      back_g->Last()->Attr()->LineColor()->Set( BorderColor() );
     } else {
-      top_g->Last()->Attr()->LineColor()->Clear();
+      back_g->Last()->Attr()->LineColor()->Clear();
     }
-    top_g->FrontToBack();
+    back_g->FrontToBack();
   }
 
   return;
@@ -847,29 +877,156 @@ void Ensemble::MoveCharts( void )
 
 ////////////////////////////////////////////////////////////////////////////////
 
-std::string Ensemble::Build( void )
+void Ensemble::SetTopAttr( Group* g )
 {
-  if ( Empty() ) {
-    NewChart( 0, 0, 0, 0 );
-  }
-
-  top_g->Attr()->TextFont()->SetFamily(
+  g->Attr()->TextFont()->SetFamily(
     "monospace"
   );
-  top_g->Attr()->TextFont()
+  g->Attr()->TextFont()
     ->SetWidthFactor( width_adj )
     ->SetHeightFactor( height_adj )
     ->SetBaselineFactor( baseline_adj );
-  top_g->Attr()->SetTextZeroToO( zero_to_o );
+  g->Attr()->SetTextZeroToO( zero_to_o );
+
+  g->Attr()->TextColor()->Set( ForegroundColor() );
+  g->Attr()->LineColor()->Set( ForegroundColor() );
+  g->Attr()->FillColor()->Set( BackgroundColor() );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string Ensemble::Build( void )
+{
+  std::ostringstream oss;
+  Build( oss );
+  return oss.str();
+}
+
+void Ensemble::Build( std::ostream& out )
+{
+  if ( enable_html ) {
+    Build( nullptr, &out, nullptr );
+  } else
+  if ( enable_png ) {
+    Build( nullptr, nullptr, &out );
+  } else {
+    Build( &out, nullptr, nullptr );
+  }
+}
+
+void Ensemble::reuse_t::Clear( void )
+{
+  for ( auto chart : charts ) delete chart;
+  charts.clear();
+  slots.clear();
+  delete canvas;
+  canvas = nullptr;
+}
+
+// Adopt the canvas of the kept charts with its decorations removed, and put
+// each chart either in place of the kept chart with the same key, or in its
+// slot emptied of the kept chart.
+void Ensemble::ReuseCharts( void )
+{
+  if (
+    reuse->canvas == nullptr || split || enable_html ||
+    reuse->charts.size() != grid.element_list.size()
+  ) {
+    reuse->Clear();
+    return;
+  }
+
+  // The new charts have been created in a canvas of their own, which is only
+  // deleted once they have been moved out of it.
+  Canvas* old_canvas = canvas;
+  canvas = reuse->canvas;
+  top_g = reuse->top_g;
+  charts_g = reuse->charts_g;
+  reuse->canvas = nullptr;
+
+  // Remove the background and decorations around the charts and add empty
+  // groups for them, in the same order: background, charts, decorations.
+  top_g->DeleteFront();
+  top_g->FrontToBack();
+  top_g->DeleteFront();
+  decor_g = top_g->AddNewGroup();
+  back_g = top_g->AddNewGroup();
+  top_g->FrontToBack();
+
+  slots = reuse->slots;
+  for ( size_t i = 0; i < grid.element_list.size(); ++i ) {
+    Main*& chart = grid.element_list[ i ].chart;
+    Main* kept = reuse->charts[ i ];
+    if (
+      kept && !chart->reuse_key.empty() && chart->reuse_key == kept->reuse_key
+    ) {
+      if ( last_chart == chart ) last_chart = kept;
+      std::replace(
+        html_db->main_list.begin(), html_db->main_list.end(), chart, kept
+      );
+      delete chart;
+      chart = kept;
+      chart->SetEnsemble( this );
+      chart->reused = true;
+      chart->Move( 0, 0 );
+    } else {
+      delete kept;
+      slots[ i ]->DeleteFront();
+      chart->svg_g = slots[ i ]->AddNewGroup();
+    }
+  }
+  reuse->charts.clear();
+  delete old_canvas;
+}
+
+// Move the canvas and the built charts to reuse; charts that were not built
+// through the canvas are not kept.
+void Ensemble::KeepCharts( void )
+{
+  reuse->Clear();
+  if ( split || enable_html ) return;
+  reuse->canvas = canvas;
+  reuse->top_g = top_g;
+  reuse->back_g = back_g;
+  reuse->charts_g = charts_g;
+  reuse->decor_g = decor_g;
+  reuse->slots = slots;
+  canvas = nullptr;
+  for ( auto& elem : grid.element_list ) {
+    Main* chart = elem.chart;
+    if ( chart && !chart->reused && raster_db != nullptr ) chart = nullptr;
+    reuse->charts.push_back( chart );
+    if ( chart ) {
+      elem.chart = nullptr;
+      if ( last_chart == chart ) last_chart = nullptr;
+    }
+  }
+}
+
+void Ensemble::Build( std::ostream* svg, std::ostream* html, std::ostream* png )
+{
+  if ( Empty() ) {
+    NewChart( 0, 0, 0, 0 );
+  }
 
-  top_g->Attr()->TextColor()->Set( ForegroundColor() );
-  top_g->Attr()->LineColor()->Set( ForegroundColor() );
-  top_g->Attr()->FillColor()->Set( BackgroundColor() );
+  if ( reuse ) ReuseCharts();
+
+  SetTopAttr( top_g );
+
+  // The geometry of the series only goes through the SVG text if the SVG text
+  // is output, or if the HTML output needs the snap points.
+  RasterDirect direct;
+  raster_db = (png && !svg && !html) ? &direct : nullptr;
 
   max_area_pad = 0;
   for ( auto& elem : grid.element_list ) {
     if ( elem.chart ) {
-      elem.chart->Build();
+      if ( elem.chart->reused ) {
+        elem.chart->AddGlobalLegends();
+      } else {
+        Profile::Scope prof( "Main::Build", elem.chart->id );
+        elem.chart->Build();
+      }
       U area_pad = elem.chart->GetAreaOverhang();
       max_area_pad = std::max( max_area_pad, area_pad );
     }
@@ -883,10 +1040,12 @@ std::string Ensemble::Build( void )
   SolveGrid();
 
   if ( legend_obj->grid_coor_specified ) {
+    Profile::Scope prof( "BuildLegends" );
     BuildLegends();
     MoveCharts();
   } else {
     MoveCharts();
+    Profile::Scope prof( "BuildLegends" );
     BuildLegends();
   }
 
@@ -898,9 +1057,12 @@ std::string Ensemble::Build( void )
       annotate->AddChart( elem.chart );
     }
   }
-  annotate->Build( top_g->AddNewGroup() );
+  annotate->Build( decor_g->AddNewGroup() );
 
-  BuildBackground();
+  // The HTML extent is only added once the SVG and PNG output is generated,
+  // so that these are the same with and without HTML output.
+  bool html_only = html && !svg && !png;
+  BuildBackground( html_only );
 
 /*
   {
@@ -928,13 +1090,150 @@ std::string Ensemble::Build( void )
   }
 */
 
-  std::ostringstream oss;
-  if ( enable_html ) {
-    oss << html_db->GenHTML( canvas );
-  } else {
-    oss << canvas->GenSVG();
+  if ( svg || png ) {
+    std::string doc;
+    {
+      Profile::Scope prof( "GenSVG" );
+      doc = canvas->GenSVG();
+    }
+    if ( png ) {
+      Profile::Scope prof( "GenPNG" );
+      Raster raster;
+      raster.Render( doc, raster_db );
+      *png << raster.GenPNG();
+    }
+    if ( svg ) *svg << doc;
   }
-  return oss.str();
+  if ( html ) {
+    Profile::Scope prof( "GenHTML" );
+    if ( !html_only ) AddExtent( html_bb );
+    *html << html_db->GenHTML( canvas );
+  }
+  if ( reuse ) KeepCharts();
+  raster_db = nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector< std::string > Ensemble::BuildSplit(
+  bool png, std::string& legend
+)
+{
+  if ( Empty() ) {
+    NewChart( 0, 0, 0, 0 );
+  }
+
+  for ( auto& s : split_list ) {
+    SetTopAttr( s.top_g );
+  }
+
+  RasterDirect direct;
+  raster_db = png ? &direct : nullptr;
+
+  BoundaryBox charts_bb;
+  for ( auto& elem : grid.element_list ) {
+    if ( elem.chart ) {
+      Profile::Scope prof( "Main::Build", elem.chart->id );
+      elem.chart->Build();
+      BoundaryBox bb = elem.chart->svg_g->GetBB();
+      charts_bb.Update( 0, 0 );
+      charts_bb.Update( bb.max.x - bb.min.x, bb.max.y - bb.min.y );
+    }
+  }
+
+  // The series with a global legend are shown in a legend canvas of its own,
+  // laid out as a column for a left or right legend and otherwise as rows no
+  // wider than the widest chart.
+  bool has_legend = legend_obj->Cnt() > 0;
+  if ( has_legend ) {
+    Profile::Scope prof( "BuildLegends" );
+    split_t s;
+    s.canvas = new Canvas();
+    s.canvas->settings.indent = false;
+    s.canvas->settings.math_coor = true;
+    s.top_g = s.canvas->TopGroup()->AddNewGroup();
+    split_list.push_back( s );
+    SetTopAttr( s.top_g );
+
+    Group* legend_g = s.top_g->AddNewGroup();
+    legend_g->Attr()->TextFont()->SetSize( 14 * legend_obj->size );
+    bool boxed =
+      legend_box_specified ? legend_box : !legend_obj->heading.empty();
+    Legend::LegendDims legend_dims;
+    legend_obj->CalcLegendDims( legend_g, legend_dims );
+    uint32_t nx;
+    if ( legend_obj->pos1 == Pos::Left || legend_obj->pos1 == Pos::Right ) {
+      U avail_h = charts_bb.max.y - charts_bb.min.y;
+      legend_obj->GetBestFit( legend_dims, nx, boxed, 0, avail_h );
+    } else {
+      U avail_w = charts_bb.max.x - charts_bb.min.x;
+      legend_obj->GetBestFit( legend_dims, nx, boxed, avail_w, 0 );
+    }
+    legend_obj->BuildLegends(
+      boxed, ForegroundColor(), LegendColor(),
+      legend_g->AddNewGroup(), nx
+    );
+  }
+
+  for ( auto& s : split_list ) {
+    BoundaryBox bb = s.top_g->GetBB();
+    bb.min.x -= margin;
+    bb.max.x += margin;
+    bb.min.y -= margin;
+    bb.max.y += margin;
+    s.top_g->Add( new Rect( bb.min, bb.max ) );
+    s.top_g->Last()->Attr()->LineColor()->Clear();
+    s.top_g->Last()->Attr()->SetLineWidth( 0 );
+    s.top_g->FrontToBack();
+  }
+
+  // The canvases are independent, so they are serialized concurrently. Each
+  // worker rasterizes single-threaded, as the workers already occupy the
+  // CPUs. The first exception thrown by a worker stops the remaining work and
+  // is rethrown here.
+  Profile::Scope prof( png ? "GenPNG" : "GenSVG" );
+  std::vector< std::string > docs( split_list.size() );
+  std::atomic< size_t > next_doc{ 0 };
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  auto worker = [&]()
+  {
+    try {
+      while ( true ) {
+        size_t i = next_doc++;
+        if ( i >= docs.size() ) break;
+        docs[ i ] = split_list[ i ].canvas->GenSVG();
+        if ( png ) {
+          Raster raster;
+          raster.SetThreads( 1 );
+          raster.Render( docs[ i ], raster_db );
+          docs[ i ] = raster.GenPNG();
+        }
+      }
+    } catch ( ... ) {
+      std::lock_guard< std::mutex > lk( error_mutex );
+      if ( !error ) error = std::current_exception();
+      next_doc = docs.size();
+    }
+  };
+  std::vector< std::thread > workers;
+  uint32_t num = std::max( 1u, std::thread::hardware_concurrency() );
+  num = std::min< size_t >( num, docs.size() );
+  for ( uint32_t n = 1; n < num; ++n ) {
+    workers.emplace_back( worker );
+  }
+  worker();
+  for ( auto& t : workers ) t.join();
+  raster_db = nullptr;
+  if ( error ) std::rethrow_exception( error );
+
+  legend.clear();
+  if ( has_legend ) {
+    legend = std::move( docs.back() );
+    docs.pop_back();
+  }
+
+  return docs;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
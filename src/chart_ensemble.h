@@ -46,6 +46,7 @@ public:
   void SetZeroToO( bool zero_to_o ) { this->zero_to_o = zero_to_o; }
 
   void EnableHTML( bool enable = true ) { enable_html = enable; }
+  void EnablePNG( bool enable = true ) { enable_png = enable; }
 
   void TitleHTML( const std::string& txt );
 
@@ -107,16 +108,74 @@ public:
   void AddAnnotationAnchor();
 
   void MoveCharts( void );
+
+  // Build the output and return it, or write it to out.
   std::string Build( void );
+  void Build( std::ostream& out );
+
+  // Build once and write the output in each format whose stream is given.
+  // Snap points are only collected if HTML is enabled, which is required for
+  // the html stream.
+  void Build( std::ostream* svg, std::ostream* html, std::ostream* png );
+
+  // Charts built by one rendering, kept for reuse by the next; see SetReuse().
+  struct reuse_t {
+    SVG::Canvas* canvas = nullptr;
+    SVG::Group* top_g = nullptr;
+    SVG::Group* back_g = nullptr;
+    SVG::Group* charts_g = nullptr;
+    SVG::Group* decor_g = nullptr;
+    std::vector< SVG::Group* > slots;
+    std::vector< Main* > charts;    // nullptr if the chart cannot be reused.
+    void Clear( void );
+    ~reuse_t( void ) { Clear(); }
+  };
+
+  // Take over the charts kept in reuse whose Main::reuse_key matches that of
+  // the chart with the same index, and keep the built charts in reuse after
+  // Build(). The charts must be the same in number, and are not kept for HTML
+  // or split output, nor if the series were drawn directly for PNG output.
+  void SetReuse( reuse_t* reuse ) { this->reuse = reuse; }
+
+  // Build each chart into a canvas of its own, so that the charts can be
+  // output individually by BuildSplit(); must be enabled before the first
+  // chart is created.
+  void EnableSplit( bool enable = true ) { split = enable; }
+
+  // Build the charts and return one SVG (or PNG) document per chart in the
+  // order the charts were created; the documents are generated concurrently.
+  // Titles, footnotes, and global annotations are not shown. The series with
+  // a global legend are shown in a separate legend document returned in
+  // legend, which is left empty if there are no such series.
+  std::vector< std::string > BuildSplit( bool png, std::string& legend );
+
+  bool split = false;
 
   Source* source = nullptr;
 
+  // The top group holds the background, the charts (each in a slot group of
+  // its own), and the decorations (legends, titles, footnotes, and global
+  // annotations) in that order, so that the decorations can be rebuilt
+  // around reused charts.
   SVG::Canvas* canvas;
   SVG::Group* top_g;
+  SVG::Group* back_g;
+  SVG::Group* charts_g;
+  SVG::Group* decor_g;
+  std::vector< SVG::Group* > slots;
+
+  reuse_t* reuse = nullptr;
+  void ReuseCharts( void );
+  void KeepCharts( void );
 
   bool enable_html = false;
   HTML* html_db = nullptr;
 
+  bool enable_png = false;
+
+  // Set while building for PNG output only, see Series::raster_db.
+  RasterDirect* raster_db = nullptr;
+
   double width_adj    = 1.0;
   double height_adj   = 1.0;
   double baseline_adj = 1.0;
@@ -160,12 +219,28 @@ public:
   bool footnote_line = false;
   double footnote_size = 1.0;
 
+  // Canvas and top group of each chart in split mode.
+  struct split_t {
+    SVG::Canvas* canvas;
+    SVG::Group* top_g;
+  };
+  std::vector< split_t > split_list;
+
+  void SetTopAttr( SVG::Group* g );
+
   SVG::BoundaryBox TopBB( void );
 
   void BuildLegends( void );
   void BuildTitle( void );
   void BuildFootnotes( void );
-  void BuildBackground( void );
+
+  // Build the background and the invisible rectangle giving the extent of the
+  // drawing. If html_extent is set, the extent also covers the chart areas as
+  // needed by the HTML output; otherwise that extent is only computed into
+  // html_bb, for AddExtent() to add once the SVG and PNG output is generated.
+  void BuildBackground( bool html_extent );
+  void AddExtent( const SVG::BoundaryBox& bb );
+  SVG::BoundaryBox html_bb;
 
   Annotate* annotate = nullptr;
 
@@ -0,0 +1,479 @@
+//
+//  MIT No Attribution License
+//
+//  Copyright 2025, Soren Kragh
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the
+//  “Software”), to deal in the Software without restriction, including
+//  without limitation the rights to use, copy, modify, merge, publish,
+//  distribute, sublicense, and/or sell copies of the Software, and to
+//  permit persons to whom the Software is furnished to do so.
+//
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include <chart_gzip.h>
+#include <chart_hash.h>
+
+using namespace Chart;
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+const uint16_t len_base[ 29 ] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+const uint8_t len_extra[ 29 ] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+const uint16_t dist_base[ 30 ] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+  8193, 12289, 16385, 24577
+};
+const uint8_t dist_extra[ 30 ] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+constexpr size_t in_buf_size = 64 * 1024;
+
+// Decompressed bytes delivered per underflow().
+constexpr size_t chunk_size = 64 * 1024;
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Gunzip::Gunzip( std::istream& in, index_t* index )
+  : in( in ), index( index ), in_buf( in_buf_size )
+{
+}
+
+Gunzip::Gunzip( std::istream& in, const checkpoint_t& cp )
+  : in( in ), in_buf( in_buf_size )
+{
+  out = cp.window;
+  out_base = cp.out_ofs - cp.window.size();
+  crc_pos = out.size();
+  at_member = cp.member;
+  first_member = false;
+  in.seekg( cp.in_ofs, std::ios::beg );
+  in_ofs = cp.in_ofs;
+  if ( !in ) {
+    err = "seek failed";
+    done = true;
+    return;
+  }
+  if ( cp.in_bit > 0 ) {
+    Need( cp.in_bit );
+    Drop( cp.in_bit );
+  }
+  setg( out.data(), out.data() + out.size(), out.data() + out.size() );
+}
+
+bool Gunzip::IsGzipName( const std::string& name )
+{
+  return name.size() > 3 && name.compare( name.size() - 3, 3, ".gz" ) == 0;
+}
+
+size_t Gunzip::Read(
+  std::istream& file, const index_t& index, uint64_t ofs,
+  char* buf, size_t n, std::string& err
+)
+{
+  auto it =
+    std::upper_bound(
+      index.list.begin(), index.list.end(), ofs,
+      []( uint64_t o, const checkpoint_t& cp ) { return o < cp.out_ofs; }
+    );
+  if ( it == index.list.begin() ) {
+    err = "no checkpoint";
+    return 0;
+  }
+  --it;
+  Gunzip gz( file, *it );
+  std::istream input( &gz );
+  input.ignore( ofs - it->out_ofs );
+  input.read( buf, n );
+  err = gz.err;
+  return input.gcount();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Gunzip::Fail( const std::string& msg )
+{
+  err = msg;
+  done = true;
+  throw std::runtime_error( msg );
+}
+
+bool Gunzip::Fill( void )
+{
+  if ( !in ) return false;
+  in_ofs += in_end;
+  in_pos = 0;
+  in.read( in_buf.data(), in_buf.size() );
+  in_end = in.gcount();
+  if ( in.bad() ) Fail( "read error" );
+  return in_end > 0;
+}
+
+// Make at least n bits available. Zero bytes are supplied beyond the end of
+// the input, which is detected by AtEnd() or when the bits are consumed; a few
+// are needed for looking ahead, more means that the input is truncated.
+void Gunzip::Need( uint32_t n )
+{
+  while ( bit_cnt < n ) {
+    uint64_t c = 0;
+    if ( in_pos < in_end || Fill() ) {
+      c = static_cast< uint8_t >( in_buf[ in_pos++ ] );
+    } else {
+      if ( ++pad_cnt > 8 ) Fail( "unexpected end of file" );
+    }
+    bit_buf |= c << bit_cnt;
+    bit_cnt += 8;
+  }
+}
+
+uint32_t Gunzip::Bits( uint32_t n )
+{
+  Need( n );
+  uint32_t v = bit_buf & ((uint64_t( 1 ) << n) - 1);
+  Drop( n );
+  if ( pad_cnt * 8 > bit_cnt ) Fail( "unexpected end of file" );
+  return v;
+}
+
+bool Gunzip::AtEnd( void )
+{
+  return bit_cnt <= pad_cnt * 8 && in_pos == in_end && !Fill();
+}
+
+int Gunzip::Decode( const huffman_t& h )
+{
+  Need( 15 );
+  uint32_t e = h.fast[ bit_buf & ((1 << huffman_t::fast_bits) - 1) ];
+  if ( e > 0 ) {
+    Drop( e >> 9 );
+    return e & 0x1FF;
+  }
+
+  // Canonical decoding of a code longer than fast_bits, one bit at a time.
+  int code = 0;
+  int first = 0;
+  int idx = 0;
+  for ( int len = 1; len < 16; len++ ) {
+    code |= (bit_buf >> (len - 1)) & 1;
+    int cnt = h.count[ len ];
+    if ( code - cnt < first ) {
+      Drop( len );
+      return h.symbol[ idx + (code - first) ];
+    }
+    idx += cnt;
+    first += cnt;
+    first <<= 1;
+    code <<= 1;
+  }
+  Fail( "invalid Huffman code" );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Build the decoding tables from the code lengths; returns false if the
+// lengths do not describe a valid code. Incomplete codes are accepted, as
+// allowed for a distance code with a single symbol.
+bool Gunzip::huffman_t::Build( const uint8_t* lengths, int n )
+{
+  std::memset( count, 0, sizeof( count ) );
+  std::memset( fast, 0, sizeof( fast ) );
+  for ( int s = 0; s < n; s++ ) count[ lengths[ s ] ]++;
+  int left = 1;
+  for ( int len = 1; len < 16; len++ ) {
+    left <<= 1;
+    left -= count[ len ];
+    if ( left < 0 ) return false;
+  }
+
+  uint16_t ofs[ 16 ];
+  uint16_t next[ 16 ];
+  ofs[ 1 ] = 0;
+  next[ 1 ] = 0;
+  for ( int len = 1; len < 15; len++ ) {
+    ofs[ len + 1 ] = ofs[ len ] + count[ len ];
+    next[ len + 1 ] = (next[ len ] + count[ len ]) << 1;
+  }
+  for ( int s = 0; s < n; s++ ) {
+    int len = lengths[ s ];
+    if ( len == 0 ) continue;
+    symbol[ ofs[ len ]++ ] = s;
+    uint32_t code = next[ len ]++;
+    if ( len > fast_bits ) continue;
+    uint32_t rev = 0;
+    for ( int i = 0; i < len; i++ ) rev |= ((code >> i) & 1) << (len - 1 - i);
+    for ( uint32_t i = rev; i < (1u << fast_bits); i += 1u << len ) {
+      fast[ i ] = (len << 9) | s;
+    }
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Gunzip::Checkpoint( void )
+{
+  uint64_t out_ofs = out_base + out.size();
+  if (
+    index == nullptr ||
+    (!index->list.empty() &&
+     out_ofs - index->list.back().out_ofs < index->spacing)
+  ) {
+    return;
+  }
+  uint64_t pos = BitPos();
+  checkpoint_t cp;
+  cp.out_ofs = out_ofs;
+  cp.in_ofs = pos / 8;
+  cp.in_bit = pos % 8;
+  cp.member = at_member;
+  if ( !at_member ) {
+    size_t n = std::min( out.size(), window_size );
+    cp.window.assign( out, out.size() - n, n );
+  }
+  index->list.push_back( std::move( cp ) );
+}
+
+// Decode the next member header, deflate block, or member trailer.
+void Gunzip::Step( void )
+{
+  if ( at_member ) {
+    Checkpoint();
+    if ( !Header() ) {
+      done = true;
+      return;
+    }
+    at_member = false;
+    first_member = false;
+    verify = true;
+    crc = 0;
+    member_size = 0;
+    return;
+  }
+  if ( at_trailer ) {
+    Trailer();
+    at_trailer = false;
+    at_member = true;
+    return;
+  }
+
+  Checkpoint();
+  at_trailer = Bits( 1 ) == 1;
+  switch ( Bits( 2 ) ) {
+    case 0:
+      Stored();
+      break;
+    case 1:
+    {
+      // Initialized once in a thread safe manner.
+      static const huffman_t* fixed = []()
+      {
+        static huffman_t h[ 2 ];
+        uint8_t lengths[ 288 ];
+        for ( int s = 0; s < 288; s++ ) {
+          lengths[ s ] = (s < 144) ? 8 : (s < 256) ? 9 : (s < 280) ? 7 : 8;
+        }
+        h[ 0 ].Build( lengths, 288 );
+        std::fill( lengths, lengths + 30, 5 );
+        h[ 1 ].Build( lengths, 30 );
+        return h;
+      }();
+      Codes( fixed[ 0 ], fixed[ 1 ] );
+      break;
+    }
+    case 2:
+      Dynamic();
+      break;
+    default:
+      Fail( "invalid block type" );
+  }
+
+  if ( verify ) {
+    crc = CRC32( out.data() + crc_pos, out.size() - crc_pos, crc );
+    member_size += out.size() - crc_pos;
+  }
+  crc_pos = out.size();
+}
+
+// Returns false if there is no further member; data following the last member
+// that does not start like a member is ignored, as done by gzip.
+bool Gunzip::Header( void )
+{
+  Drop( bit_cnt % 8 );
+  if ( AtEnd() ) {
+    if ( first_member ) Fail( "empty file" );
+    return false;
+  }
+  Need( 16 );
+  if ( (bit_buf & 0xFFFF) != 0x8B1F ) {
+    if ( first_member ) Fail( "not in gzip format" );
+    return false;
+  }
+  Drop( 16 );
+  if ( Bits( 8 ) != 8 ) Fail( "unknown compression method" );
+  uint32_t flags = Bits( 8 );
+  Bits( 16 );       // MTIME
+  Bits( 16 );
+  Bits( 16 );       // XFL, OS
+  if ( flags & 4 ) {
+    uint32_t n = Bits( 16 );
+    while ( n-- > 0 ) Bits( 8 );
+  }
+  if ( flags & 8 ) {
+    while ( Bits( 8 ) != 0 ) {}
+  }
+  if ( flags & 16 ) {
+    while ( Bits( 8 ) != 0 ) {}
+  }
+  if ( flags & 2 ) Bits( 16 );
+  return true;
+}
+
+void Gunzip::Trailer( void )
+{
+  Drop( bit_cnt % 8 );
+  uint32_t file_crc = Bits( 16 );
+  file_crc |= Bits( 16 ) << 16;
+  uint32_t file_size = Bits( 16 );
+  file_size |= Bits( 16 ) << 16;
+  if ( verify ) {
+    if ( file_crc != crc ) Fail( "CRC error" );
+    if ( file_size != uint32_t( member_size ) ) Fail( "length error" );
+  }
+}
+
+void Gunzip::Stored( void )
+{
+  Drop( bit_cnt % 8 );
+  uint32_t len = Bits( 16 );
+  uint32_t nlen = Bits( 16 );
+  if ( len != (~nlen & 0xFFFF) ) Fail( "invalid stored block length" );
+  size_t pos = out.size();
+  out.resize( pos + len );
+  char* p = out.data() + pos;
+
+  // Bytes already in the bit buffer first, then directly from the input.
+  while ( len > 0 && bit_cnt >= 8 ) {
+    *p++ = char( Bits( 8 ) );
+    len--;
+  }
+  while ( len > 0 ) {
+    if ( in_pos == in_end && !Fill() ) Fail( "unexpected end of file" );
+    size_t n = std::min< size_t >( len, in_end - in_pos );
+    std::memcpy( p, in_buf.data() + in_pos, n );
+    in_pos += n;
+    p += n;
+    len -= n;
+  }
+}
+
+void Gunzip::Dynamic( void )
+{
+  static const uint8_t order[ 19 ] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+  };
+  uint32_t nlen = Bits( 5 ) + 257;
+  uint32_t ndist = Bits( 5 ) + 1;
+  uint32_t ncode = Bits( 4 ) + 4;
+  if ( nlen > 286 || ndist > 30 ) Fail( "invalid code lengths" );
+
+  uint8_t lengths[ 320 ] = {};
+  for ( uint32_t i = 0; i < ncode; i++ ) lengths[ order[ i ] ] = Bits( 3 );
+  huffman_t lencode;
+  if ( !lencode.Build( lengths, 19 ) ) Fail( "invalid code lengths" );
+
+  uint32_t i = 0;
+  while ( i < nlen + ndist ) {
+    int s = Decode( lencode );
+    if ( s < 16 ) {
+      lengths[ i++ ] = s;
+      continue;
+    }
+    uint8_t len = 0;
+    uint32_t rep;
+    if ( s == 16 ) {
+      if ( i == 0 ) Fail( "invalid code lengths" );
+      len = lengths[ i - 1 ];
+      rep = 3 + Bits( 2 );
+    } else
+    if ( s == 17 ) {
+      rep = 3 + Bits( 3 );
+    } else {
+      rep = 11 + Bits( 7 );
+    }
+    if ( i + rep > nlen + ndist ) Fail( "invalid code lengths" );
+    while ( rep-- > 0 ) lengths[ i++ ] = len;
+  }
+  if ( lengths[ 256 ] == 0 ) Fail( "missing end of block code" );
+
+  huffman_t lit;
+  huffman_t dist;
+  if ( !lit.Build( lengths, nlen ) || !dist.Build( lengths + nlen, ndist ) ) {
+    Fail( "invalid code lengths" );
+  }
+  Codes( lit, dist );
+}
+
+void Gunzip::Codes( const huffman_t& lit, const huffman_t& dist )
+{
+  while ( true ) {
+    int s = Decode( lit );
+    if ( s < 256 ) {
+      out.push_back( char( s ) );
+      continue;
+    }
+    if ( s == 256 ) break;
+    s -= 257;
+    if ( s >= 29 ) Fail( "invalid length code" );
+    size_t len = len_base[ s ] + Bits( len_extra[ s ] );
+    int d = Decode( dist );
+    if ( d >= 30 ) Fail( "invalid distance code" );
+    size_t back = dist_base[ d ] + Bits( dist_extra[ d ] );
+    if ( back > out.size() ) Fail( "invalid distance" );
+    size_t pos = out.size();
+    out.resize( pos + len );
+    char* p = out.data() + pos;
+    const char* q = p - back;
+    for ( size_t k = 0; k < len; k++ ) p[ k ] = q[ k ];
+  }
+  if ( pad_cnt * 8 > bit_cnt ) Fail( "unexpected end of file" );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Gunzip::int_type Gunzip::underflow()
+{
+  if ( gptr() < egptr() ) return traits_type::to_int_type( *gptr() );
+
+  // Everything has been delivered; keep only the history.
+  if ( out.size() > window_size ) {
+    size_t n = out.size() - window_size;
+    out.erase( 0, n );
+    out_base += n;
+    crc_pos -= n;
+  }
+
+  size_t start = out.size();
+  while ( !done && out.size() - start < chunk_size ) Step();
+  setg( out.data(), out.data() + start, out.data() + out.size() );
+  if ( out.size() == start ) return traits_type::eof();
+  return traits_type::to_int_type( *gptr() );
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,140 @@
+//
+//  MIT No Attribution License
+//
+//  Copyright 2025, Soren Kragh
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the
+//  “Software”), to deal in the Software without restriction, including
+//  without limitation the rights to use, copy, modify, merge, publish,
+//  distribute, sublicense, and/or sell copies of the Software, and to
+//  permit persons to whom the Software is furnished to do so.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace Chart {
+
+// Self-contained gzip decoder presenting the decompressed contents of a file
+// as a stream buffer. While a file is decoded from the start, checkpoints
+// holding the complete decoder state are recorded at deflate block boundaries
+// at least spacing decompressed bytes apart. Decoding can later resume at any
+// checkpoint, so reading at an arbitrary offset only requires decoding from
+// the nearest preceding checkpoint instead of from the start of the file.
+class Gunzip : public std::streambuf
+{
+public:
+
+  struct checkpoint_t {
+    uint64_t out_ofs = 0;     // Offset in the decompressed data.
+    uint64_t in_ofs  = 0;     // Offset of the byte holding the next bit.
+    uint32_t in_bit  = 0;     // Bits of that byte already consumed.
+    bool member = true;       // At the start of a gzip member.
+    std::string window;       // The preceding (up to) 32K decompressed bytes.
+  };
+
+  struct index_t {
+    uint64_t spacing = 4 * 1024 * 1024;
+    std::vector< checkpoint_t > list;
+  };
+
+  // Decode in from the start; checkpoints are recorded in index unless it is
+  // nullptr.
+  Gunzip( std::istream& in, index_t* index = nullptr );
+
+  // Decode in from the checkpoint.
+  Gunzip( std::istream& in, const checkpoint_t& cp );
+
+  // Files are taken to be gzip compressed based on the .gz suffix.
+  static bool IsGzipName( const std::string& name );
+
+  // Read up to n decompressed bytes starting at offset ofs of file, which must
+  // be the file the index was recorded for. Returns the number of bytes read;
+  // if the data is corrupt err holds the reason.
+  static size_t Read(
+    std::istream& file, const index_t& index, uint64_t ofs,
+    char* buf, size_t n, std::string& err
+  );
+
+  // Reason for a failed decoding. The failure is reported to the reading
+  // stream by an exception, which sets its badbit.
+  std::string err;
+
+protected:
+
+  int_type underflow() override;
+
+private:
+
+  static constexpr size_t window_size = 32 * 1024;
+
+  struct huffman_t {
+    static constexpr int fast_bits = 10;
+    // Codes up to fast_bits long, indexed by the next (bit reversed) input
+    // bits: (length << 9) | symbol, or 0 for longer codes.
+    uint16_t fast[ 1 << fast_bits ];
+    uint16_t count[ 16 ];
+    uint16_t symbol[ 288 ];
+    bool Build( const uint8_t* lengths, int n );
+  };
+
+  [[noreturn]] void Fail( const std::string& msg );
+
+  bool Fill( void );
+  void Need( uint32_t n );
+  void Drop( uint32_t n )
+  {
+    bit_buf >>= n;
+    bit_cnt -= n;
+  }
+  uint32_t Bits( uint32_t n );
+  uint64_t BitPos( void )
+  {
+    return (in_ofs + in_pos + pad_cnt) * 8 - bit_cnt;
+  }
+  bool AtEnd( void );
+  int Decode( const huffman_t& h );
+
+  void Checkpoint( void );
+  void Step( void );
+  bool Header( void );
+  void Trailer( void );
+  void Stored( void );
+  void Dynamic( void );
+  void Codes( const huffman_t& lit, const huffman_t& dist );
+
+  std::istream& in;
+  index_t* index = nullptr;
+
+  std::vector< char > in_buf;
+  size_t in_pos = 0;
+  size_t in_end = 0;
+  uint64_t in_ofs = 0;        // File offset of in_buf[ 0 ].
+  uint64_t bit_buf = 0;
+  uint32_t bit_cnt = 0;
+  uint32_t pad_cnt = 0;       // Zero bytes supplied beyond the end of in.
+
+  // Decompressed data; the first part is kept as history for back references
+  // once it has been delivered.
+  std::string out;
+  uint64_t out_base = 0;      // Offset of out[ 0 ] in the decompressed data.
+
+  bool at_member = true;      // Next is a gzip member header.
+  bool at_trailer = false;    // Next is a gzip member trailer.
+  bool first_member = true;
+  bool done = false;
+
+  // The CRC and size are verified only for members decoded from their start.
+  bool verify = false;
+  uint32_t crc = 0;
+  size_t crc_pos = 0;         // Position in out up to which crc is computed.
+  uint64_t member_size = 0;
+};
+
+}
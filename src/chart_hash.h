@@ -0,0 +1,257 @@
+//
+//  MIT No Attribution License
+//
+//  Copyright 2025, Soren Kragh
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the
+//  “Software”), to deal in the Software without restriction, including
+//  without limitation the rights to use, copy, modify, merge, publish,
+//  distribute, sublicense, and/or sell copies of the Software, and to
+//  permit persons to whom the Software is furnished to do so.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <svg_canvas.h>
+
+namespace Chart {
+
+// Finalizer of splitmix64; spreads every input bit over all output bits so
+// that keys built from packed coordinates hash well in power-of-two tables.
+inline uint64_t HashMix( uint64_t x )
+{
+  x ^= x >> 30; x *= 0xBF58476D1CE4E5B9ull;
+  x ^= x >> 27; x *= 0x94D049BB133111EBull;
+  x ^= x >> 31;
+  return x;
+}
+
+struct IntHash {
+  size_t operator()( uint64_t k ) const {
+    return HashMix( k );
+  }
+};
+
+struct PointHash {
+  size_t operator()( const SVG::Point& p ) const {
+    // Adding 0.0 turns -0.0 into +0.0 so that equal points hash equally.
+    double x = p.x + 0.0;
+    double y = p.y + 0.0;
+    uint64_t hx;
+    uint64_t hy;
+    std::memcpy( &hx, &x, sizeof( hx ) );
+    std::memcpy( &hy, &y, sizeof( hy ) );
+    return HashMix( hx ^ HashMix( hy ) );
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// CRC-32 as used by PNG and gzip; pass the previous result as crc to continue
+// the checksum over more data.
+inline uint32_t CRC32( const char* data, size_t n, uint32_t crc = 0 )
+{
+  // Initialized once in a thread safe manner.
+  static const std::array< uint32_t, 256 > table = []()
+  {
+    std::array< uint32_t, 256 > t;
+    for ( uint32_t k = 0; k < 256; k++ ) {
+      uint32_t c = k;
+      for ( int j = 0; j < 8; j++ ) {
+        c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+      }
+      t[ k ] = c;
+    }
+    return t;
+  }();
+  crc = ~crc;
+  for ( size_t k = 0; k < n; k++ ) {
+    crc = table[ (crc ^ uint8_t( data[ k ] )) & 0xFF ] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Streaming 128-bit fingerprint of a byte sequence. Not cryptographic, but the
+// chance of two different inputs getting the same fingerprint is negligible,
+// so it can be used as a cache key. Two independent multiply-rotate lanes
+// consume eight bytes per step.
+class ContentHash
+{
+public:
+
+  void Add( const char* data, size_t n )
+  {
+    uint64_t w;
+    while ( n >= 8 ) {
+      std::memcpy( &w, data, 8 );
+      Step( w );
+      data += 8;
+      n -= 8;
+    }
+    w = 0;
+    std::memcpy( &w, data, n );
+    Step( w ^ (static_cast< uint64_t >( n ) << 56) );
+  }
+
+  void Add( std::string_view s ) { Add( s.data(), s.size() ); }
+
+  void Add( uint64_t v ) { Step( v ); }
+
+  // The fingerprint as 32 hexadecimal digits.
+  std::string Hex( void ) const
+  {
+    uint64_t a = HashMix( h1 ^ HashMix( h2 ) );
+    uint64_t b = HashMix( h2 + HashMix( h1 ) );
+    const char* digits = "0123456789abcdef";
+    std::string hex;
+    for ( uint64_t v : { a, b } ) {
+      for ( int i = 60; i >= 0; i -= 4 ) hex += digits[ (v >> i) & 0xF ];
+    }
+    return hex;
+  }
+
+private:
+
+  void Step( uint64_t w )
+  {
+    h1 = (h1 ^ w) * 0x9E3779B97F4A7C15ull;
+    h1 = (h1 << 31) | (h1 >> 33);
+    h2 = (h2 + w) * 0xC2B2AE3D27D4EB4Full;
+    h2 = (h2 << 27) | (h2 >> 37);
+  }
+
+  uint64_t h1 = 0x243F6A8885A308D3ull;
+  uint64_t h2 = 0x13198A2E03707344ull;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Minimal open-addressing hash map with linear probing. All entries live in a
+// single flat array, so inserts do not allocate (except when growing) and
+// lookups touch few cache lines. Only insertion and lookup are supported,
+// which is all the pruning and snapping code needs. A slot is in use when its
+// stamp equals the current generation, so Clear() is O(1) regardless of the
+// capacity left behind by earlier, larger contents.
+template< typename K, typename V, typename H = IntHash >
+class FlatMap
+{
+public:
+
+  // Make room for n entries without rehashing.
+  void Reserve( size_t n )
+  {
+    size_t cap = 16;
+    while ( cap < n * 2 ) cap *= 2;
+    if ( cap > slots.size() ) Rehash( cap );
+  }
+
+  void Clear( void )
+  {
+    if ( num == 0 ) return;
+    if ( ++gen == 0 ) {
+      std::fill( stamp.begin(), stamp.end(), 0 );
+      gen = 1;
+    }
+    num = 0;
+  }
+
+  size_t Size( void ) const { return num; }
+
+  // Returns the value of key k and true if the key was inserted, or false if
+  // it already existed in which case v is ignored.
+  std::pair< V*, bool > Insert( const K& k, const V& v = V() )
+  {
+    if ( (num + 1) * 2 > slots.size() ) {
+      Rehash( slots.empty() ? 16 : slots.size() * 2 );
+    }
+    size_t i = Probe( k );
+    if ( stamp[ i ] == gen ) return { &slots[ i ].val, false };
+    stamp[ i ] = gen;
+    slots[ i ].key = k;
+    slots[ i ].val = v;
+    num++;
+    return { &slots[ i ].val, true };
+  }
+
+  // Returns nullptr if key k does not exist.
+  V* Find( const K& k )
+  {
+    if ( num == 0 ) return nullptr;
+    size_t i = Probe( k );
+    return (stamp[ i ] == gen) ? &slots[ i ].val : nullptr;
+  }
+
+  bool Contains( const K& k ) { return Find( k ) != nullptr; }
+
+private:
+
+  struct slot_t {
+    K key;
+    V val;
+  };
+
+  std::vector< slot_t > slots;
+  std::vector< uint32_t > stamp;
+  uint32_t gen = 1;
+  size_t num = 0;
+
+  // Returns the slot holding k, or the free slot where k belongs.
+  size_t Probe( const K& k ) const
+  {
+    size_t mask = slots.size() - 1;
+    size_t i = H()( k ) & mask;
+    while ( stamp[ i ] == gen && !(slots[ i ].key == k) ) {
+      i = (i + 1) & mask;
+    }
+    return i;
+  }
+
+  void Rehash( size_t cap )
+  {
+    std::vector< slot_t > old_slots( cap );
+    std::vector< uint32_t > old_stamp( cap, 0 );
+    old_slots.swap( slots );
+    old_stamp.swap( stamp );
+    for ( size_t i = 0; i < old_slots.size(); ++i ) {
+      if ( old_stamp[ i ] != gen ) continue;
+      size_t j = Probe( old_slots[ i ].key );
+      stamp[ j ] = gen;
+      slots[ j ] = std::move( old_slots[ i ] );
+    }
+  }
+};
+
+// Set variant of FlatMap.
+template< typename K, typename H = IntHash >
+class FlatSet
+{
+public:
+
+  void Reserve( size_t n ) { map.Reserve( n ); }
+  void Clear( void ) { map.Clear(); }
+  size_t Size( void ) const { return map.Size(); }
+
+  // Returns true if k was inserted, false if it already existed.
+  bool Insert( const K& k ) { return map.Insert( k ).second; }
+
+  bool Contains( const K& k ) { return map.Contains( k ); }
+
+private:
+
+  struct none_t {};
+  FlatMap< K, none_t, H > map;
+};
+
+}
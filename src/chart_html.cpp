@@ -106,7 +106,7 @@ bool HTML::AllocateSnap( Main* main, SVG::Point p )
   uint64_t key =
     (static_cast< uint64_t >( p.y * snap_factor ) << 32) |
     (static_cast< uint64_t >( p.x * snap_factor ) <<  0);
-  return main->html.snap_set.insert( key ).second;
+  return main->html.snap_set.Insert( key );
 }
 
 void HTML::RecordSnapPoint(
@@ -125,7 +125,7 @@ void HTML::RecordSnapPoint(
 
 void HTML::PreserveSnapPoint( Series* series, SVG::Point p )
 {
-  series->html.preserve_set.insert( p );
+  series->html.preserve_set.Insert( p );
 }
 
 void HTML::CommitSnapPoints( Series* series, bool force )
@@ -139,10 +139,10 @@ void HTML::CommitSnapPoints( Series* series, bool force )
   bool is_cat = series->is_cat;
   for ( const auto& sp : series->html.uncommitted_snap_points ) {
     bool add =
-      series->html.preserve_set.count( sp.p ) > 0 ||
+      series->html.preserve_set.Contains( sp.p ) ||
       (is_cat && SnapCat( main, sp.cat_idx ));
     if ( add ) {
-      if ( is_cat ) main->html.cat_set.insert( sp.cat_idx );
+      if ( is_cat ) main->html.cat_set.Insert( sp.cat_idx );
       series->html.snap_points.push_back( sp );
       AllocateSnap( main, sp.p );
     }
@@ -150,7 +150,7 @@ void HTML::CommitSnapPoints( Series* series, bool force )
   for ( const auto& sp : series->html.uncommitted_snap_points ) {
     bool add = AllocateSnap( main, sp.p );
     if ( add ) {
-      if ( is_cat ) main->html.cat_set.insert( sp.cat_idx );
+      if ( is_cat ) main->html.cat_set.Insert( sp.cat_idx );
       series->html.snap_points.push_back( sp );
     }
   }
@@ -159,22 +159,21 @@ void HTML::CommitSnapPoints( Series* series, bool force )
 
 ////////////////////////////////////////////////////////////////////////////////
 
-std::string quoteJS( std::string_view s ) {
-  std::ostringstream oss;
-  oss << '"';
+// Append s as a quoted JavaScript string.
+void appendJS( std::string& out, std::string_view s ) {
+  out += '"';
   for ( char c : s ) {
     if ( static_cast<unsigned char>( c ) < ' ' ) {
-        oss << ' ';
+        out += ' ';
     } else if ( c == '"' ) {
-        oss << "\\\"";
+        out += "\\\"";
     } else if ( c == '\\' ) {
-        oss << "\\\\";
+        out += "\\\\";
     } else {
-        oss << c;
+        out += c;
     }
   }
-  oss << '"';
-  return oss.str();
+  out += '"';
 }
 
 //------------------------------------------------------------------------------
@@ -395,22 +394,47 @@ void HTML::GenChartData( Main* main, std::ostringstream& oss )
   }
   oss << "],\n";
 
+  // The snap points and categories may number in the millions, so they are
+  // formatted into a reusable string buffer which is flushed in large chunks
+  // rather than streamed value by value.
+  constexpr size_t flush_size = 1 << 20;
+  std::string out;
+  out.reserve( 2 * flush_size );
+  auto flush = [&]( bool force ) {
+    if ( force || out.size() >= flush_size ) {
+      oss.write( out.data(), out.size() );
+      out.clear();
+    }
+  };
+
   oss << "snapPoints : [\n";
   for ( auto series : main->series_list ) {
     for ( const auto& sp : series->html.snap_points ) {
       U X = +(sp.p.x + main->g_dx);
       U Y = -(sp.p.y + main->g_dy);
-      oss << "{s:" << series->id << ',';
+      out += "{s:";
+      AppendInt( out, series->id );
+      out += ',';
       if ( series->is_cat ) {
-        oss << "x:" << sp.cat_idx << ',';
+        out += "x:";
+        AppendInt( out, sp.cat_idx );
+        out += ',';
       } else {
-        oss << "x:" << quoteJS( sp.tag_x ) << ',';
+        out += "x:";
+        appendJS( out, sp.tag_x );
+        out += ',';
       }
-      oss << "y:" << quoteJS( sp.tag_y ) << ",";
-      oss << "X:" << X.SVG( false ) << ',';
-      oss << "Y:" << Y.SVG( false ) << "},\n";
+      out += "y:";
+      appendJS( out, sp.tag_y );
+      out += ",X:";
+      out += X.SVG( false );
+      out += ",Y:";
+      out += Y.SVG( false );
+      out += "},\n";
+      flush( false );
     }
   }
+  flush( true );
   oss << "],\n";
 
   if ( main->category_num > 0 ) {
@@ -423,22 +447,26 @@ void HTML::GenChartData( Main* main, std::ostringstream& oss )
       ++i, main->CategoryNext()
     ) {
       bool snappable = SnapCat( main, i );
-      if ( snappable || main->html.cat_set.count( i ) > 0 ) {
+      if ( snappable || main->html.cat_set.Contains( i ) ) {
         std::string_view cat;
         main->CategoryGet( cat );
         if ( !cat.empty() ) {
           if ( j < i ) {
-            oss << i << ',';
+            AppendInt( out, i );
+            out += ',';
             j = i;
           }
           if ( snappable ) {
-            oss << ',';
+            out += ',';
           }
-          oss << quoteJS( cat ) << ",\n";
+          appendJS( out, cat );
+          out += ",\n";
           ++j;
+          flush( false );
         }
       }
     }
+    flush( true );
     oss << "],\n";
   }
 
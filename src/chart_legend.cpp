@@ -117,7 +117,8 @@ void Legend::CalcLegendDims(
       series->type == SeriesType::StackedBar ||
       series->type == SeriesType::LayeredBar ||
       series->type == SeriesType::Area ||
-      series->type == SeriesType::StackedArea
+      series->type == SeriesType::StackedArea ||
+      series->density
     ) {
       symbol_shown = true;
     } else {
@@ -152,7 +153,7 @@ void Legend::CalcLegendDims(
   for ( auto series : series_list ) {
     if ( series->name.empty() ) continue;
     if (
-      series->marker_show &&
+      series->marker_show && !series->density &&
       series->type != SeriesType::Area &&
       series->type != SeriesType::StackedArea &&
       ( ( series->marker_shape != MarkerShape::LineX &&
@@ -173,6 +174,17 @@ void Legend::CalcLegendDims(
   U line_symbol_width = -1;
   for ( auto series : series_list ) {
     if ( series->name.empty() ) continue;
+    if ( series->density ) {
+      legend_dims.ss = std::max( +legend_dims.ss, (char_h + 8) / 2 );
+      // The color scale must have room for the smallest and largest bin count
+      // at its ends; the counts are not known before the series is built, but
+      // are bounded by the number of datums.
+      size_t digits =
+        std::to_string( std::max< size_t >( 1, series->datum_num ) ).size();
+      U label_w = char_w * Series::density_label_size * digits;
+      line_symbol_width =
+        std::max( +line_symbol_width, 2 * label_w + 3 * char_w );
+    }
     if (
       series->type == SeriesType::Bar ||
       series->type == SeriesType::StackedBar ||
@@ -493,7 +505,7 @@ void Legend::BuildLegends(
     }
 
     if (
-      series->marker_show &&
+      series->marker_show && !series->density &&
       series->type != SeriesType::Area &&
       series->type != SeriesType::StackedArea &&
       ( ( series->marker_shape != MarkerShape::LineX &&
@@ -514,6 +526,42 @@ void Legend::BuildLegends(
       }
     }
 
+    if ( series->density ) {
+      // Show the density color scale from sparse (left) to dense (right),
+      // labeled with the smallest and largest bin count.
+      U x1 = marker_p.x - legend_dims.ow/2 - legend_dims.lx;
+      U x2 = marker_p.x + legend_dims.ow/2 + legend_dims.lx;
+      U w = (x2 - x1) / Series::density_levels;
+      for ( uint32_t l = 0; l < Series::density_levels; ++l ) {
+        g->Add(
+          new Rect(
+            x1 + l * w, marker_p.y - legend_dims.ss,
+            x1 + l * w + w, marker_p.y + legend_dims.ss
+          )
+        );
+        g->Last()->Attr()->LineColor()->Clear();
+        series->DensityColor( g->Last()->Attr()->FillColor(), l );
+      }
+      if ( series->density_max_cnt > 0 ) {
+        U label_h = legend_dims.ch * Series::density_label_size;
+        U pad = legend_dims.ch / 4;
+        Color sparse;
+        Color dense;
+        series->DensityColor( &sparse, 0 );
+        series->DensityColor( &dense, Series::density_levels - 1 );
+        Object* obj = Label::CreateLabel(
+          g, std::to_string( series->density_min_cnt ), label_h
+        );
+        obj->MoveTo( AnchorX::Min, AnchorY::Mid, x1 + pad, marker_p.y );
+        obj->Attr()->TextColor()->Set( &dense );
+        obj = Label::CreateLabel(
+          g, std::to_string( series->density_max_cnt ), label_h
+        );
+        obj->MoveTo( AnchorX::Max, AnchorY::Mid, x2 - pad, marker_p.y );
+        obj->Attr()->TextColor()->Set( &sparse );
+      }
+    }
+
     if (
       series->type == SeriesType::Bar ||
       series->type == SeriesType::StackedBar ||
@@ -0,0 +1,173 @@
+//
+//  MIT No Attribution License
+//
+//  Copyright 2025, Soren Kragh
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the
+//  “Software”), to deal in the Software without restriction, including
+//  without limitation the rights to use, copy, modify, merge, publish,
+//  distribute, sublicense, and/or sell copies of the Software, and to
+//  permit persons to whom the Software is furnished to do so.
+//
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <chart_lz.h>
+
+using namespace Chart;
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+constexpr int hash_bits = 16;
+constexpr size_t min_match = 4;
+constexpr size_t max_dist = 65535;
+
+uint32_t Read32( const char* p )
+{
+  uint32_t v;
+  std::memcpy( &v, p, 4 );
+  return v;
+}
+
+uint64_t Read64( const char* p )
+{
+  uint64_t v;
+  std::memcpy( &v, p, 8 );
+  return v;
+}
+
+char* PutLen( char* o, size_t len )
+{
+  while ( len >= 255 ) {
+    *o++ = char( 255 );
+    len -= 255;
+  }
+  *o++ = char( len );
+  return o;
+}
+
+char* PutLiterals( char* o, const char* lit, size_t lit_len, uint32_t m )
+{
+  *o++ = char( (std::min< size_t >( lit_len, 15 ) << 4) | m );
+  if ( lit_len >= 15 ) o = PutLen( o, lit_len - 15 );
+  std::memcpy( o, lit, lit_len );
+  return o + lit_len;
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string LZ::Compress( const char* src, size_t n )
+{
+  // Worst case is all literals.
+  std::string out( n + n / 255 + 16, '\0' );
+  char* o = out.data();
+  std::vector< uint32_t > table( size_t( 1 ) << hash_bits, 0 );
+  auto hash = []( uint32_t seq )
+  {
+    return (seq * 2654435761u) >> (32 - hash_bits);
+  };
+
+  // The last bytes are always literals, so that matching can read ahead.
+  size_t limit = (n > 12) ? n - 12 : 0;
+  size_t anchor = 0;
+  size_t i = 0;
+  uint32_t misses = 0;
+  while ( i < limit ) {
+    uint32_t seq = Read32( src + i );
+    uint32_t h = hash( seq );
+    size_t cand = table[ h ];
+    table[ h ] = i;
+    if ( cand >= i || i - cand > max_dist || Read32( src + cand ) != seq ) {
+      // Skip faster through data that does not compress.
+      i += 1 + (misses++ >> 5);
+      continue;
+    }
+    size_t len = min_match;
+    while (
+      i + len + 8 <= n &&
+      Read64( src + cand + len ) == Read64( src + i + len )
+    ) {
+      len += 8;
+    }
+    while ( i + len < n && src[ cand + len ] == src[ i + len ] ) len++;
+
+    size_t m = len - min_match;
+    o = PutLiterals( o, src + anchor, i - anchor, std::min< size_t >( m, 15 ) );
+    size_t dist = i - cand;
+    *o++ = char( dist & 0xFF );
+    *o++ = char( dist >> 8 );
+    if ( m >= 15 ) o = PutLen( o, m - 15 );
+    i += len;
+    anchor = i;
+    misses = 0;
+    if ( i < limit ) table[ hash( Read32( src + i - 2 ) ) ] = i - 2;
+  }
+
+  o = PutLiterals( o, src + anchor, n - anchor, 0 );
+  out.resize( o - out.data() );
+  return out;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool LZ::Decompress( const std::string& packed, char* dst, size_t n )
+{
+  const uint8_t* p = reinterpret_cast< const uint8_t* >( packed.data() );
+  const uint8_t* end = p + packed.size();
+  char* d = dst;
+  char* d_end = dst + n;
+
+  auto get_len = [&]( size_t& len )
+  {
+    while ( true ) {
+      if ( p == end ) return false;
+      uint8_t b = *p++;
+      len += b;
+      if ( b != 255 ) return true;
+    }
+  };
+
+  while ( p < end ) {
+    uint32_t token = *p++;
+    size_t lit_len = token >> 4;
+    if ( lit_len == 15 && !get_len( lit_len ) ) return false;
+    if ( size_t( end - p ) < lit_len || size_t( d_end - d ) < lit_len ) {
+      return false;
+    }
+    std::memcpy( d, p, lit_len );
+    d += lit_len;
+    p += lit_len;
+    if ( p == end ) break;
+
+    if ( end - p < 2 ) return false;
+    size_t dist = p[ 0 ] | (p[ 1 ] << 8);
+    p += 2;
+    size_t len = token & 15;
+    if ( len == 15 && !get_len( len ) ) return false;
+    len += min_match;
+    if (
+      dist == 0 || dist > size_t( d - dst ) || size_t( d_end - d ) < len
+    ) {
+      return false;
+    }
+    const char* s = d - dist;
+    if ( dist >= len ) {
+      std::memcpy( d, s, len );
+    } else {
+      for ( size_t k = 0; k < len; k++ ) d[ k ] = s[ k ];
+    }
+    d += len;
+  }
+
+  return d == d_end;
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,36 @@
+//
+//  MIT No Attribution License
+//
+//  Copyright 2025, Soren Kragh
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the
+//  “Software”), to deal in the Software without restriction, including
+//  without limitation the rights to use, copy, modify, merge, publish,
+//  distribute, sublicense, and/or sell copies of the Software, and to
+//  permit persons to whom the Software is furnished to do so.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace Chart {
+
+// Fast self-contained LZ77 codec for keeping data compressed in memory; speed
+// matters more than ratio. The format is byte oriented: each sequence is a
+// token holding the number of literals and the match length (4 bits each,
+// extended by bytes of 255 plus a final byte when 15), the literals, and a
+// 16-bit little endian match offset. The last sequence has literals only.
+class LZ
+{
+public:
+
+  static std::string Compress( const char* src, size_t n );
+
+  // Returns false unless packed decompresses to exactly n bytes.
+  static bool Decompress( const std::string& packed, char* dst, size_t n );
+};
+
+}
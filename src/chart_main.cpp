@@ -63,11 +63,26 @@ Main::~Main( void )
 
 void Main::Move( SVG::U dx, SVG::U dy )
 {
-  svg_g->Move( dx, dy );
+  svg_g->Move( dx - g_dx, dy - g_dy );
   g_dx = dx;
   g_dy = dy;
 }
 
+void Main::SetEnsemble( Ensemble* ensemble )
+{
+  this->ensemble = ensemble;
+  legend_obj->ensemble = ensemble;
+}
+
+void Main::AddGlobalLegends( void )
+{
+  for ( auto series : series_list ) {
+    if ( !series->name.empty() && series->global_legend ) {
+      ensemble->legend_obj->Add( series );
+    }
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 void Main::SetFrame( SVG::U width, SVG::U padding, SVG::U radius )
@@ -191,11 +206,29 @@ void Main::SetCategoryAnchor( cat_idx_t num, bool empty )
   category_num += num;
 }
 
+void Main::SetCategories( const std::string* cats, size_t n )
+{
+  category_anchor_t anchor;
+  anchor.num = n;
+  anchor.fed = true;
+  anchor.names.assign( cats, cats + n );
+  for ( size_t i = 0; i < n; ++i ) {
+    ParsedCat( category_num + i, anchor.names[ i ] );
+  }
+  category_anchor_list.push_back( std::move( anchor ) );
+  category_num += n;
+}
+
 void Main::ParsedCat( cat_idx_t cat_idx, std::string_view cat )
+{
+  ParsedCat( cat_idx, cat.empty(), cat.empty() || NormalWidthUTF8( cat ) );
+}
+
+void Main::ParsedCat( cat_idx_t cat_idx, bool empty, bool normal_width )
 {
   if ( !parse_cat.stride_found ) parse_cat.empty_stride = cat_idx + 1;
-  if ( cat.empty() ) return;
-  parse_cat.normal_width = parse_cat.normal_width && NormalWidthUTF8( cat );
+  if ( empty ) return;
+  parse_cat.normal_width = parse_cat.normal_width && normal_width;
   if ( parse_cat.non_empty_seen ) {
     cat_idx_t stride = cat_idx - parse_cat.idx;
     if ( parse_cat.stride_found ) {
@@ -209,6 +242,36 @@ void Main::ParsedCat( cat_idx_t cat_idx, std::string_view cat )
   parse_cat.non_empty_seen = true;
 }
 
+void Main::cat_summary_t::Add( std::string_view cat )
+{
+  cat_idx_t row = rows++;
+  if ( cat.empty() ) return;
+  normal_width = normal_width && NormalWidthUTF8( cat );
+  if ( non_empty_seen ) {
+    cat_idx_t stride = row - lst;
+    min_stride = (min_stride == 0) ? stride : std::min( stride, min_stride );
+  } else {
+    fst = row;
+  }
+  lst = row;
+  non_empty_seen = true;
+}
+
+// Only the first non-empty category, the smallest stride, the last non-empty
+// category, and the last category affect the resulting parse_cat state.
+void Main::ParsedCats( cat_idx_t cat_ofs, const cat_summary_t& summary )
+{
+  if ( summary.rows == 0 ) return;
+  if ( summary.non_empty_seen ) {
+    ParsedCat( cat_ofs + summary.fst, false, summary.normal_width );
+    if ( summary.min_stride > 0 ) {
+      ParsedCat( cat_ofs + summary.fst + summary.min_stride, false, true );
+      parse_cat.idx = cat_ofs + summary.lst;
+    }
+  }
+  ParsedCat( cat_ofs + summary.rows - 1, true, true );
+}
+
 void Main::CategoryBegin()
 {
   cat_list_idx = 0;
@@ -219,12 +282,17 @@ void Main::CategoryLoad()
 {
   cat_list_cnt = 0;
   cat_list_empty = true;
+  cat_list_fed = false;
   while ( cat_list_idx < category_anchor_list.size() ) {
-    if ( category_anchor_list[ cat_list_idx ].num > 0 ) {
-      cat_list_cnt = category_anchor_list[ cat_list_idx ].num;
-      cat_list_empty = category_anchor_list[ cat_list_idx ].empty;
-      ensemble->source->cur_pos = category_anchor_list[ cat_list_idx ].pos;
-      ensemble->source->LoadLine();
+    const category_anchor_t& anchor = category_anchor_list[ cat_list_idx ];
+    if ( anchor.num > 0 ) {
+      cat_list_cnt = anchor.num;
+      cat_list_empty = anchor.empty;
+      cat_list_fed = anchor.fed;
+      if ( !cat_list_fed ) {
+        ensemble->source->cur_pos = anchor.pos;
+        ensemble->source->LoadLine();
+      }
       cat_list_cnt--;
       return;
     }
@@ -237,8 +305,10 @@ void Main::CategoryLoad()
 void Main::CategoryNext()
 {
   if ( cat_list_cnt > 0 ) {
-    ensemble->source->NextLine();
-    ensemble->source->SkipWS( true );
+    if ( !cat_list_fed ) {
+      ensemble->source->NextLine();
+      ensemble->source->SkipWS( true );
+    }
     cat_list_cnt--;
   } else {
     cat_list_idx++;
@@ -249,6 +319,10 @@ void Main::CategoryNext()
 void Main::CategoryGet( std::string_view& cat )
 {
   cat = std::string_view{};
+  if ( cat_list_fed ) {
+    const category_anchor_t& anchor = category_anchor_list[ cat_list_idx ];
+    cat = anchor.names[ anchor.num - 1 - cat_list_cnt ];
+  } else
   if ( !cat_list_empty ) {
     ensemble->source->SkipWS();
     bool quoted;
@@ -1215,6 +1289,7 @@ void Main::SeriesPrepare(
         series->html_db = ensemble->html_db;
       }
     }
+    series->raster_db = ensemble->raster_db;
 
     if ( series->type == SeriesType::Lollipop ) {
       lol_tot++;
@@ -1841,8 +1916,14 @@ void Main::Build( void )
 
   std::vector< LegendBox > lb_list;
 
-  SeriesPrepare( &lb_list );
-  AxisPrepare( tag_g );
+  {
+    Profile::Scope prof( "SeriesPrepare", id );
+    SeriesPrepare( &lb_list );
+  }
+  {
+    Profile::Scope prof( "AxisPrepare", id );
+    AxisPrepare( tag_g );
+  }
 
   std::vector< SVG::Object* > avoid_objects;
 
@@ -1881,7 +1962,10 @@ void Main::Build( void )
 
   BuildSeries( chartbox_below_axes_g, chartbox_above_axes_g, tag_g );
 
-  PlaceLegends( avoid_objects, lb_list, legend_g );
+  {
+    Profile::Scope prof( "PlaceLegends", id );
+    PlaceLegends( avoid_objects, lb_list, legend_g );
+  }
 
   if ( !title_inside ) {
     BuildTitle( avoid_objects );
@@ -16,6 +16,8 @@
 #include <list>
 
 #include <chart_common.h>
+#include <chart_hash.h>
+#include <chart_profile.h>
 #include <chart_source.h>
 #include <chart_annotate.h>
 #include <chart_label.h>
@@ -39,10 +41,28 @@ public:
 
   SVG::Group* GetGroup( void ) { return svg_g; }
 
+  // Index of the chart within the ensemble; used for profiling attribution.
+  uint32_t id = 0;
+
   // Used to move the completed chart (i.e. after Build()) to its
-  // final position in the grid,
+  // final position in the grid; the position is relative to where the chart
+  // was built, also if it has been moved before.
   void Move( SVG::U dx, SVG::U dy );
 
+  // Fingerprint of everything the chart is built from, as determined by the
+  // application; empty if unknown. A built chart can be reused by a later
+  // rendering of a chart with the same key (see Ensemble::SetReuse()).
+  std::string reuse_key;
+
+  // Set when the chart was taken over built from an earlier rendering; it is
+  // then not built again.
+  bool reused = false;
+
+  // Move a built chart to another ensemble, and add its series to the global
+  // legend of that ensemble as Build() would have done.
+  void SetEnsemble( Ensemble* ensemble );
+  void AddGlobalLegends( void );
+
   // Inform that this is an embedded chart.
   void SetEmbedded( bool embedded = true )
   {
@@ -127,9 +147,31 @@ public:
   // is empty.
   void SetCategoryAnchor( cat_idx_t num, bool empty );
 
+  // Add a range of n categories given in memory instead of in the source, for
+  // series fed with Series::SetData(); the names are copied and an empty name
+  // is an empty category.
+  void SetCategories( const std::string* cats, size_t n );
+
   // Called for each category as they are parsed from the source.
   void ParsedCat( cat_idx_t cat_idx, std::string_view cat );
 
+  // Summary of the categories of a block of data, which allows the block to be
+  // parsed once and its categories placed at any category index later on.
+  struct cat_summary_t {
+    cat_idx_t rows = 0;
+    bool      non_empty_seen = false;
+    cat_idx_t fst = 0;
+    cat_idx_t lst = 0;
+    cat_idx_t min_stride = 0;   // Zero if less than two are non-empty.
+    bool      normal_width = true;
+    void Add( std::string_view cat );
+  };
+
+  // Same as calling ParsedCat() for each of the summarized categories placed
+  // at consecutive indices starting at cat_ofs.
+  void ParsedCats( cat_idx_t cat_ofs, const cat_summary_t& summary );
+  void ParsedCat( cat_idx_t cat_idx, bool empty, bool normal_width );
+
   // Used to iterate through the categories directly in the source.
   void CategoryBegin();
   void CategoryLoad();
@@ -238,6 +280,8 @@ public:
     Source::position_t pos;
     cat_idx_t num = 0;
     bool empty = false;
+    bool fed = false;                 // Names are given in memory.
+    std::vector< std::string > names;
   };
 
   std::vector< category_anchor_t > category_anchor_list;
@@ -246,6 +290,7 @@ public:
   cat_idx_t cat_list_idx = 0;
   cat_idx_t cat_list_cnt = 0;
   bool      cat_list_empty = true;
+  bool      cat_list_fed = false;
 
   // Number of categories across all series.
   cat_idx_t category_num = 0;
@@ -268,8 +313,8 @@ public:
 
   // Used by HTML class.
   struct html_t {
-    std::unordered_set< uint64_t > snap_set;
-    std::unordered_set< cat_idx_t > cat_set;
+    FlatSet< uint64_t > snap_set;
+    FlatSet< cat_idx_t > cat_set;
 
     // Informs if all snap points are in line; for multiple bars per category
     // this will not be the case.
@@ -0,0 +1,164 @@
+//
+//  MIT No Attribution License
+//
+//  Copyright 2025, Soren Kragh
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the
+//  “Software”), to deal in the Software without restriction, including
+//  without limitation the rights to use, copy, modify, merge, publish,
+//  distribute, sublicense, and/or sell copies of the Software, and to
+//  permit persons to whom the Software is furnished to do so.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+
+#include <chart_profile.h>
+
+using namespace Chart;
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Profile::Enable( const std::string& file_name )
+{
+  Profile::file_name = file_name;
+  origin = std::chrono::steady_clock::now();
+  enabled = true;
+}
+
+uint32_t Profile::ThreadIdx( void )
+{
+  static std::atomic< uint32_t > next_idx{ 0 };
+  thread_local uint32_t idx = next_idx++;
+  return idx;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Profile::Scope::Begin(
+  const char* name, int64_t chart, int64_t series, std::string_view label
+)
+{
+  this->name = name;
+  this->chart = chart;
+  this->series = series;
+  this->label = label;
+  active = true;
+  t0 = std::chrono::steady_clock::now();
+}
+
+void Profile::Scope::End( void )
+{
+  auto t1 = std::chrono::steady_clock::now();
+  auto us = []( auto d ) {
+    return static_cast< uint64_t >(
+      std::chrono::duration_cast< std::chrono::microseconds >( d ).count()
+    );
+  };
+  event_t e;
+  e.name = name;
+  e.chart = chart;
+  e.series = series;
+  e.label = label;
+  e.ts = us( t0 - origin );
+  e.dur = us( t1 - t0 );
+  e.tid = ThreadIdx();
+  std::lock_guard< std::mutex > lock( mutex );
+  events.push_back( std::move( e ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Profile::Finish( void )
+{
+  if ( !enabled ) return;
+  std::lock_guard< std::mutex > lock( mutex );
+
+  auto quote = []( std::ostream& os, std::string_view s )
+  {
+    os << '"';
+    for ( char c : s ) {
+      if ( c == '"' || c == '\\' ) {
+        os << '\\' << c;
+      } else
+      if ( static_cast< unsigned char >( c ) < ' ' ) {
+        os << ' ';
+      } else {
+        os << c;
+      }
+    }
+    os << '"';
+  };
+
+  std::ofstream f( file_name );
+  if ( !f ) {
+    std::cerr << "*** WARNING: cannot write profile '" << file_name << "'\n";
+  } else {
+    f << "{\"traceEvents\":[\n";
+    bool first = true;
+    for ( const auto& e : events ) {
+      if ( !first ) f << ",\n";
+      first = false;
+      f << "{\"name\":";
+      quote( f, e.name );
+      f << ",\"cat\":\"chartus\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.tid;
+      f << ",\"ts\":" << e.ts << ",\"dur\":" << e.dur << ",\"args\":{";
+      const char* sep = "";
+      if ( e.chart >= 0 ) {
+        f << "\"chart\":" << e.chart;
+        sep = ",";
+      }
+      if ( e.series >= 0 ) {
+        f << sep << "\"series\":" << e.series;
+        sep = ",";
+      }
+      if ( !e.label.empty() ) {
+        f << sep << "\"label\":";
+        quote( f, e.label );
+      }
+      f << "}}";
+    }
+    f << "\n],\"displayTimeUnit\":\"ms\"}\n";
+  }
+
+  // Summary per phase, most expensive first.
+  struct sum_t {
+    uint64_t cnt = 0;
+    uint64_t tot = 0;
+    uint64_t max = 0;
+  };
+  std::map< std::string_view, sum_t > sums;
+  for ( const auto& e : events ) {
+    sum_t& s = sums[ e.name ];
+    s.cnt++;
+    s.tot += e.dur;
+    s.max = std::max( s.max, e.dur );
+  }
+  std::vector< std::pair< std::string_view, sum_t > > list(
+    sums.begin(), sums.end()
+  );
+  std::stable_sort(
+    list.begin(), list.end(),
+    []( const auto& a, const auto& b ) { return a.second.tot > b.second.tot; }
+  );
+  std::fprintf(
+    stderr, "%-20s %8s %12s %12s\n", "phase", "count", "total ms", "max ms"
+  );
+  for ( const auto& [ name, s ] : list ) {
+    std::fprintf(
+      stderr, "%-20.*s %8llu %12.3f %12.3f\n",
+      static_cast< int >( name.size() ), name.data(),
+      static_cast< unsigned long long >( s.cnt ), s.tot / 1000.0, s.max / 1000.0
+    );
+  }
+
+  events.clear();
+  enabled = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,94 @@
+//
+//  MIT No Attribution License
+//
+//  Copyright 2025, Soren Kragh
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the
+//  “Software”), to deal in the Software without restriction, including
+//  without limitation the rights to use, copy, modify, merge, publish,
+//  distribute, sublicense, and/or sell copies of the Software, and to
+//  permit persons to whom the Software is furnished to do so.
+//
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Chart {
+
+// Phase profiler. When enabled, scoped timings are recorded and written as
+// Chrome trace-event JSON (load in chrome://tracing or Perfetto) together with
+// a compact per-phase summary on stderr. When disabled a Scope amounts to a
+// single test of a static flag.
+class Profile
+{
+public:
+
+  // Enable recording; the trace is written to file_name by Finish().
+  static void Enable( const std::string& file_name );
+
+  static bool Enabled( void ) { return enabled; }
+
+  // Write the trace file and print the summary; does nothing if disabled.
+  static void Finish( void );
+
+  // Times the enclosing scope. The chart and series indices (-1 if not
+  // applicable) and the label are recorded as event arguments for
+  // attribution; the label must outlive the scope.
+  class Scope
+  {
+  public:
+    Scope(
+      const char* name,
+      int64_t chart = -1, int64_t series = -1, std::string_view label = {}
+    )
+    {
+      if ( enabled ) Begin( name, chart, series, label );
+    }
+    ~Scope( void )
+    {
+      if ( active ) End();
+    }
+
+  private:
+    void Begin(
+      const char* name, int64_t chart, int64_t series, std::string_view label
+    );
+    void End( void );
+
+    bool active = false;
+    const char* name = nullptr;
+    int64_t chart = -1;
+    int64_t series = -1;
+    std::string_view label;
+    std::chrono::steady_clock::time_point t0;
+  };
+
+private:
+
+  struct event_t {
+    const char* name;
+    int64_t chart;
+    int64_t series;
+    std::string label;
+    uint64_t ts;      // Start in microseconds since Enable().
+    uint64_t dur;     // Duration in microseconds.
+    uint32_t tid;
+  };
+
+  static uint32_t ThreadIdx( void );
+
+  static inline bool enabled = false;
+  static inline std::string file_name;
+  static inline std::chrono::steady_clock::time_point origin;
+  static inline std::mutex mutex;
+  static inline std::vector< event_t > events;
+};
+
+}
@@ -0,0 +1,1618 @@
+//
+//  MIT No Attribution License
+//
+//  Copyright 2025, Soren Kragh
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the
+//  “Software”), to deal in the Software without restriction, including
+//  without limitation the rights to use, copy, modify, merge, publish,
+//  distribute, sublicense, and/or sell copies of the Software, and to
+//  permit persons to whom the Software is furnished to do so.
+//
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <limits>
+#include <thread>
+
+#include <chart_raster.h>
+#include <chart_hash.h>
+
+using namespace Chart;
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+const uint8_t font_glyphs[ 95 ][ 9 ] = {
+  #include <chart_raster_font.h>
+};
+
+// Rows per band; bands are the unit of parallel work.
+constexpr uint32_t band_rows = 32;
+
+constexpr double pi = 3.14159265358979323846;
+
+bool IsSpace( char c )
+{
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+std::string_view Trim( std::string_view s )
+{
+  while ( !s.empty() && IsSpace( s.front() ) ) s.remove_prefix( 1 );
+  while ( !s.empty() && IsSpace( s.back() ) ) s.remove_suffix( 1 );
+  return s;
+}
+
+// Skip white space and commas separating numbers.
+void SkipSep( std::string_view s, size_t& i )
+{
+  while ( i < s.size() && (IsSpace( s[ i ] ) || s[ i ] == ',') ) i++;
+}
+
+bool GetNum( std::string_view s, size_t& i, double& d )
+{
+  SkipSep( s, i );
+  if ( i < s.size() && s[ i ] == '+' ) i++;
+  auto [ ptr, ec ] = std::from_chars( s.data() + i, s.data() + s.size(), d );
+  if ( ec != std::errc() ) return false;
+  i = ptr - s.data();
+  return true;
+}
+
+double ToNum( std::string_view s, double def = 0.0 )
+{
+  size_t i = 0;
+  double d;
+  return GetNum( s, i, d ) ? d : def;
+}
+
+struct named_color_t {
+  const char* name;
+  uint32_t rgb;
+};
+
+const named_color_t named_colors[] = {
+  { "aliceblue", 0xF0F8FF }, { "antiquewhite", 0xFAEBD7 },
+  { "aqua", 0x00FFFF }, { "aquamarine", 0x7FFFD4 }, { "azure", 0xF0FFFF },
+  { "beige", 0xF5F5DC }, { "bisque", 0xFFE4C4 }, { "black", 0x000000 },
+  { "blanchedalmond", 0xFFEBCD }, { "blue", 0x0000FF },
+  { "blueviolet", 0x8A2BE2 }, { "brown", 0xA52A2A },
+  { "burlywood", 0xDEB887 }, { "cadetblue", 0x5F9EA0 },
+  { "chartreuse", 0x7FFF00 }, { "chocolate", 0xD2691E },
+  { "coral", 0xFF7F50 }, { "cornflowerblue", 0x6495ED },
+  { "cornsilk", 0xFFF8DC }, { "crimson", 0xDC143C }, { "cyan", 0x00FFFF },
+  { "darkblue", 0x00008B }, { "darkcyan", 0x008B8B },
+  { "darkgoldenrod", 0xB8860B }, { "darkgray", 0xA9A9A9 },
+  { "darkgreen", 0x006400 }, { "darkgrey", 0xA9A9A9 },
+  { "darkkhaki", 0xBDB76B }, { "darkmagenta", 0x8B008B },
+  { "darkolivegreen", 0x556B2F }, { "darkorange", 0xFF8C00 },
+  { "darkorchid", 0x9932CC }, { "darkred", 0x8B0000 },
+  { "darksalmon", 0xE9967A }, { "darkseagreen", 0x8FBC8F },
+  { "darkslateblue", 0x483D8B }, { "darkslategray", 0x2F4F4F },
+  { "darkslategrey", 0x2F4F4F }, { "darkturquoise", 0x00CED1 },
+  { "darkviolet", 0x9400D3 }, { "deeppink", 0xFF1493 },
+  { "deepskyblue", 0x00BFFF }, { "dimgray", 0x696969 },
+  { "dimgrey", 0x696969 }, { "dodgerblue", 0x1E90FF },
+  { "firebrick", 0xB22222 }, { "floralwhite", 0xFFFAF0 },
+  { "forestgreen", 0x228B22 }, { "fuchsia", 0xFF00FF },
+  { "gainsboro", 0xDCDCDC }, { "ghostwhite", 0xF8F8FF },
+  { "gold", 0xFFD700 }, { "goldenrod", 0xDAA520 }, { "gray", 0x808080 },
+  { "grey", 0x808080 }, { "green", 0x008000 },
+  { "greenyellow", 0xADFF2F }, { "honeydew", 0xF0FFF0 },
+  { "hotpink", 0xFF69B4 }, { "indianred", 0xCD5C5C },
+  { "indigo", 0x4B0082 }, { "ivory", 0xFFFFF0 }, { "khaki", 0xF0E68C },
+  { "lavender", 0xE6E6FA }, { "lavenderblush", 0xFFF0F5 },
+  { "lawngreen", 0x7CFC00 }, { "lemonchiffon", 0xFFFACD },
+  { "lightblue", 0xADD8E6 }, { "lightcoral", 0xF08080 },
+  { "lightcyan", 0xE0FFFF }, { "lightgoldenrodyellow", 0xFAFAD2 },
+  { "lightgray", 0xD3D3D3 }, { "lightgreen", 0x90EE90 },
+  { "lightgrey", 0xD3D3D3 }, { "lightpink", 0xFFB6C1 },
+  { "lightsalmon", 0xFFA07A }, { "lightseagreen", 0x20B2AA },
+  { "lightskyblue", 0x87CEFA }, { "lightslategray", 0x778899 },
+  { "lightslategrey", 0x778899 }, { "lightsteelblue", 0xB0C4DE },
+  { "lightyellow", 0xFFFFE0 }, { "lime", 0x00FF00 },
+  { "limegreen", 0x32CD32 }, { "linen", 0xFAF0E6 },
+  { "magenta", 0xFF00FF }, { "maroon", 0x800000 },
+  { "mediumaquamarine", 0x66CDAA }, { "mediumblue", 0x0000CD },
+  { "mediumorchid", 0xBA55D3 }, { "mediumpurple", 0x9370DB },
+  { "mediumseagreen", 0x3CB371 }, { "mediumslateblue", 0x7B68EE },
+  { "mediumspringgreen", 0x00FA9A }, { "mediumturquoise", 0x48D1CC },
+  { "mediumvioletred", 0xC71585 }, { "midnightblue", 0x191970 },
+  { "mintcream", 0xF5FFFA }, { "mistyrose", 0xFFE4E1 },
+  { "moccasin", 0xFFE4B5 }, { "navajowhite", 0xFFDEAD },
+  { "navy", 0x000080 }, { "oldlace", 0xFDF5E6 }, { "olive", 0x808000 },
+  { "olivedrab", 0x6B8E23 }, { "orange", 0xFFA500 },
+  { "orangered", 0xFF4500 }, { "orchid", 0xDA70D6 },
+  { "palegoldenrod", 0xEEE8AA }, { "palegreen", 0x98FB98 },
+  { "paleturquoise", 0xAFEEEE }, { "palevioletred", 0xDB7093 },
+  { "papayawhip", 0xFFEFD5 }, { "peachpuff", 0xFFDAB9 },
+  { "peru", 0xCD853F }, { "pink", 0xFFC0CB }, { "plum", 0xDDA0DD },
+  { "powderblue", 0xB0E0E6 }, { "purple", 0x800080 },
+  { "rebeccapurple", 0x663399 }, { "red", 0xFF0000 },
+  { "rosybrown", 0xBC8F8F }, { "royalblue", 0x4169E1 },
+  { "saddlebrown", 0x8B4513 }, { "salmon", 0xFA8072 },
+  { "sandybrown", 0xF4A460 }, { "seagreen", 0x2E8B57 },
+  { "seashell", 0xFFF5EE }, { "sienna", 0xA0522D },
+  { "silver", 0xC0C0C0 }, { "skyblue", 0x87CEEB },
+  { "slateblue", 0x6A5ACD }, { "slategray", 0x708090 },
+  { "slategrey", 0x708090 }, { "snow", 0xFFFAFA },
+  { "springgreen", 0x00FF7F }, { "steelblue", 0x4682B4 },
+  { "tan", 0xD2B48C }, { "teal", 0x008080 }, { "thistle", 0xD8BFD8 },
+  { "tomato", 0xFF6347 }, { "turquoise", 0x40E0D0 },
+  { "violet", 0xEE82EE }, { "wheat", 0xF5DEB3 }, { "white", 0xFFFFFF },
+  { "whitesmoke", 0xF5F5F5 }, { "yellow", 0xFFFF00 },
+  { "yellowgreen", 0x9ACD32 },
+};
+
+// Decode XML character entities.
+std::string DecodeEntities( std::string_view s )
+{
+  std::string r;
+  r.reserve( s.size() );
+  size_t i = 0;
+  while ( i < s.size() ) {
+    if ( s[ i ] != '&' ) {
+      r += s[ i++ ];
+      continue;
+    }
+    size_t e = s.find( ';', i );
+    if ( e == std::string_view::npos ) {
+      r += s[ i++ ];
+      continue;
+    }
+    std::string_view ent = s.substr( i + 1, e - i - 1 );
+    i = e + 1;
+    if ( ent == "amp"  ) r += '&'; else
+    if ( ent == "lt"   ) r += '<'; else
+    if ( ent == "gt"   ) r += '>'; else
+    if ( ent == "quot" ) r += '"'; else
+    if ( ent == "apos" ) r += '\''; else
+    if ( !ent.empty() && ent[ 0 ] == '#' ) {
+      uint32_t cp = 0;
+      if ( ent.size() > 1 && (ent[ 1 ] == 'x' || ent[ 1 ] == 'X') ) {
+        std::from_chars( ent.data() + 2, ent.data() + ent.size(), cp, 16 );
+      } else {
+        std::from_chars( ent.data() + 1, ent.data() + ent.size(), cp );
+      }
+      // Code points outside ASCII only need to occupy one character cell.
+      r += (cp >= 0x20 && cp < 0x7F) ? char( cp ) : '\x7F';
+    }
+  }
+  return r;
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool Raster::ParseColor( std::string_view s, color_t& color )
+{
+  s = Trim( s );
+  color = color_t{};
+  if ( s.empty() || s == "none" || s == "transparent" ) return true;
+  auto set = [&]( uint32_t rgb ) {
+    color.r = ((rgb >> 16) & 0xFF) / 255.0f;
+    color.g = ((rgb >>  8) & 0xFF) / 255.0f;
+    color.b = ((rgb >>  0) & 0xFF) / 255.0f;
+    color.a = 1.0f;
+    color.none = false;
+  };
+  if ( s[ 0 ] == '#' ) {
+    uint32_t v = 0;
+    std::from_chars( s.data() + 1, s.data() + s.size(), v, 16 );
+    if ( s.size() == 4 ) {
+      uint32_t r = (v >> 8) & 0xF;
+      uint32_t g = (v >> 4) & 0xF;
+      uint32_t b = (v >> 0) & 0xF;
+      v = (r << 20) | (r << 16) | (g << 12) | (g << 8) | (b << 4) | b;
+    }
+    set( v );
+    return true;
+  }
+  if ( s.substr( 0, 3 ) == "rgb" ) {
+    size_t i = s.find( '(' );
+    if ( i == std::string_view::npos ) return false;
+    i++;
+    double c[ 4 ] = { 0, 0, 0, 1 };
+    for ( int n = 0; n < 4; n++ ) {
+      if ( !GetNum( s, i, c[ n ] ) ) break;
+      if ( i < s.size() && s[ i ] == '%' ) {
+        c[ n ] *= (n < 3) ? 2.55 : 0.01;
+        i++;
+      }
+    }
+    set( 0 );
+    color.r = std::clamp( c[ 0 ], 0.0, 255.0 ) / 255.0f;
+    color.g = std::clamp( c[ 1 ], 0.0, 255.0 ) / 255.0f;
+    color.b = std::clamp( c[ 2 ], 0.0, 255.0 ) / 255.0f;
+    color.a = std::clamp( c[ 3 ], 0.0, 1.0 );
+    return true;
+  }
+  if ( s == "currentColor" ) {
+    set( 0x000000 );
+    return true;
+  }
+  for ( const auto& nc : named_colors ) {
+    if ( s == nc.name ) {
+      set( nc.rgb );
+      return true;
+    }
+  }
+  return false;
+}
+
+Raster::matrix_t Raster::ParseTransform( std::string_view s )
+{
+  matrix_t m;
+  size_t i = 0;
+  while ( true ) {
+    SkipSep( s, i );
+    size_t b = s.find( '(', i );
+    if ( b == std::string_view::npos ) break;
+    size_t e = s.find( ')', b );
+    if ( e == std::string_view::npos ) break;
+    std::string_view fn = Trim( s.substr( i, b - i ) );
+    std::string_view args = s.substr( b + 1, e - b - 1 );
+    double v[ 6 ] = { 0, 0, 0, 0, 0, 0 };
+    int n = 0;
+    size_t j = 0;
+    while ( n < 6 && GetNum( args, j, v[ n ] ) ) n++;
+    matrix_t t;
+    if ( fn == "matrix" && n == 6 ) {
+      t.a = v[ 0 ]; t.b = v[ 1 ]; t.c = v[ 2 ];
+      t.d = v[ 3 ]; t.e = v[ 4 ]; t.f = v[ 5 ];
+    } else
+    if ( fn == "translate" ) {
+      t.e = v[ 0 ];
+      t.f = (n > 1) ? v[ 1 ] : 0.0;
+    } else
+    if ( fn == "scale" ) {
+      t.a = v[ 0 ];
+      t.d = (n > 1) ? v[ 1 ] : v[ 0 ];
+    } else
+    if ( fn == "rotate" ) {
+      double a = v[ 0 ] * pi / 180;
+      matrix_t r;
+      r.a = std::cos( a ); r.b = std::sin( a );
+      r.c = -r.b;          r.d = r.a;
+      if ( n == 3 ) {
+        matrix_t t1, t2;
+        t1.e = v[ 1 ]; t1.f = v[ 2 ];
+        t2.e = -v[ 1 ]; t2.f = -v[ 2 ];
+        r = t1 * r * t2;
+      }
+      t = r;
+    } else
+    if ( fn == "skewX" ) {
+      t.c = std::tan( v[ 0 ] * pi / 180 );
+    } else
+    if ( fn == "skewY" ) {
+      t.b = std::tan( v[ 0 ] * pi / 180 );
+    }
+    m = m * t;
+    i = e + 1;
+  }
+  return m;
+}
+
+//------------------------------------------------------------------------------
+
+std::vector< Raster::subpath_t > Raster::ParsePath( std::string_view s )
+{
+  std::vector< subpath_t > paths;
+  point_t cur{ 0, 0 };
+  point_t start{ 0, 0 };
+  point_t ctrl{ 0, 0 };       // Last control point for S/T.
+  char prev_cmd = 0;
+  char cmd = 0;
+  size_t i = 0;
+
+  auto line_to = [&]( point_t p ) {
+    if ( paths.empty() || paths.back().closed ) {
+      paths.emplace_back();
+      paths.back().pts.push_back( cur );
+    }
+    paths.back().pts.push_back( p );
+    cur = p;
+  };
+
+  auto cubic = [&]( point_t p1, point_t p2, point_t p3 ) {
+    point_t p0 = cur;
+    double len =
+      std::hypot( p1.x - p0.x, p1.y - p0.y ) +
+      std::hypot( p2.x - p1.x, p2.y - p1.y ) +
+      std::hypot( p3.x - p2.x, p3.y - p2.y );
+    int n = std::clamp( int( len / 2 ), 4, 64 );
+    for ( int k = 1; k <= n; k++ ) {
+      double t = double( k ) / n;
+      double u = 1 - t;
+      line_to( {
+        u*u*u*p0.x + 3*u*u*t*p1.x + 3*u*t*t*p2.x + t*t*t*p3.x,
+        u*u*u*p0.y + 3*u*u*t*p1.y + 3*u*t*t*p2.y + t*t*t*p3.y
+      } );
+    }
+  };
+
+  auto arc = [&](
+    double rx, double ry, double phi, bool large, bool sweep, point_t p
+  )
+  {
+    point_t p0 = cur;
+    rx = std::abs( rx );
+    ry = std::abs( ry );
+    if ( rx == 0 || ry == 0 ) {
+      line_to( p );
+      return;
+    }
+    double cp = std::cos( phi * pi / 180 );
+    double sp = std::sin( phi * pi / 180 );
+    double dx = (p0.x - p.x) / 2;
+    double dy = (p0.y - p.y) / 2;
+    double x1 =  cp * dx + sp * dy;
+    double y1 = -sp * dx + cp * dy;
+    double l = (x1 * x1) / (rx * rx) + (y1 * y1) / (ry * ry);
+    if ( l > 1 ) {
+      rx *= std::sqrt( l );
+      ry *= std::sqrt( l );
+    }
+    double num = rx*rx*ry*ry - rx*rx*y1*y1 - ry*ry*x1*x1;
+    double den = rx*rx*y1*y1 + ry*ry*x1*x1;
+    double k = (den > 0) ? std::sqrt( std::max( 0.0, num / den ) ) : 0.0;
+    if ( large == sweep ) k = -k;
+    double cx1 =  k * rx * y1 / ry;
+    double cy1 = -k * ry * x1 / rx;
+    double cx = cp * cx1 - sp * cy1 + (p0.x + p.x) / 2;
+    double cy = sp * cx1 + cp * cy1 + (p0.y + p.y) / 2;
+    double a1 = std::atan2( (y1 - cy1) / ry, (x1 - cx1) / rx );
+    double a2 = std::atan2( (-y1 - cy1) / ry, (-x1 - cx1) / rx );
+    double da = a2 - a1;
+    if ( sweep && da < 0 ) da += 2 * pi;
+    if ( !sweep && da > 0 ) da -= 2 * pi;
+    int n = std::clamp( int( std::abs( da ) * std::max( rx, ry ) / 2 ), 4, 128 );
+    for ( int j = 1; j < n; j++ ) {
+      double a = a1 + da * j / n;
+      double ex = rx * std::cos( a );
+      double ey = ry * std::sin( a );
+      line_to( { cp * ex - sp * ey + cx, sp * ex + cp * ey + cy } );
+    }
+    line_to( p );
+  };
+
+  while ( true ) {
+    SkipSep( s, i );
+    if ( i >= s.size() ) break;
+    char c = s[ i ];
+    if ( std::isalpha( static_cast< unsigned char >( c ) ) ) {
+      cmd = c;
+      i++;
+      if ( cmd == 'Z' || cmd == 'z' ) {
+        if ( !paths.empty() ) paths.back().closed = true;
+        cur = start;
+        prev_cmd = cmd;
+        continue;
+      }
+    } else
+    if ( cmd == 0 ) {
+      break;
+    }
+    bool rel = std::islower( static_cast< unsigned char >( cmd ) );
+    double ox = rel ? cur.x : 0.0;
+    double oy = rel ? cur.y : 0.0;
+    double v[ 7 ];
+    auto get = [&]( int n ) {
+      for ( int k = 0; k < n; k++ ) {
+        if ( !GetNum( s, i, v[ k ] ) ) return false;
+      }
+      return true;
+    };
+    auto get_flag = [&]( double& f ) {
+      SkipSep( s, i );
+      if ( i >= s.size() || (s[ i ] != '0' && s[ i ] != '1') ) return false;
+      f = s[ i++ ] - '0';
+      return true;
+    };
+    char uc = std::toupper( static_cast< unsigned char >( cmd ) );
+    bool ok = true;
+    switch ( uc ) {
+      case 'M':
+        if ( !(ok = get( 2 )) ) break;
+        cur = start = { ox + v[ 0 ], oy + v[ 1 ] };
+        paths.emplace_back();
+        paths.back().pts.push_back( cur );
+        // Subsequent coordinate pairs are implicit line-to commands.
+        cmd = rel ? 'l' : 'L';
+        break;
+      case 'L':
+        if ( !(ok = get( 2 )) ) break;
+        line_to( { ox + v[ 0 ], oy + v[ 1 ] } );
+        break;
+      case 'H':
+        if ( !(ok = get( 1 )) ) break;
+        line_to( { ox + v[ 0 ], cur.y } );
+        break;
+      case 'V':
+        if ( !(ok = get( 1 )) ) break;
+        line_to( { cur.x, oy + v[ 0 ] } );
+        break;
+      case 'C':
+        if ( !(ok = get( 6 )) ) break;
+        ctrl = { ox + v[ 2 ], oy + v[ 3 ] };
+        cubic(
+          { ox + v[ 0 ], oy + v[ 1 ] }, ctrl, { ox + v[ 4 ], oy + v[ 5 ] }
+        );
+        break;
+      case 'S':
+      {
+        if ( !(ok = get( 4 )) ) break;
+        point_t p1 = cur;
+        char pc = std::toupper( static_cast< unsigned char >( prev_cmd ) );
+        if ( pc == 'C' || pc == 'S' ) {
+          p1 = { 2 * cur.x - ctrl.x, 2 * cur.y - ctrl.y };
+        }
+        ctrl = { ox + v[ 0 ], oy + v[ 1 ] };
+        cubic( p1, ctrl, { ox + v[ 2 ], oy + v[ 3 ] } );
+        break;
+      }
+      case 'Q':
+      case 'T':
+      {
+        point_t q;
+        point_t p;
+        if ( uc == 'Q' ) {
+          if ( !(ok = get( 4 )) ) break;
+          q = { ox + v[ 0 ], oy + v[ 1 ] };
+          p = { ox + v[ 2 ], oy + v[ 3 ] };
+        } else {
+          if ( !(ok = get( 2 )) ) break;
+          q = cur;
+          char pc = std::toupper( static_cast< unsigned char >( prev_cmd ) );
+          if ( pc == 'Q' || pc == 'T' ) {
+            q = { 2 * cur.x - ctrl.x, 2 * cur.y - ctrl.y };
+          }
+          p = { ox + v[ 0 ], oy + v[ 1 ] };
+        }
+        ctrl = q;
+        cubic(
+          { cur.x + 2.0 / 3 * (q.x - cur.x), cur.y + 2.0 / 3 * (q.y - cur.y) },
+          { p.x + 2.0 / 3 * (q.x - p.x), p.y + 2.0 / 3 * (q.y - p.y) },
+          p
+        );
+        break;
+      }
+      case 'A':
+      {
+        if ( !(ok = get( 3 )) ) break;
+        if ( !(ok = get_flag( v[ 3 ] ) && get_flag( v[ 4 ] )) ) break;
+        double px, py;
+        if ( !(ok = GetNum( s, i, px ) && GetNum( s, i, py )) ) break;
+        arc(
+          v[ 0 ], v[ 1 ], v[ 2 ], v[ 3 ] != 0, v[ 4 ] != 0,
+          { ox + px, oy + py }
+        );
+        break;
+      }
+      default:
+        ok = false;
+        break;
+    }
+    if ( !ok ) break;
+    prev_cmd = cmd;
+  }
+
+  return paths;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Raster::ApplyStyle(
+  style_t& style, std::string_view name, std::string_view value
+)
+{
+  value = Trim( value );
+  auto paint = [&]( color_t& color ) {
+    if ( value.substr( 0, 4 ) == "url(" ) {
+      size_t b = value.find( '#' );
+      size_t e = value.find( ')' );
+      color = color_t{};
+      if ( b != std::string_view::npos && e != std::string_view::npos ) {
+        auto it = gradients.find( std::string( value.substr( b + 1, e - b - 1 ) ) );
+        if ( it != gradients.end() ) color = it->second;
+      }
+    } else {
+      ParseColor( value, color );
+    }
+  };
+  if ( name == "fill"           ) paint( style.fill ); else
+  if ( name == "stroke"         ) paint( style.stroke ); else
+  if ( name == "fill-opacity"   ) style.fill_opacity = ToNum( value, 1.0 ); else
+  if ( name == "stroke-opacity" ) style.stroke_opacity = ToNum( value, 1.0 ); else
+  if ( name == "opacity"        ) style.opacity *= ToNum( value, 1.0 ); else
+  if ( name == "stroke-width"   ) style.stroke_width = ToNum( value, 1.0 ); else
+  if ( name == "fill-rule"      ) style.even_odd = (value == "evenodd"); else
+  if ( name == "font-size"      ) style.font_size = ToNum( value, 16.0 ); else
+  if ( name == "stroke-linecap" ) {
+    style.round_cap  = (value == "round");
+    style.square_cap = (value == "square");
+  } else
+  if ( name == "stroke-dasharray" ) {
+    style.dash.clear();
+    size_t i = 0;
+    double d;
+    while ( GetNum( value, i, d ) ) style.dash.push_back( d );
+    if ( style.dash.size() % 2 ) {
+      std::vector< double > dup = style.dash;
+      style.dash.insert( style.dash.end(), dup.begin(), dup.end() );
+    }
+    double sum = 0;
+    for ( double x : style.dash ) sum += x;
+    if ( sum <= 0 ) style.dash.clear();
+  } else
+  if ( name == "font-weight" ) {
+    style.bold = (value == "bold" || value == "bolder" || ToNum( value ) >= 600);
+  } else
+  if ( name == "text-anchor" ) {
+    style.anchor = (value == "middle") ? 1 : ((value == "end") ? 2 : 0);
+  } else
+  if ( name == "dominant-baseline" || name == "alignment-baseline" ) {
+    if ( value == "middle" || value == "central" ) {
+      style.baseline = 0.35;
+    } else
+    if ( value == "hanging" || value == "text-before-edge" ) {
+      style.baseline = 0.75;
+    } else
+    if ( value == "text-after-edge" || value == "ideographic" ) {
+      style.baseline = -0.2;
+    } else {
+      style.baseline = 0.0;
+    }
+  } else
+  if ( name == "display" || name == "visibility" ) {
+    style.hidden = (value == "none" || value == "hidden");
+  } else
+  if ( name == "transform" ) {
+    style.matrix = style.matrix * ParseTransform( value );
+  } else
+  if ( name == "style" ) {
+    size_t i = 0;
+    while ( i < value.size() ) {
+      size_t e = value.find( ';', i );
+      if ( e == std::string_view::npos ) e = value.size();
+      std::string_view decl = value.substr( i, e - i );
+      size_t c = decl.find( ':' );
+      if ( c != std::string_view::npos ) {
+        ApplyStyle( style, Trim( decl.substr( 0, c ) ), decl.substr( c + 1 ) );
+      }
+      i = e + 1;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Add the given polygons (in user space) as one filled item.
+void Raster::AddItem(
+  const std::vector< path_t >& polys, const matrix_t& m,
+  const color_t& color, double opacity, bool even_odd
+)
+{
+  if ( color.none ) return;
+  double alpha = color.a * opacity;
+  if ( alpha <= 0 ) return;
+
+  item_t item;
+  item.r = color.r;
+  item.g = color.g;
+  item.b = color.b;
+  item.a = alpha;
+  item.even_odd = even_odd;
+  item.min_x = item.min_y = std::numeric_limits< double >::max();
+  item.max_x = item.max_y = std::numeric_limits< double >::lowest();
+
+  for ( const path_t& poly : polys ) {
+    if ( poly.size() < 3 ) continue;
+    for ( size_t i = 0; i < poly.size(); i++ ) {
+      point_t p0 = poly[ i ];
+      point_t p1 = poly[ (i + 1) % poly.size() ];
+      m.Apply( p0.x, p0.y );
+      m.Apply( p1.x, p1.y );
+      p0.x *= zoom; p0.y *= zoom;
+      p1.x *= zoom; p1.y *= zoom;
+      item.min_x = std::min( { item.min_x, p0.x, p1.x } );
+      item.max_x = std::max( { item.max_x, p0.x, p1.x } );
+      item.min_y = std::min( { item.min_y, p0.y, p1.y } );
+      item.max_y = std::max( { item.max_y, p0.y, p1.y } );
+      if ( p0.y == p1.y ) continue;
+      edge_t e;
+      e.dir = 1;
+      if ( p0.y > p1.y ) {
+        std::swap( p0, p1 );
+        e.dir = -1;
+      }
+      e.x0 = p0.x; e.y0 = p0.y;
+      e.x1 = p1.x; e.y1 = p1.y;
+      e.dxdy = (p1.x - p0.x) / (p1.y - p0.y);
+      item.edges.push_back( e );
+    }
+  }
+  if ( item.edges.empty() ) return;
+  if ( item.max_x < 0 || item.min_x > width ) return;
+  if ( item.max_y < 0 || item.min_y > height ) return;
+
+  std::sort(
+    item.edges.begin(), item.edges.end(),
+    []( const edge_t& a, const edge_t& b ) { return a.y0 < b.y0; }
+  );
+  items.push_back( std::move( item ) );
+}
+
+void Raster::FillPaths(
+  const std::vector< subpath_t >& paths, const style_t& style
+)
+{
+  std::vector< path_t > polys;
+  for ( const auto& sp : paths ) polys.push_back( sp.pts );
+  AddItem(
+    polys, style.matrix, style.fill,
+    style.fill_opacity * style.opacity, style.even_odd
+  );
+}
+
+// Convert strokes to polygons which are all oriented the same way, so that
+// the nonzero fill rule yields their union.
+void Raster::StrokePaths(
+  const std::vector< subpath_t >& paths, const style_t& style
+)
+{
+  double w = style.stroke_width;
+  if ( w <= 0 || style.stroke.none ) return;
+  double hw = w / 2;
+  double dev_w = w * style.matrix.Scale() * zoom;
+
+  std::vector< path_t > polys;
+
+  auto add_poly = [&]( path_t poly ) {
+    double area = 0;
+    for ( size_t i = 0; i < poly.size(); i++ ) {
+      const point_t& a = poly[ i ];
+      const point_t& b = poly[ (i + 1) % poly.size() ];
+      area += a.x * b.y - b.x * a.y;
+    }
+    if ( area < 0 ) std::reverse( poly.begin(), poly.end() );
+    polys.push_back( std::move( poly ) );
+  };
+
+  auto add_disc = [&]( point_t c ) {
+    int n = std::clamp( int( dev_w ), 8, 32 );
+    path_t poly;
+    for ( int k = 0; k < n; k++ ) {
+      double a = 2 * pi * k / n;
+      poly.push_back( { c.x + hw * std::cos( a ), c.y + hw * std::sin( a ) } );
+    }
+    add_poly( poly );
+  };
+
+  auto add_segment = [&]( point_t a, point_t b, bool cap_a, bool cap_b ) {
+    double dx = b.x - a.x;
+    double dy = b.y - a.y;
+    double len = std::hypot( dx, dy );
+    if ( len == 0 ) return;
+    double ux = dx / len;
+    double uy = dy / len;
+    if ( style.square_cap ) {
+      if ( cap_a ) { a.x -= ux * hw; a.y -= uy * hw; }
+      if ( cap_b ) { b.x += ux * hw; b.y += uy * hw; }
+    }
+    double nx = -uy * hw;
+    double ny =  ux * hw;
+    add_poly( {
+      { a.x + nx, a.y + ny }, { b.x + nx, b.y + ny },
+      { b.x - nx, b.y - ny }, { a.x - nx, a.y - ny }
+    } );
+  };
+
+  auto add_polyline = [&]( const path_t& pts, bool closed ) {
+    size_t n = pts.size();
+    if ( n < 2 ) return;
+    size_t segs = closed ? n : n - 1;
+    for ( size_t i = 0; i < segs; i++ ) {
+      add_segment(
+        pts[ i ], pts[ (i + 1) % n ],
+        !closed && i == 0, !closed && i + 1 == segs
+      );
+    }
+    // Joins are approximated by round joins; below about a pixel and a half
+    // the difference is not visible.
+    if ( dev_w > 1.5 ) {
+      for ( size_t i = closed ? 0 : 1; i < (closed ? n : n - 1); i++ ) {
+        add_disc( pts[ i ] );
+      }
+    }
+    if ( !closed && style.round_cap ) {
+      add_disc( pts.front() );
+      add_disc( pts.back() );
+    }
+  };
+
+  for ( const auto& sp : paths ) {
+    if ( style.dash.empty() ) {
+      add_polyline( sp.pts, sp.closed );
+      continue;
+    }
+    path_t pts = sp.pts;
+    if ( sp.closed && !pts.empty() ) pts.push_back( pts.front() );
+    size_t di = 0;
+    double left = style.dash[ 0 ];
+    bool on = true;
+    path_t dash;
+    for ( size_t i = 0; i + 1 < pts.size(); i++ ) {
+      point_t a = pts[ i ];
+      point_t b = pts[ i + 1 ];
+      double len = std::hypot( b.x - a.x, b.y - a.y );
+      double pos = 0;
+      if ( on && dash.empty() ) dash.push_back( a );
+      while ( len - pos > left ) {
+        pos += left;
+        double t = pos / len;
+        point_t p{ a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t };
+        if ( on ) {
+          dash.push_back( p );
+          add_polyline( dash, false );
+          dash.clear();
+        } else {
+          dash.push_back( p );
+        }
+        on = !on;
+        di = (di + 1) % style.dash.size();
+        left = style.dash[ di ];
+      }
+      left -= len - pos;
+      if ( on ) dash.push_back( b );
+    }
+    if ( on ) add_polyline( dash, false );
+  }
+
+  AddItem(
+    polys, style.matrix, style.stroke,
+    style.stroke_opacity * style.opacity, false
+  );
+}
+
+void Raster::DrawShape(
+  const std::vector< subpath_t >& paths, const style_t& style
+)
+{
+  if ( style.hidden ) return;
+  FillPaths( paths, style );
+  StrokePaths( paths, style );
+}
+
+//------------------------------------------------------------------------------
+
+void Raster::DrawText(
+  double x, double y, const std::string& txt, const style_t& style
+)
+{
+  if ( style.hidden || style.fill.none ) return;
+
+  // Count characters rather than bytes of UTF-8 sequences.
+  std::vector< uint8_t > chars;
+  for ( size_t i = 0; i < txt.size(); i++ ) {
+    uint8_t c = txt[ i ];
+    if ( (c & 0xC0) == 0x80 ) continue;
+    chars.push_back( (c >= 0x20 && c < 0x7F) ? c : '?' );
+  }
+
+  double px = style.font_size / 10;
+  double advance = 6 * px;
+  x -= advance * chars.size() * style.anchor / 2;
+  y += style.baseline * style.font_size;
+  double bold = style.bold ? px / 2 : 0;
+
+  std::vector< path_t > polys;
+  for ( size_t n = 0; n < chars.size(); n++ ) {
+    const uint8_t* glyph = font_glyphs[ chars[ n ] - 0x20 ];
+    double gx = x + n * advance + px / 2;
+    for ( int row = 0; row < 9; row++ ) {
+      double y1 = y + (row - 7) * px;
+      double y2 = y1 + px;
+      int bits = glyph[ row ];
+      int col = 0;
+      while ( col < 5 ) {
+        if ( !(bits & (0x10 >> col)) ) {
+          col++;
+          continue;
+        }
+        int c1 = col;
+        while ( col < 5 && (bits & (0x10 >> col)) ) col++;
+        double x1 = gx + c1 * px;
+        double x2 = gx + col * px + bold;
+        polys.push_back( { { x1, y1 }, { x2, y1 }, { x2, y2 }, { x1, y2 } } );
+      }
+    }
+  }
+
+  AddItem(
+    polys, style.matrix, style.fill, style.fill_opacity * style.opacity, false
+  );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Raster::Render( std::string_view svg, const RasterDirect* direct )
+{
+  items.clear();
+  gradients.clear();
+
+  std::vector< style_t > stack;
+  stack.emplace_back();
+  stack.back().fill.none = false;
+  stack.back().fill.a = 1.0f;
+  stack.back().stroke.none = true;
+
+  std::vector< std::string > tag_stack;
+
+  // Text element being collected.
+  bool in_text = false;
+  double text_x = 0;
+  double text_y = 0;
+  std::string text;
+  style_t text_style;
+
+  // Skipped subtree (defs content, titles etc.).
+  int skip_depth = 0;
+
+  // Gradients are approximated by the average of their stops.
+  std::string grad_id;
+  std::string grad_href;
+  int grad_depth = 0;
+  float grad_r = 0, grad_g = 0, grad_b = 0, grad_a = 0;
+  int grad_n = 0;
+
+  auto begin_gradient = [&]( std::string_view id, std::string_view href ) {
+    grad_id = std::string( id );
+    grad_href = std::string( href.empty() ? href : href.substr( 1 ) );
+    grad_r = grad_g = grad_b = grad_a = 0;
+    grad_n = 0;
+  };
+
+  auto end_gradient = [&]( void ) {
+    color_t c;
+    if ( grad_n > 0 ) {
+      c.r = grad_r / grad_n;
+      c.g = grad_g / grad_n;
+      c.b = grad_b / grad_n;
+      c.a = grad_a / grad_n;
+      c.none = false;
+    } else {
+      auto it = gradients.find( grad_href );
+      if ( it != gradients.end() ) c = it->second;
+    }
+    gradients[ grad_id ] = c;
+    grad_id.clear();
+  };
+
+  size_t i = 0;
+  while ( i < svg.size() ) {
+    size_t lt = svg.find( '<', i );
+    if ( lt == std::string_view::npos ) break;
+    if ( in_text && lt > i ) {
+      text += DecodeEntities( svg.substr( i, lt - i ) );
+    }
+    i = lt;
+    if ( svg.compare( i, 4, "<!--" ) == 0 ) {
+      size_t e = svg.find( "-->", i );
+      i = (e == std::string_view::npos) ? svg.size() : e + 3;
+      continue;
+    }
+    if ( svg.compare( i, 2, "<?" ) == 0 || svg.compare( i, 2, "<!" ) == 0 ) {
+      size_t e = svg.find( '>', i );
+      i = (e == std::string_view::npos) ? svg.size() : e + 1;
+      continue;
+    }
+    size_t gt = svg.find( '>', i );
+    if ( gt == std::string_view::npos ) break;
+
+    if ( svg[ i + 1 ] == '/' ) {
+      std::string_view name = Trim( svg.substr( i + 2, gt - i - 2 ) );
+      i = gt + 1;
+      if ( tag_stack.empty() ) continue;
+      tag_stack.pop_back();
+      if ( skip_depth > 0 ) {
+        if ( !grad_id.empty() && skip_depth == grad_depth ) end_gradient();
+        skip_depth--;
+        continue;
+      }
+      if ( name == "text" && in_text ) {
+        DrawText( text_x, text_y, text, text_style );
+        in_text = false;
+      }
+      if ( stack.size() > 1 ) stack.pop_back();
+      continue;
+    }
+
+    bool self_close = svg[ gt - 1 ] == '/';
+    std::string_view body =
+      svg.substr( i + 1, gt - i - 1 - (self_close ? 1 : 0) );
+    i = gt + 1;
+
+    size_t j = 0;
+    while ( j < body.size() && !IsSpace( body[ j ] ) ) j++;
+    std::string_view name = body.substr( 0, j );
+
+    std::vector< std::pair< std::string_view, std::string_view > > attrs;
+    while ( j < body.size() ) {
+      while ( j < body.size() && IsSpace( body[ j ] ) ) j++;
+      size_t eq = body.find( '=', j );
+      if ( eq == std::string_view::npos ) break;
+      std::string_view an = Trim( body.substr( j, eq - j ) );
+      size_t q1 = eq + 1;
+      while ( q1 < body.size() && IsSpace( body[ q1 ] ) ) q1++;
+      if ( q1 >= body.size() ) break;
+      char q = body[ q1 ];
+      size_t q2 = body.find( q, q1 + 1 );
+      if ( q2 == std::string_view::npos ) break;
+      attrs.emplace_back( an, body.substr( q1 + 1, q2 - q1 - 1 ) );
+      j = q2 + 1;
+    }
+    auto attr = [&]( std::string_view an ) -> std::string_view {
+      for ( auto& a : attrs ) if ( a.first == an ) return a.second;
+      return {};
+    };
+    auto num = [&]( std::string_view an, double def = 0.0 ) {
+      return ToNum( attr( an ), def );
+    };
+
+    auto is_gradient = [&]( void ) {
+      return name == "linearGradient" || name == "radialGradient";
+    };
+    auto href = [&]( void ) {
+      std::string_view h = attr( "href" );
+      return h.empty() ? attr( "xlink:href" ) : h;
+    };
+
+    if ( skip_depth > 0 ) {
+      if ( is_gradient() ) {
+        begin_gradient( attr( "id" ), href() );
+        grad_depth = skip_depth + 1;
+        if ( self_close ) end_gradient();
+      }
+      if ( name == "stop" && !grad_id.empty() ) {
+        style_t st;
+        color_t c;
+        double op = num( "stop-opacity", 1.0 );
+        ParseColor( attr( "stop-color" ), c );
+        std::string_view sa = attr( "style" );
+        if ( !sa.empty() ) {
+          size_t p = sa.find( "stop-color:" );
+          if ( p != std::string_view::npos ) {
+            size_t e = sa.find( ';', p );
+            ParseColor( sa.substr( p + 11, e == std::string_view::npos ? e : e - p - 11 ), c );
+          }
+          p = sa.find( "stop-opacity:" );
+          if ( p != std::string_view::npos ) op = ToNum( sa.substr( p + 13 ), 1.0 );
+        }
+        if ( !c.none ) {
+          grad_r += c.r;
+          grad_g += c.g;
+          grad_b += c.b;
+          grad_a += c.a * op;
+          grad_n++;
+        }
+      }
+      if ( !self_close ) {
+        tag_stack.emplace_back( name );
+        skip_depth++;
+      }
+      continue;
+    }
+
+    if (
+      name == "defs" || name == "title" || name == "desc" ||
+      name == "style" || name == "clipPath" || name == "mask" ||
+      name == "linearGradient" || name == "radialGradient" ||
+      name == "pattern" || name == "marker" || name == "symbol"
+    ) {
+      if ( is_gradient() ) {
+        begin_gradient( attr( "id" ), href() );
+        grad_depth = 1;
+        if ( self_close ) end_gradient();
+      }
+      if ( !self_close ) {
+        tag_stack.emplace_back( name );
+        skip_depth = 1;
+      }
+      continue;
+    }
+
+    style_t style = stack.back();
+    // Transform must be applied before the other attributes as it does not
+    // depend on them, but the order of attributes is otherwise irrelevant.
+    for ( auto& a : attrs ) {
+      if ( a.first != "transform" ) ApplyStyle( style, a.first, a.second );
+    }
+    {
+      std::string_view t = attr( "transform" );
+      if ( !t.empty() ) style.matrix = style.matrix * ParseTransform( t );
+    }
+
+    if ( name == "svg" && width == 0 ) {
+      double w = num( "width" );
+      double h = num( "height" );
+      std::string_view vb = attr( "viewBox" );
+      double v[ 4 ] = { 0, 0, w, h };
+      if ( !vb.empty() ) {
+        size_t k = 0;
+        for ( int n = 0; n < 4; n++ ) GetNum( vb, k, v[ n ] );
+        if ( w <= 0 ) w = v[ 2 ];
+        if ( h <= 0 ) h = v[ 3 ];
+      }
+      width  = std::max( 1u, uint32_t( std::ceil( w * zoom ) ) );
+      height = std::max( 1u, uint32_t( std::ceil( h * zoom ) ) );
+      matrix_t m;
+      if ( v[ 2 ] > 0 && v[ 3 ] > 0 ) {
+        m.a = w / v[ 2 ];
+        m.d = h / v[ 3 ];
+      }
+      m.e = -v[ 0 ] * m.a;
+      m.f = -v[ 1 ] * m.d;
+      style.matrix = style.matrix * m;
+    } else
+    if ( name == "rect" ) {
+      double x = num( "x" );
+      double y = num( "y" );
+      double w = num( "width" );
+      double h = num( "height" );
+      double rx = num( "rx", -1 );
+      double ry = num( "ry", -1 );
+      if ( rx < 0 ) rx = std::max( ry, 0.0 );
+      if ( ry < 0 ) ry = rx;
+      rx = std::min( rx, w / 2 );
+      ry = std::min( ry, h / 2 );
+      if ( w > 0 && h > 0 ) {
+        subpath_t sp;
+        sp.closed = true;
+        if ( rx > 0 && ry > 0 ) {
+          int n = std::clamp( int( std::max( rx, ry ) * zoom / 2 ), 3, 32 );
+          auto corner = [&]( double cx, double cy, double a0 ) {
+            for ( int k = 0; k <= n; k++ ) {
+              double a = a0 + pi / 2 * k / n;
+              sp.pts.push_back( { cx + rx * std::cos( a ), cy + ry * std::sin( a ) } );
+            }
+          };
+          corner( x + w - rx, y + ry    , -pi / 2 );
+          corner( x + w - rx, y + h - ry, 0       );
+          corner( x + rx    , y + h - ry, pi / 2  );
+          corner( x + rx    , y + ry    , pi      );
+        } else {
+          sp.pts = { { x, y }, { x + w, y }, { x + w, y + h }, { x, y + h } };
+        }
+        DrawShape( { sp }, style );
+      }
+    } else
+    if ( name == "circle" || name == "ellipse" ) {
+      double cx = num( "cx" );
+      double cy = num( "cy" );
+      double rx = (name == "circle") ? num( "r" ) : num( "rx" );
+      double ry = (name == "circle") ? rx : num( "ry" );
+      DrawCircle( cx, cy, rx, ry, style );
+    } else
+    if (
+      name == "line" && direct != nullptr &&
+      style.dash.size() >= 2 &&
+      style.dash[ 0 ] == RasterDirect::placeholder_dash
+    ) {
+      size_t idx = size_t( style.dash[ 1 ] ) - 1;
+      if ( idx < direct->entries.size() ) {
+        style.dash = stack.back().dash;
+        DrawDirect( direct->entries[ idx ], style );
+      }
+    } else
+    if ( name == "line" ) {
+      subpath_t sp;
+      sp.pts = {
+        { num( "x1" ), num( "y1" ) },
+        { num( "x2" ), num( "y2" ) }
+      };
+      StrokePaths( { sp }, style );
+    } else
+    if ( name == "polyline" || name == "polygon" ) {
+      std::string_view ps = attr( "points" );
+      subpath_t sp;
+      sp.closed = (name == "polygon");
+      size_t k = 0;
+      double x, y;
+      while ( GetNum( ps, k, x ) && GetNum( ps, k, y ) ) {
+        sp.pts.push_back( { x, y } );
+      }
+      if ( !style.hidden ) {
+        FillPaths( { sp }, style );
+        StrokePaths( { sp }, style );
+      }
+    } else
+    if ( name == "path" ) {
+      DrawShape( ParsePath( attr( "d" ) ), style );
+    } else
+    if ( name == "text" && !self_close ) {
+      in_text = true;
+      text.clear();
+      text_style = style;
+      text_x = num( "x" );
+      text_y = num( "y" );
+      std::string_view dy = attr( "dy" );
+      if ( !dy.empty() ) {
+        double d = ToNum( dy );
+        if ( dy.find( "em" ) != std::string_view::npos ) d *= style.font_size;
+        text_y += d;
+      }
+    }
+
+    if ( !self_close ) {
+      tag_stack.emplace_back( name );
+      stack.push_back( style );
+    }
+  }
+
+  Rasterize();
+}
+
+void Raster::DrawCircle(
+  double cx, double cy, double rx, double ry, const style_t& style
+)
+{
+  if ( rx <= 0 || ry <= 0 ) return;
+  double dev_r = std::max( rx, ry ) * style.matrix.Scale() * zoom;
+  int n = std::clamp( int( dev_r * 2 ), 8, 256 );
+  subpath_t sp;
+  sp.closed = true;
+  for ( int k = 0; k < n; k++ ) {
+    double a = 2 * pi * k / n;
+    sp.pts.push_back( { cx + rx * std::cos( a ), cy + ry * std::sin( a ) } );
+  }
+  DrawShape( { sp }, style );
+}
+
+// Each shape becomes items of its own, exactly as if it had been an element of
+// the SVG text.
+void Raster::DrawDirect(
+  const RasterDirect::entry_t& entry, const style_t& style
+)
+{
+  const RasterDirect::shape_t& shape = entry.shape;
+  auto draw = [&]( const std::vector< subpath_t >& paths ) {
+    if ( shape.stroke_only ) {
+      StrokePaths( paths, style );
+    } else {
+      DrawShape( paths, style );
+    }
+  };
+  if ( entry.at.empty() ) {
+    if ( shape.circle_r > 0 ) {
+      DrawCircle( 0, 0, shape.circle_r, shape.circle_r, style );
+    } else {
+      draw( shape.paths );
+    }
+    return;
+  }
+  std::vector< subpath_t > moved = shape.paths;
+  for ( const point_t& at : entry.at ) {
+    if ( shape.circle_r > 0 ) {
+      DrawCircle( at.x, at.y, shape.circle_r, shape.circle_r, style );
+      continue;
+    }
+    for ( size_t i = 0; i < moved.size(); i++ ) {
+      for ( size_t k = 0; k < moved[ i ].pts.size(); k++ ) {
+        moved[ i ].pts[ k ].x = shape.paths[ i ].pts[ k ].x + at.x;
+        moved[ i ].pts[ k ].y = shape.paths[ i ].pts[ k ].y + at.y;
+      }
+    }
+    draw( moved );
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// The edges of each item are distributed to the bands they overlap, so that a
+// band only visits the edges it needs rather than all edges of the items that
+// overlap it.
+void Raster::BuildBands( void )
+{
+  uint32_t band_num = (height + band_rows - 1) / band_rows;
+  bands.assign( band_num, band_t{} );
+  if ( band_num == 0 ) return;
+  for ( uint32_t i = 0; i < items.size(); i++ ) {
+    const item_t& item = items[ i ];
+    for ( uint32_t k = 0; k < item.edges.size(); k++ ) {
+      const edge_t& e = item.edges[ k ];
+      if ( e.y1 <= 0 || e.y0 >= height ) continue;
+      uint32_t b0 = uint32_t( std::max( 0.0, e.y0 ) ) / band_rows;
+      uint32_t b1 =
+        std::min( band_num - 1, uint32_t( std::ceil( e.y1 ) - 1 ) / band_rows );
+      for ( uint32_t b = b0; b <= b1; b++ ) {
+        band_t& band = bands[ b ];
+        if ( band.items.empty() || band.items.back() != i ) {
+          if ( !band.items.empty() ) {
+            band.edge_ofs.push_back( band.edges.size() );
+          }
+          band.items.push_back( i );
+        }
+        band.edges.push_back( k );
+      }
+    }
+  }
+  for ( band_t& band : bands ) {
+    if ( !band.items.empty() ) band.edge_ofs.push_back( band.edges.size() );
+  }
+}
+
+// Coverage is computed exactly by accumulating the signed area each edge
+// contributes to the cells it crosses, followed by a running sum along each
+// row. Stroke pieces all have the same orientation, so clamping the winding
+// magnitude to one gives their union under the nonzero rule; for even-odd the
+// accumulated winding is folded.
+void Raster::RasterizeBand( uint32_t band_idx )
+{
+  const band_t& band = bands[ band_idx ];
+  uint32_t y0 = band_idx * band_rows;
+  uint32_t y1 = std::min( height, y0 + band_rows );
+  size_t stride = width + 2;
+  std::vector< float > acc( stride * (y1 - y0), 0.0f );
+
+  uint32_t edge_beg = 0;
+  for ( size_t n = 0; n < band.items.size(); n++ ) {
+    const item_t& item = items[ band.items[ n ] ];
+    uint32_t edge_end = band.edge_ofs[ n ];
+    uint32_t r0 = std::max( y0, uint32_t( std::max( 0.0, std::floor( item.min_y ) ) ) );
+    uint32_t r1 = std::min( y1, uint32_t( std::max( 0.0, std::ceil( item.max_y ) ) ) );
+    if ( r0 >= r1 ) {
+      edge_beg = edge_end;
+      continue;
+    }
+    int c0 = std::clamp( int( std::floor( item.min_x ) ), 0, int( width ) );
+    int c1 = std::clamp( int( std::ceil( item.max_x ) ) + 1, 0, int( width ) + 1 );
+
+    for ( uint32_t k = edge_beg; k < edge_end; k++ ) {
+      const edge_t& e = item.edges[ band.edges[ k ] ];
+      if ( e.y0 >= r1 ) break;
+      if ( e.y1 <= r0 ) continue;
+      double ey0 = std::max( e.y0, double( r0 ) );
+      double ey1 = std::min( e.y1, double( r1 ) );
+      double x = e.x0 + (ey0 - e.y0) * e.dxdy;
+      for ( uint32_t row = uint32_t( ey0 ); row < r1 && row < ey1; row++ ) {
+        float* a = &acc[ (row - y0) * stride ];
+        double dy = std::min( double( row + 1 ), ey1 ) - std::max( double( row ), ey0 );
+        double xnext = x + e.dxdy * dy;
+        double d = dy * e.dir;
+        double xa = std::clamp( std::min( x, xnext ), 0.0, double( width ) );
+        double xb = std::clamp( std::max( x, xnext ), 0.0, double( width ) );
+        double xa_floor = std::floor( xa );
+        int ia = int( xa_floor );
+        int ib = int( std::ceil( xb ) );
+        if ( ib <= ia + 1 ) {
+          double xm = 0.5 * (xa + xb) - xa_floor;
+          a[ ia     ] += d - d * xm;
+          a[ ia + 1 ] += d * xm;
+        } else {
+          double s = 1 / (xb - xa);
+          double xaf = xa - xa_floor;
+          double a0 = 0.5 * s * (1 - xaf) * (1 - xaf);
+          double xbf = xb - ib + 1;
+          double am = 0.5 * s * xbf * xbf;
+          a[ ia ] += d * a0;
+          if ( ib == ia + 2 ) {
+            a[ ia + 1 ] += d * (1 - a0 - am);
+          } else {
+            double a1 = s * (1.5 - xaf);
+            a[ ia + 1 ] += d * (a1 - a0);
+            for ( int k = ia + 2; k < ib - 1; k++ ) a[ k ] += d * s;
+            double a2 = a1 + (ib - ia - 3) * s;
+            a[ ib - 1 ] += d * (1 - a2 - am);
+          }
+          a[ ib ] += d * am;
+        }
+        x = xnext;
+      }
+    }
+
+    for ( uint32_t row = r0; row < r1; row++ ) {
+      float* a = &acc[ (row - y0) * stride ];
+      float* p = &pixels[ (size_t( row ) * width + c0) * 4 ];
+      float sum = 0;
+      for ( int x = c0; x < c1; x++ ) {
+        sum += a[ x ];
+        a[ x ] = 0;
+        if ( x >= int( width ) ) continue;
+        float cov;
+        if ( item.even_odd ) {
+          cov = std::fmod( std::abs( sum ), 2.0f );
+          if ( cov > 1 ) cov = 2 - cov;
+        } else {
+          cov = std::min( std::abs( sum ), 1.0f );
+        }
+        float c = cov * item.a;
+        if ( c > 0.001f ) {
+          p[ 0 ] = item.r * c + p[ 0 ] * (1 - c);
+          p[ 1 ] = item.g * c + p[ 1 ] * (1 - c);
+          p[ 2 ] = item.b * c + p[ 2 ] * (1 - c);
+          p[ 3 ] =          c + p[ 3 ] * (1 - c);
+        }
+        p += 4;
+      }
+      for ( size_t x = c1; x < stride; x++ ) a[ x ] = 0;
+    }
+    edge_beg = edge_end;
+  }
+}
+
+void Raster::Rasterize( void )
+{
+  pixels.assign( size_t( width ) * height * 4, 0.0f );
+  BuildBands();
+
+  uint32_t band_num = bands.size();
+  std::atomic< uint32_t > next_band{ 0 };
+  auto worker = [&]( void ) {
+    while ( true ) {
+      uint32_t b = next_band++;
+      if ( b >= band_num ) break;
+      RasterizeBand( b );
+    }
+  };
+
+  uint32_t thread_cnt = threads;
+  if ( thread_cnt == 0 ) thread_cnt = std::thread::hardware_concurrency();
+  thread_cnt = std::clamp( thread_cnt, 1u, std::max( 1u, band_num ) );
+  std::vector< std::thread > workers;
+  for ( uint32_t t = 1; t < thread_cnt; t++ ) {
+    workers.emplace_back( worker );
+  }
+  worker();
+  for ( auto& t : workers ) t.join();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+// Deflate encoder using LZ77 with hash chains and the fixed Huffman code.
+class Deflate
+{
+public:
+
+  std::string out;
+
+  void Compress( const std::vector< uint8_t >& data )
+  {
+    // zlib header: deflate, 32K window, default compression.
+    out += char( 0x78 );
+    out += char( 0x9C );
+    PutBits( 1, 1 );    // BFINAL
+    PutBits( 1, 2 );    // BTYPE = fixed Huffman
+
+    constexpr uint32_t window   = 32768;
+    constexpr uint32_t hash_len = 1 << 15;
+    constexpr int max_chain     = 32;
+    std::vector< int32_t > head( hash_len, -1 );
+    std::vector< int32_t > prev( window, -1 );
+    size_t n = data.size();
+
+    auto hash = [&]( size_t i ) {
+      uint32_t h = (data[ i ] << 16) | (data[ i + 1 ] << 8) | data[ i + 2 ];
+      return (h * 2654435761u) >> 17;
+    };
+    auto insert = [&]( size_t i ) {
+      if ( i + 2 >= n ) return;
+      uint32_t h = hash( i );
+      prev[ i % window ] = head[ h ];
+      head[ h ] = i;
+    };
+
+    size_t i = 0;
+    while ( i < n ) {
+      uint32_t best_len = 0;
+      uint32_t best_dist = 0;
+      if ( i + 2 < n ) {
+        int32_t cand = head[ hash( i ) ];
+        int chain = max_chain;
+        uint32_t max_len = std::min< size_t >( 258, n - i );
+        while ( cand >= 0 && i - cand <= window - 1 && chain-- > 0 ) {
+          uint32_t l = 0;
+          while ( l < max_len && data[ cand + l ] == data[ i + l ] ) l++;
+          if ( l > best_len ) {
+            best_len = l;
+            best_dist = i - cand;
+            if ( l == max_len ) break;
+          }
+          int32_t p = prev[ cand % window ];
+          if ( p >= cand ) break;
+          cand = p;
+        }
+      }
+      if ( best_len >= 3 ) {
+        PutLength( best_len );
+        PutDistance( best_dist );
+        for ( uint32_t k = 0; k < best_len; k++ ) insert( i + k );
+        i += best_len;
+      } else {
+        PutLiteral( data[ i ] );
+        insert( i );
+        i++;
+      }
+    }
+    PutLiteral( 256 );
+    if ( bit_cnt > 0 ) PutBits( 0, 8 - bit_cnt );
+
+    uint32_t a = 1, b = 0;
+    for ( size_t k = 0; k < n; ) {
+      size_t e = std::min( n, k + 5552 );
+      for ( ; k < e; k++ ) {
+        a += data[ k ];
+        b += a;
+      }
+      a %= 65521;
+      b %= 65521;
+    }
+    uint32_t adler = (b << 16) | a;
+    for ( int s = 24; s >= 0; s -= 8 ) out += char( adler >> s );
+  }
+
+private:
+
+  uint32_t bit_buf = 0;
+  int bit_cnt = 0;
+
+  void PutBits( uint32_t v, int n )
+  {
+    bit_buf |= v << bit_cnt;
+    bit_cnt += n;
+    while ( bit_cnt >= 8 ) {
+      out += char( bit_buf & 0xFF );
+      bit_buf >>= 8;
+      bit_cnt -= 8;
+    }
+  }
+
+  // Huffman codes are sent most significant bit first.
+  void PutCode( uint32_t code, int n )
+  {
+    uint32_t r = 0;
+    for ( int k = 0; k < n; k++ ) {
+      r = (r << 1) | ((code >> k) & 1);
+    }
+    PutBits( r, n );
+  }
+
+  void PutLiteral( uint32_t v )
+  {
+    if ( v < 144 ) PutCode( 0x30 + v, 8 ); else
+    if ( v < 256 ) PutCode( 0x190 + v - 144, 9 ); else
+    if ( v < 280 ) PutCode( v - 256, 7 ); else
+    PutCode( 0xC0 + v - 280, 8 );
+  }
+
+  void PutLength( uint32_t len )
+  {
+    static const uint16_t base[ 29 ] = {
+      3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+      35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+    };
+    static const uint8_t extra[ 29 ] = {
+      0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+      3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+    };
+    int k = 28;
+    while ( base[ k ] > len ) k--;
+    PutLiteral( 257 + k );
+    if ( extra[ k ] ) PutBits( len - base[ k ], extra[ k ] );
+  }
+
+  void PutDistance( uint32_t dist )
+  {
+    static const uint16_t base[ 30 ] = {
+      1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+      257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+      8193, 12289, 16385, 24577
+    };
+    int k = 29;
+    while ( base[ k ] > dist ) k--;
+    PutCode( k, 5 );
+    int extra = (k < 4) ? 0 : (k / 2 - 1);
+    if ( extra ) PutBits( dist - base[ k ], extra );
+  }
+};
+
+}
+
+std::string Raster::GenPNG( void )
+{
+  // Convert to straight alpha and apply the per-row filter giving the
+  // smallest sum of absolute differences.
+  size_t stride = size_t( width ) * 4;
+  std::vector< uint8_t > img( stride * height );
+  for ( size_t k = 0; k < img.size(); k += 4 ) {
+    float a = pixels[ k + 3 ];
+    float inv = (a > 0) ? 1 / a : 0;
+    for ( int c = 0; c < 3; c++ ) {
+      img[ k + c ] = uint8_t( std::clamp( pixels[ k + c ] * inv, 0.0f, 1.0f ) * 255 + 0.5f );
+    }
+    img[ k + 3 ] = uint8_t( std::clamp( a, 0.0f, 1.0f ) * 255 + 0.5f );
+  }
+
+  std::vector< uint8_t > raw;
+  raw.reserve( (stride + 1) * height );
+  std::vector< uint8_t > trial[ 5 ];
+  for ( auto& t : trial ) t.resize( stride );
+  for ( uint32_t y = 0; y < height; y++ ) {
+    const uint8_t* cur = &img[ y * stride ];
+    const uint8_t* up = (y > 0) ? &img[ (y - 1) * stride ] : nullptr;
+    uint32_t best = 0;
+    uint64_t best_sum = UINT64_MAX;
+    for ( uint32_t f = 0; f < 5; f++ ) {
+      uint64_t sum = 0;
+      for ( size_t x = 0; x < stride; x++ ) {
+        int a = (x >= 4) ? cur[ x - 4 ] : 0;
+        int b = up ? up[ x ] : 0;
+        int c = (up && x >= 4) ? up[ x - 4 ] : 0;
+        int pred = 0;
+        switch ( f ) {
+          case 1: pred = a; break;
+          case 2: pred = b; break;
+          case 3: pred = (a + b) / 2; break;
+          case 4:
+          {
+            int p = a + b - c;
+            int pa = std::abs( p - a );
+            int pb = std::abs( p - b );
+            int pc = std::abs( p - c );
+            pred = (pa <= pb && pa <= pc) ? a : ((pb <= pc) ? b : c);
+            break;
+          }
+        }
+        uint8_t v = cur[ x ] - pred;
+        trial[ f ][ x ] = v;
+        sum += (v < 128) ? v : 256 - v;
+      }
+      if ( sum < best_sum ) {
+        best_sum = sum;
+        best = f;
+      }
+    }
+    raw.push_back( best );
+    raw.insert( raw.end(), trial[ best ].begin(), trial[ best ].end() );
+  }
+
+  Deflate deflate;
+  deflate.Compress( raw );
+
+  std::string png = "\x89PNG\r\n\x1A\n";
+  auto put32 = [&]( std::string& s, uint32_t v ) {
+    for ( int k = 24; k >= 0; k -= 8 ) s += char( v >> k );
+  };
+  auto chunk = [&]( const char* type, const std::string& data ) {
+    put32( png, data.size() );
+    std::string body = type + data;
+    png += body;
+    put32( png, CRC32( body.data(), body.size() ) );
+  };
+
+  std::string ihdr;
+  put32( ihdr, width );
+  put32( ihdr, height );
+  ihdr += char( 8 );    // Bit depth
+  ihdr += char( 6 );    // RGBA
+  ihdr += char( 0 );    // Deflate
+  ihdr += char( 0 );    // Adaptive filtering
+  ihdr += char( 0 );    // No interlace
+  chunk( "IHDR", ihdr );
+  chunk( "IDAT", deflate.out );
+  chunk( "IEND", "" );
+
+  return png;
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,218 @@
+//
+//  MIT No Attribution License
+//
+//  Copyright 2025, Soren Kragh
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the
+//  “Software”), to deal in the Software without restriction, including
+//  without limitation the rights to use, copy, modify, merge, publish,
+//  distribute, sublicense, and/or sell copies of the Software, and to
+//  permit persons to whom the Software is furnished to do so.
+//
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+
+namespace Chart {
+
+// Geometry handed directly to the raster backend by the series instead of
+// going through the SVG text. In the SVG the geometry is represented by a
+// placeholder line tagged with a dash pattern of placeholder_dash followed by
+// the index of the entry plus one; the geometry is drawn in the place and with
+// the style of the placeholder, but without its dash pattern.
+class RasterDirect
+{
+public:
+
+  static constexpr double placeholder_dash = 7777777;
+
+  struct point_t {
+    double x;
+    double y;
+  };
+
+  struct subpath_t {
+    std::vector< point_t > pts;
+    bool closed = false;
+  };
+
+  struct shape_t {
+    std::vector< subpath_t > paths;
+    double circle_r = 0;        // A circle of this radius if above zero.
+    bool stroke_only = false;   // Lines, which are never filled.
+  };
+
+  // The shape is drawn once, or if any points are given once moved to each of
+  // the points.
+  struct entry_t {
+    shape_t shape;
+    std::vector< point_t > at;
+  };
+
+  uint32_t Add( shape_t&& shape, std::vector< point_t >&& at = {} )
+  {
+    entries.push_back( { std::move( shape ), std::move( at ) } );
+    return entries.size() - 1;
+  }
+
+  std::vector< entry_t > entries;
+};
+
+// Native raster backend. The SVG library has no raster hooks of its own, so
+// the raster backend consumes the subset of SVG that the canvas generates and
+// scan-converts it directly into a pixel buffer; text is drawn with an
+// embedded monospace bitmap font and the result is encoded as PNG with a
+// self-contained deflate encoder.
+class Raster
+{
+public:
+
+  Raster( double zoom = 1.0 ) : zoom( zoom ) {}
+
+  // Number of threads rasterizing bands concurrently; 0 means one per
+  // hardware thread.
+  void SetThreads( uint32_t threads ) { this->threads = threads; }
+
+  // Render an SVG document as generated by SVG::Canvas::GenSVG(); placeholders
+  // are replaced by the geometry of direct.
+  void Render( std::string_view svg, const RasterDirect* direct = nullptr );
+
+  // Encode the rendered image as PNG.
+  std::string GenPNG( void );
+
+  uint32_t width  = 0;
+  uint32_t height = 0;
+
+private:
+
+  double zoom;
+  uint32_t threads = 0;
+
+  struct color_t {
+    float r = 0;
+    float g = 0;
+    float b = 0;
+    float a = 0;
+    bool none = true;
+  };
+
+  struct matrix_t {
+    double a = 1, b = 0, c = 0, d = 1, e = 0, f = 0;
+    void Apply( double& x, double& y ) const
+    {
+      double nx = a * x + c * y + e;
+      double ny = b * x + d * y + f;
+      x = nx;
+      y = ny;
+    }
+    matrix_t operator*( const matrix_t& m ) const
+    {
+      matrix_t r;
+      r.a = a * m.a + c * m.b;
+      r.b = b * m.a + d * m.b;
+      r.c = a * m.c + c * m.d;
+      r.d = b * m.c + d * m.d;
+      r.e = a * m.e + c * m.f + e;
+      r.f = b * m.e + d * m.f + f;
+      return r;
+    }
+    double Scale( void ) const
+    {
+      return std::sqrt( std::abs( a * d - b * c ) );
+    }
+  };
+
+  struct style_t {
+    matrix_t matrix;
+    color_t fill;
+    color_t stroke;
+    double fill_opacity   = 1.0;
+    double stroke_opacity = 1.0;
+    double opacity        = 1.0;
+    double stroke_width   = 1.0;
+    std::vector< double > dash;
+    bool even_odd    = false;
+    bool round_cap   = false;
+    bool square_cap  = false;
+    double font_size = 16.0;
+    bool bold        = false;
+    int anchor       = 0;      // 0: start, 1: middle, 2: end
+    double baseline  = 0.0;    // Baseline shift in units of font size.
+    bool hidden      = false;
+  };
+
+  using point_t = RasterDirect::point_t;
+  using path_t = std::vector< point_t >;
+  using subpath_t = RasterDirect::subpath_t;
+
+  struct edge_t {
+    double x0, y0;   // Always y0 < y1.
+    double x1, y1;
+    double dxdy;
+    int dir;
+  };
+
+  // One filled shape; painted in document order.
+  struct item_t {
+    std::vector< edge_t > edges;   // Sorted on y0.
+    float r, g, b, a;
+    bool even_odd;
+    double min_x, min_y, max_x, max_y;
+  };
+
+  std::vector< item_t > items;
+
+  // Edge table; for each band of rows, the items overlapping it in painting
+  // order, each with the indices of its edges overlapping the band.
+  struct band_t {
+    std::vector< uint32_t > items;
+    std::vector< uint32_t > edge_ofs;   // Into edges, one past each item.
+    std::vector< uint32_t > edges;
+  };
+  std::vector< band_t > bands;
+  std::vector< float > pixels;     // Premultiplied RGBA.
+
+  std::unordered_map< std::string, color_t > gradients;
+
+  static bool ParseColor( std::string_view s, color_t& color );
+  static matrix_t ParseTransform( std::string_view s );
+  static std::vector< subpath_t > ParsePath( std::string_view s );
+
+  void ApplyStyle(
+    style_t& style, std::string_view name, std::string_view value
+  );
+
+  void AddItem(
+    const std::vector< path_t >& polys, const matrix_t& m,
+    const color_t& color, double opacity, bool even_odd
+  );
+  void FillPaths(
+    const std::vector< subpath_t >& paths, const style_t& style
+  );
+  void StrokePaths(
+    const std::vector< subpath_t >& paths, const style_t& style
+  );
+  void DrawShape(
+    const std::vector< subpath_t >& paths, const style_t& style
+  );
+  void DrawText(
+    double x, double y, const std::string& txt, const style_t& style
+  );
+  void DrawCircle(
+    double cx, double cy, double rx, double ry, const style_t& style
+  );
+  void DrawDirect( const RasterDirect::entry_t& entry, const style_t& style );
+
+  void BuildBands( void );
+  void RasterizeBand( uint32_t band );
+  void Rasterize( void );
+};
+
+}
@@ -14,15 +14,41 @@
 #include <chart_series.h>
 #include <chart_main.h>
 #include <chart_ensemble.h>
+#include <chart_raster.h>
 
-#include <unordered_set>
 #include <charconv>
+#include <type_traits>
 
 using namespace SVG;
 using namespace Chart;
 
 ////////////////////////////////////////////////////////////////////////////////
 
+namespace {
+
+// Call f with a std::bool_constant for each of the flags, such that the
+// per-datum loops can be specialized on flags that are invariant within the
+// loop; the dispatch is done once per series.
+template< typename F >
+void Specialize( F&& f )
+{
+  f();
+}
+
+template< typename F, typename... Flags >
+void Specialize( F&& f, bool flag, Flags... flags )
+{
+  if ( flag ) {
+    Specialize( [&]( auto... c ) { f( std::true_type{}, c... ); }, flags... );
+  } else {
+    Specialize( [&]( auto... c ) { f( std::false_type{}, c... ); }, flags... );
+  }
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 Series::Series( Main* main, SeriesType type )
 {
   this->type = type;
@@ -316,6 +342,66 @@ void Series::ApplyTagStyle( SVG::Object* obj )
 ////////////////////////////////////////////////////////////////////////////////
 
 void Series::PrunePolyAdd( prune_state_t& ps, SVG::Point p )
+{
+  if ( !prune_m4 ) {
+    PrunePolyPut( ps, p );
+    return;
+  }
+
+  // Pixel columns run along the X-axis, which may be vertical.
+  bool vertical = axis_x->angle != 0;
+  int64_t col = static_cast< int64_t >( std::floor( vertical ? p.y : p.x ) );
+  auto val = [&]( Point q ) { return vertical ? q.x : q.y; };
+
+  if ( ps.m4_cnt > 0 && col != ps.m4_col ) {
+    PruneM4Flush( ps );
+  }
+  if ( ps.m4_cnt == 0 ) {
+    ps.m4_col = col;
+    ps.m4_fst = ps.m4_min = ps.m4_max = p;
+    ps.m4_min_idx = ps.m4_max_idx = 0;
+  } else {
+    if ( val( p ) < val( ps.m4_min ) ) {
+      ps.m4_min = p;
+      ps.m4_min_idx = ps.m4_cnt;
+    }
+    if ( val( p ) > val( ps.m4_max ) ) {
+      ps.m4_max = p;
+      ps.m4_max_idx = ps.m4_cnt;
+    }
+  }
+  ps.m4_lst = p;
+  ps.m4_cnt++;
+}
+
+// Pass the first, min, max, and last point of the current pixel column on to
+// the normal pruning in the order they occurred. The extremes are preserved as
+// snap points so that HTML snapping still reaches spikes.
+void Series::PruneM4Flush( prune_state_t& ps )
+{
+  if ( ps.m4_cnt == 0 ) return;
+
+  size_t idx[ 4 ] = { 0, ps.m4_min_idx, ps.m4_max_idx, ps.m4_cnt - 1 };
+  Point pts[ 4 ] = { ps.m4_fst, ps.m4_min, ps.m4_max, ps.m4_lst };
+  if ( idx[ 1 ] > idx[ 2 ] ) {
+    std::swap( idx[ 1 ], idx[ 2 ] );
+    std::swap( pts[ 1 ], pts[ 2 ] );
+  }
+
+  if ( ps.html_enable ) {
+    for ( int i = 0; i < 4; ++i ) {
+      html_db->PreserveSnapPoint( this, pts[ i ] );
+    }
+  }
+  for ( int i = 0; i < 4; ++i ) {
+    if ( i > 0 && idx[ i ] == idx[ i - 1 ] ) continue;
+    PrunePolyPut( ps, pts[ i ] );
+  }
+
+  ps.m4_cnt = 0;
+}
+
+void Series::PrunePolyPut( prune_state_t& ps, SVG::Point p )
 {
   // Returns the distance from p to the line going from e1 to e2. The sign of
   // the returned distance indicates if p lies to the left (positive) or the
@@ -428,6 +514,7 @@ void Series::PrunePolyAdd( prune_state_t& ps, SVG::Point p )
 
 void Series::PrunePolyEnd( prune_state_t& ps )
 {
+  PruneM4Flush( ps );
   if ( ps.html_enable ) {
     html_db->PreserveSnapPoint( this, ps.p1 );
     html_db->PreserveSnapPoint( this, ps.e1 );
@@ -452,16 +539,17 @@ void Series::PrunePolyEnd( prune_state_t& ps )
 uint64_t Series::PrunePointsKey( SVG::Point p )
 {
   return
-    (static_cast< uint64_t >( p.y * prune_dist_inv ) << 32) |
-    (static_cast< uint64_t >( p.x * prune_dist_inv ) <<  0);
+    (static_cast< uint64_t >( p.y * iso_dist_inv ) << 32) |
+    (static_cast< uint64_t >( p.x * iso_dist_inv ) <<  0);
 }
 
 void Series::PrunePointsAdd( prune_state_t& ps, SVG::Point p )
 {
   if ( type != SeriesType::Scatter && prune_dist >= prune_dist_min ) {
     // Make sure extremes are included; for Scatter plot this does not make
-    // sense as the points are totally random.
-    PrunePolyAdd( ps, p );
+    // sense as the points are totally random. Markers are never subject to M4
+    // decimation as that is handled by the isolated point pruning below.
+    PrunePolyPut( ps, p );
   } else {
     if ( ++ps.cnt == 1 ) {
       ps.points.clear();
@@ -471,12 +559,12 @@ void Series::PrunePointsAdd( prune_state_t& ps, SVG::Point p )
     }
   }
   if ( ps.cnt == 1 ) {
-    ps.iso_exists.clear();
+    ps.iso_exists.Clear();
     ps.iso_points.clear();
   }
-  if ( prune_dist >= prune_dist_min ) {
+  if ( iso_dist_inv > 0.0 ) {
     uint64_t key = PrunePointsKey( p );
-    if ( ps.iso_exists.insert( { key, p } ).second ) {
+    if ( ps.iso_exists.Insert( key, p ).second ) {
       ps.iso_points.push_back( p );
       if ( ps.html_enable ) {
         html_db->PreserveSnapPoint( this, p );
@@ -494,7 +582,7 @@ void Series::PrunePointsEnd( prune_state_t& ps )
 {
   if ( ps.cnt == 0 ) {
     ps.points.clear();
-    ps.iso_exists.clear();
+    ps.iso_exists.Clear();
     ps.iso_points.clear();
   }
   if ( type != SeriesType::Scatter && prune_dist >= prune_dist_min ) {
@@ -507,8 +595,8 @@ void Series::PrunePointsEnd( prune_state_t& ps )
   ps.cnt = 0;
   for ( const auto& p : ps.points ) {
     uint64_t key = PrunePointsKey( p );
-    auto it = ps.iso_exists.find( key );
-    if ( it == ps.iso_exists.end() || it->second != p ) {
+    SVG::Point* q = ps.iso_exists.Find( key );
+    if ( q == nullptr || *q != p ) {
       ps.iso_points.push_back( p );
     }
   }
@@ -554,6 +642,162 @@ void Series::SetDatumAnchor(
   datum_num = num;
   datum_no_x = no_x;
   datum_y_idx = y_idx;
+  datum_index.reset();
+}
+
+void Series::SetData(
+  const double* x, const double* y, size_t n, cat_idx_t cat_ofs
+)
+{
+  // Values that cannot be represented in the text format are invalid.
+  auto fix = []( double d )
+  {
+    if ( d == num_skip || d == num_invalid ) return d;
+    return (std::isnan( d ) || std::abs( d ) > num_hi) ? num_invalid : d;
+  };
+
+  min_max_t mm_x;
+  min_max_t mm_y;
+  auto index = std::make_shared< datum_index_t >();
+  fed_x.clear();
+  fed_y.resize( n );
+  if ( !is_cat ) fed_x.resize( n );
+  for ( size_t i = 0; i < n; ++i ) {
+    fed_y[ i ] = fix( y[ i ] );
+    mm_y.Update( fed_y[ i ], cat_ofs + i );
+    if ( !is_cat ) {
+      fed_x[ i ] = fix( x[ i ] );
+      mm_x.Update( fed_x[ i ] );
+    }
+    index->Add( is_cat ? num_skip : fed_x[ i ] );
+  }
+  RecordMinMax( mm_x, mm_y );
+  datum_index = index;
+
+  datum_defined = true;
+  datum_fed = true;
+  datum_cat_ofs = cat_ofs;
+  datum_num = n;
+  datum_no_x = is_cat;
+  datum_y_idx = 0;
+}
+
+void Series::FedText( std::string_view& svx, std::string_view& svy )
+{
+  auto fmt = []( char* buf, double d ) -> std::string_view
+  {
+    if ( d == num_skip ) return "-";
+    if ( d == num_invalid ) return "!";
+    return FmtShortest( buf, d );
+  };
+  svy = fmt( fed_buf_y, fed_y[ fed_idx ] );
+  svx = is_cat ? std::string_view{} : fmt( fed_buf_x, fed_x[ fed_idx ] );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Series::datum_index_t::Add( double x, const Source::position_t* pos )
+{
+  if ( num++ % stride == 0 ) {
+    if ( pos ) this->pos.push_back( *pos );
+    this->x.push_back( x_max );
+  }
+  if ( std::abs( x ) <= num_hi ) {
+    if ( x < x_max ) x_sorted = false;
+    x_max = x;
+  }
+}
+
+bool Series::BeyondRangeX( double x, bool after )
+{
+  U c = axis_x->Coor( x );
+  if ( axis_x->angle == 0 ) {
+    return
+      (after != axis_x->reverse)
+      ? c > chart_area.max.x + e2
+      : c < chart_area.min.x - e2;
+  } else {
+    return
+      (after != axis_x->reverse)
+      ? c > chart_area.max.y + e2
+      : c < chart_area.min.y - e2;
+  }
+}
+
+// The index is not used for staircase XY series, where the X-values of the
+// corners are not known up front.
+bool Series::DatumRangeIndexed( void )
+{
+  return
+    datum_index && datum_index->x.size() > 1 &&
+    (datum_fed || datum_index->pos.size() == datum_index->x.size()) &&
+    (is_cat || (datum_index->x_sorted && !staircase));
+}
+
+void Series::DatumSeek( size_t k )
+{
+  if ( datum_fed ) {
+    fed_idx = k * datum_index_t::stride;
+  } else {
+    source->cur_pos = datum_index->pos[ k ];
+    source->LoadLine();
+  }
+}
+
+// Points lying beyond the chart area before the X-axis range produce no
+// output and do not affect the following points, as long as the first datum
+// visited is such a point or a break in the line (or is skipped until one of
+// those). All datums before the index entry chosen are known to lie before
+// the range, and the first datum from the entry is checked; if it fails, an
+// earlier entry is tried.
+size_t Series::DatumBeginRange( void )
+{
+  DatumBegin();
+  if ( !DatumRangeIndexed() ) return 0;
+
+  const size_t stride = datum_index_t::stride;
+  double stair = staircase ? 0.5 : 0.0;
+  auto before = [&]( size_t k )
+  {
+    if ( k == 0 ) return true;
+    double x =
+      is_cat ? datum_cat_ofs + k * stride - 1 + stair : datum_index->x[ k ];
+    return BeyondRangeX( x, false );
+  };
+
+  size_t lo = 0;
+  size_t hi = datum_index->x.size();
+  while ( hi - lo > 1 ) {
+    size_t k = (lo + hi) / 2;
+    if ( before( k ) ) lo = k; else hi = k;
+  }
+
+  for ( size_t k = lo; k > 0; --k ) {
+    DatumSeek( k );
+    bool ok = true;
+    for ( size_t i = k * stride; i < datum_num; ++i, DatumNext() ) {
+      std::string_view svx;
+      std::string_view svy;
+      double x = datum_cat_ofs + i;
+      double y;
+      GetDatum( svx, svy, x, y );
+      if ( axis_x->Valid( x ) && axis_y->Valid( y ) ) {
+        ok = BeyondRangeX( x + stair, false );
+        break;
+      }
+      if ( axis_x->Skip( x ) || (axis_x->Valid( x ) && axis_y->Skip( y )) ) {
+        continue;
+      }
+      break;
+    }
+    if ( ok ) {
+      DatumSeek( k );
+      return k * stride;
+    }
+  }
+
+  DatumBegin();
+  return 0;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1082,6 +1326,152 @@ void Series::BuildMarker( Group* g, const MarkerDims& m, SVG::Point p )
   return;
 }
 
+//------------------------------------------------------------------------------
+
+void Series::BuildMarkers(
+  Group* mark_g, Group* hole_g, const std::vector< SVG::Point >& points
+)
+{
+  if ( points.empty() ) return;
+  if ( raster_db == nullptr ) {
+    for ( auto& p : points ) {
+      if ( marker_show_out ) BuildMarker( mark_g, marker_out, p );
+      if ( marker_show_int ) BuildMarker( hole_g, marker_int, p );
+    }
+    return;
+  }
+
+  // The same shapes as built by BuildMarker() centered at the origin.
+  auto shape_of = [&]( const MarkerDims& m )
+  {
+    RasterDirect::shape_t shape;
+    auto poly = [&]( std::vector< RasterDirect::point_t > pts, bool closed )
+    {
+      shape.paths.push_back( { std::move( pts ), closed } );
+    };
+    switch ( marker_shape ) {
+      case MarkerShape::Circle :
+        shape.circle_r = m.x2;
+        break;
+      case MarkerShape::Square :
+        poly(
+          { { m.x1, m.y1 }, { m.x2, m.y1 }, { m.x2, m.y2 }, { m.x1, m.y2 } },
+          true
+        );
+        break;
+      case MarkerShape::Triangle :
+        poly( { { 0, m.y2 }, { m.x2, m.y1 }, { m.x1, m.y1 } }, true );
+        break;
+      case MarkerShape::InvTriangle :
+        poly( { { 0, m.y1 }, { m.x2, m.y2 }, { m.x1, m.y2 } }, true );
+        break;
+      case MarkerShape::Diamond :
+        poly( { { m.x2, 0 }, { 0, m.y2 }, { m.x1, 0 }, { 0, m.y1 } }, true );
+        break;
+      case MarkerShape::Cross :
+        poly( { { m.x1, m.y1 }, { m.x2, m.y2 } }, false );
+        poly( { { m.x2, m.y1 }, { m.x1, m.y2 } }, false );
+        shape.stroke_only = true;
+        break;
+      case MarkerShape::Star : {
+        const double d = 0.35;
+        poly(
+          { { m.x2, 0 }, { m.x2 * d, m.y2 * d },
+            { 0, m.y2 }, { m.x1 * d, m.y2 * d },
+            { m.x1, 0 }, { m.x1 * d, m.y1 * d },
+            { 0, m.y1 }, { m.x2 * d, m.y1 * d }
+          },
+          true
+        );
+        break;
+      }
+      case MarkerShape::LineX :
+      case MarkerShape::LineY :
+        poly( { { m.x1, m.y1 }, { m.x2, m.y2 } }, false );
+        shape.stroke_only = true;
+        break;
+      default :
+        break;
+    }
+    return shape;
+  };
+
+  std::vector< RasterDirect::point_t > at;
+  at.reserve( points.size() );
+  BoundaryBox bb;
+  for ( auto& p : points ) {
+    at.push_back( { p.x, p.y } );
+    bb.Update( p.x, p.y );
+  }
+  auto add = [&]( Group* g, const MarkerDims& m )
+  {
+    U rx = std::max( std::abs( m.x1 ), std::abs( m.x2 ) );
+    U ry = std::max( std::abs( m.y1 ), std::abs( m.y2 ) );
+    if ( marker_shape == MarkerShape::Circle ) ry = rx;
+    BoundaryBox mbb{ bb };
+    mbb.min.x -= rx;
+    mbb.min.y -= ry;
+    mbb.max.x += rx;
+    mbb.max.y += ry;
+    std::vector< RasterDirect::point_t > copy{ at };
+    uint32_t idx = raster_db->Add( shape_of( m ), std::move( copy ) );
+    AddRasterPlaceholder( g, idx, mbb );
+  };
+  if ( marker_show_out ) add( mark_g, marker_out );
+  if ( marker_show_int ) add( hole_g, marker_int );
+}
+
+void Series::BuildPoly(
+  Group* g, const std::vector< SVG::Point >& points, bool closed
+)
+{
+  if ( points.empty() ) return;
+  if ( raster_db != nullptr ) {
+    RasterDirect::shape_t shape;
+    shape.paths.emplace_back();
+    shape.paths.back().closed = closed;
+    shape.paths.back().pts.reserve( points.size() );
+    BoundaryBox bb;
+    for ( auto& p : points ) {
+      shape.paths.back().pts.push_back( { p.x, p.y } );
+      bb.Update( p.x, p.y );
+    }
+    AddRasterPlaceholder( g, raster_db->Add( std::move( shape ) ), bb );
+    return;
+  }
+  if ( closed ) {
+    Poly* poly = new Poly();
+    g->Add( poly );
+    for ( auto& p : points ) {
+      poly->Add( p );
+    }
+    poly->Close();
+    return;
+  }
+  auto it = points.cbegin();
+  uint64_t d = (points.size() + max_poly - 1) / max_poly;
+  uint64_t n = 0;
+  for ( uint64_t i = 1; i <= d; ++i ) {
+    uint64_t m = points.size() * i / d;
+    Poly* poly = new Poly();
+    g->Add( poly );
+    while ( n < m ) {
+      poly->Add( *(it++) );
+      ++n;
+    }
+  }
+}
+
+// The placeholder line spans the bounding box of the geometry, so the bounding
+// box of the group is as if the geometry itself had been added.
+void Series::AddRasterPlaceholder(
+  Group* g, uint32_t idx, const BoundaryBox& bb
+)
+{
+  g->Add( new Line( bb.min, bb.max ) );
+  g->Last()->Attr()->SetLineDash( RasterDirect::placeholder_dash, idx + 1 );
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 void Series::ComputeStackDir()
@@ -1093,8 +1483,10 @@ void Series::ComputeStackDir()
   for ( size_t i = 0; i < datum_num; ++i, DatumNext() ) {
     std::string_view svx;
     std::string_view svy;
-    source->GetDatum( svx, svy, datum_no_x, datum_y_idx );
-    double y = DatumToDouble( svy ) - base;
+    double x;
+    double y;
+    GetDatum( svx, svy, x, y );
+    y -= base;
     if ( y < 0 ) {
       stack_dir = -1;
       return;
@@ -1148,9 +1540,9 @@ void Series::DetermineMinMax(
     for ( size_t i = 0; i < datum_num; ++i, DatumNext() ) {
       std::string_view svx;
       std::string_view svy;
-      source->GetDatum( svx, svy, datum_no_x, datum_y_idx );
       double x;
-      double y = DatumToDouble( svy );
+      double y;
+      GetDatum( svx, svy, x, y );
       if ( !axis_y->Valid( y ) ) continue;
       if ( is_cat ) {
         x = datum_cat_ofs + i;
@@ -1158,7 +1550,6 @@ void Series::DetermineMinMax(
         idx_of_lst_valid = x;
         idx_of_valid_defined = true;
       } else {
-        x = DatumToDouble( svx );
         if ( !axis_x->Valid( x ) ) continue;
       }
       if ( stackable ) {
@@ -1267,6 +1658,32 @@ void Series::BuildArea(
   std::vector< SVG::Point >* base_pts
 )
 {
+  Specialize(
+    [&]( auto swap, auto log_y )
+    {
+      BuildAreaT< decltype( swap )::value, decltype( log_y )::value >(
+        fill_g, line_g, mark_g, hole_g, tag_g, base_ofs, base_pts
+      );
+    },
+    axis_x->angle != 0, axis_y->log_scale
+  );
+}
+
+template< bool Swap, bool LogY >
+void Series::BuildAreaT(
+  Group* fill_g,
+  Group* line_g,
+  Group* mark_g,
+  Group* hole_g,
+  Group* tag_g,
+  std::vector< double >* base_ofs,
+  std::vector< SVG::Point >* base_pts
+)
+{
+  // The X-axis is a category axis and thus never logarithmic.
+  const Axis::Mapper< false > map_x( axis_x );
+  const Axis::Mapper< LogY > map_y( axis_y );
+
   prune_state_t fill_ps;
   prune_state_t line_ps;
   prune_state_t mark_ps;
@@ -1275,9 +1692,13 @@ void Series::BuildArea(
   line_ps.html_enable = html_db != nullptr && !marker_show;
   mark_ps.html_enable = html_db != nullptr && marker_show;
 
+  if ( marker_show ) {
+    mark_ps.iso_exists.Reserve( std::min( datum_num, max_reserve ) );
+  }
+
   Pos tag_direction;
   bool reverse = axis_y->reverse ^ (stack_dir < 0);
-  if ( axis_x->angle == 0 ) {
+  if ( !Swap ) {
     tag_direction = reverse ? Pos::Bottom : Pos::Top;
   } else {
     tag_direction = reverse ? Pos::Left : Pos::Right;
@@ -1301,20 +1722,7 @@ void Series::BuildArea(
   auto commit_line = [&]( void )
   {
     PrunePolyEnd( line_ps );
-    if ( has_line && !line_ps.points.empty() ) {
-      auto it = line_ps.points.cbegin();
-      uint64_t d = (line_ps.points.size() + max_poly - 1) / max_poly;
-      uint64_t n = 0;
-      for ( uint64_t i = 1; i <= d; ++i ) {
-        uint64_t m = line_ps.points.size() * i / d;
-        Poly* poly = new Poly();
-        line_g->Add( poly );
-        while ( n < m ) {
-          poly->Add( *(it++) );
-          ++n;
-        }
-      }
-    }
+    if ( has_line ) BuildPoly( line_g, line_ps.points, false );
   };
 
   Point ap_prv_p;
@@ -1371,7 +1779,7 @@ void Series::BuildArea(
     bool on_line = true
   )
   {
-    if ( axis_x->angle != 0 ) std::swap( p.x, p.y );
+    if ( Swap ) std::swap( p.x, p.y );
     bool inside = Inside( p );
     if ( dp_first ) {
       if ( inside ) {
@@ -1428,12 +1836,12 @@ void Series::BuildArea(
       end_y = base_ofs->back();
     }
     Point beg_p{
-      axis_x->Coor( 0 ),
-      axis_y->Coor( beg_y )
+      map_x.Coor( 0 ),
+      map_y.Coor( beg_y )
     };
     Point end_p{
-      axis_x->Coor( main->category_num - 1 ),
-      axis_y->Coor( end_y )
+      map_x.Coor( main->category_num - 1 ),
+      map_y.Coor( end_y )
     };
     if ( first_in_stack ) do_point( beg_p, 0, "", "", false );
     double prv_base = 0;
@@ -1451,17 +1859,17 @@ void Series::BuildArea(
       }
       if ( idx_of_valid_defined ) {
         if ( cat_idx >= idx_of_fst_valid && cat_idx <= idx_of_lst_valid ) {
-          source->GetDatum( svx, svy, datum_no_x, datum_y_idx );
-          y = DatumToDouble( svy );
+          double x;
+          GetDatum( svx, svy, x, y );
         }
       }
       if ( axis_y->Skip( y ) ) {
         continue;
       }
-      bool valid = axis_y->Valid( y );
+      bool valid = map_y.Valid( y );
       y -= base;
       if ( !first && prv_valid && !valid ) {
-        Point p{ axis_x->Coor( cat_idx - 1 ), axis_y->Coor( base ) };
+        Point p{ map_x.Coor( cat_idx - 1 ), map_y.Coor( base ) };
         do_point( p, cat_idx, svx, svy, false );
       }
       if ( !valid ) y = 0;
@@ -1473,10 +1881,10 @@ void Series::BuildArea(
         y += base;
       }
       if ( !first && !prv_valid && valid ) {
-        Point p{ axis_x->Coor( cat_idx ), axis_y->Coor( base ) };
+        Point p{ map_x.Coor( cat_idx ), map_y.Coor( base ) };
         do_point( p, cat_idx, svx, svy, false );
       }
-      Point p{ axis_x->Coor( cat_idx ), axis_y->Coor( y ) };
+      Point p{ map_x.Coor( cat_idx ), map_y.Coor( y ) };
       do_point( p, cat_idx, svx, svy, valid );
       prv_valid = valid;
       first = false;
@@ -1485,22 +1893,12 @@ void Series::BuildArea(
   }
 
   PrunePolyEnd( fill_ps );
-  if ( !fill_ps.points.empty() ) {
-    Poly* poly = new Poly();
-    fill_g->Add( poly );
-    for ( auto& p : fill_ps.points ) {
-      poly->Add( p );
-    }
-    poly->Close();
-  }
+  BuildPoly( fill_g, fill_ps.points, true );
 
   commit_line();
 
   PrunePointsEnd( mark_ps );
-  for ( auto& p : mark_ps.points ) {
-    if ( marker_show_out ) BuildMarker( mark_g, marker_out, p );
-    if ( marker_show_int ) BuildMarker( hole_g, marker_int, p );
-  }
+  BuildMarkers( mark_g, hole_g, mark_ps.points );
 
   if ( type == SeriesType::StackedArea ) {
     PrunePointsEnd( base_ps );
@@ -1525,6 +1923,36 @@ void Series::BuildBar(
   std::vector< double >* ofs_neg
 )
 {
+  Specialize(
+    [&]( auto swap, auto log_y )
+    {
+      BuildBarT< decltype( swap )::value, decltype( log_y )::value >(
+        fill_g, tbar_g, line_g, mark_g, hole_g, tag_g,
+        bar_num, bar_tot, ofs_pos, ofs_neg
+      );
+    },
+    axis_x->angle != 0, axis_y->log_scale
+  );
+}
+
+template< bool Swap, bool LogY >
+void Series::BuildBarT(
+  Group* fill_g,
+  Group* tbar_g,
+  Group* line_g,
+  Group* mark_g,
+  Group* hole_g,
+  Group* tag_g,
+  uint32_t bar_num,
+  uint32_t bar_tot,
+  std::vector< double >* ofs_pos,
+  std::vector< double >* ofs_neg
+)
+{
+  // The X-axis is a category axis and thus never logarithmic.
+  const Axis::Mapper< false > map_x( axis_x );
+  const Axis::Mapper< LogY > map_y( axis_y );
+
   Pos zero_direction = Pos::Auto;
   {
     bool has_pos_bar = false;
@@ -1533,14 +1961,15 @@ void Series::BuildBar(
     for ( size_t i = 0; i < datum_num; ++i, DatumNext() ) {
       std::string_view svx;
       std::string_view svy;
-      source->GetDatum( svx, svy, datum_no_x, datum_y_idx );
-      double y = DatumToDouble( svy );
-      if ( axis_y->Valid( y ) ) {
+      double x;
+      double y;
+      GetDatum( svx, svy, x, y );
+      if ( map_y.Valid( y ) ) {
         if ( y - base > 0 ) has_pos_bar = true;
         if ( y - base < 0 ) has_neg_bar = true;
       }
     }
-    if ( axis_x->angle == 0 ) {
+    if ( !Swap ) {
       if ( axis_y->reverse ) {
         zero_direction = (has_pos_bar || !has_neg_bar) ? Pos::Bottom : Pos::Top;
       } else {
@@ -1574,6 +2003,9 @@ void Series::BuildBar(
     }
   }
 
+  // Half the width of a bar in SVG units.
+  U w = std::abs( map_x.Coor( wx / 2 ) - map_x.Coor( 0 ) );
+
   Point p1;
   Point p2;
 
@@ -1583,28 +2015,28 @@ void Series::BuildBar(
     double x = cat_idx + cx;
     std::string_view svx;
     std::string_view svy;
-    source->GetDatum( svx, svy, datum_no_x, datum_y_idx );
-    double y = DatumToDouble( svy );
-    if ( !axis_y->Valid( y ) ) continue;
+    double y;
+    GetDatum( svx, svy, x, y );
+    if ( !map_y.Valid( y ) ) continue;
 
-    U q = axis_x->Coor( x );
+    U q = map_x.Coor( x );
     p1.x = p2.x = q;
     if ( type == SeriesType::Lollipop ) {
-      p1.y = axis_y->Coor( base );
-      p2.y = axis_y->Coor( y );
+      p1.y = map_y.Coor( base );
+      p2.y = map_y.Coor( y );
     } else {
       double yb = y - base;
       if ( yb < 0 ) {
-        p1.y = axis_y->Coor( ofs_neg->at( cat_idx ) );
+        p1.y = map_y.Coor( ofs_neg->at( cat_idx ) );
         ofs_neg->at( cat_idx ) += yb;
-        p2.y = axis_y->Coor( ofs_neg->at( cat_idx ) );
+        p2.y = map_y.Coor( ofs_neg->at( cat_idx ) );
       } else {
-        p1.y = axis_y->Coor( ofs_pos->at( cat_idx ) );
+        p1.y = map_y.Coor( ofs_pos->at( cat_idx ) );
         ofs_pos->at( cat_idx ) += yb;
-        p2.y = axis_y->Coor( ofs_pos->at( cat_idx ) );
+        p2.y = map_y.Coor( ofs_pos->at( cat_idx ) );
       }
     }
-    if ( axis_x->angle != 0 ) {
+    if ( Swap ) {
       std::swap( p1.x, p1.y );
       std::swap( p2.x, p2.y );
     }
@@ -1627,7 +2059,7 @@ void Series::BuildBar(
         p1 = c1;
         p2 = c2;
       }
-      if ( axis_x->angle == 0 ) {
+      if ( !Swap ) {
         p1.x = p2.x = q;
       } else {
         p1.y = p2.y = q;
@@ -1665,12 +2097,11 @@ void Series::BuildBar(
         type == SeriesType::StackedBar
       )
     ) {
-      U w = std::abs( axis_x->Coor( wx / 2 ) - axis_x->Coor( 0 ) );
       bool cut_bot = false;
       bool cut_top = false;
       bool cut_lft = false;
       bool cut_rgt = false;
-      if ( axis_x->angle == 0 ) {
+      if ( !Swap ) {
         p1.x -= w;
         p2.x += w;
         if ( p1.y < p2.y ) {
@@ -1780,23 +2211,52 @@ void Series::BuildLine(
   Group* tag_g
 )
 {
+  Specialize(
+    [&]( auto swap, auto staircase, auto log_x, auto log_y )
+    {
+      BuildLineT<
+        decltype( swap )::value, decltype( staircase )::value,
+        decltype( log_x )::value, decltype( log_y )::value
+      >(
+        line_g, mark_g, hole_g, tag_g
+      );
+    },
+    axis_x->angle != 0, staircase, axis_x->log_scale, axis_y->log_scale
+  );
+}
+
+template< bool Swap, bool Staircase, bool LogX, bool LogY >
+void Series::BuildLineT(
+  Group* line_g,
+  Group* mark_g,
+  Group* hole_g,
+  Group* tag_g
+)
+{
+  const Axis::Mapper< LogX > map_x( axis_x );
+  const Axis::Mapper< LogY > map_y( axis_y );
+
   prune_state_t line_ps;
   prune_state_t mark_ps;
 
   line_ps.html_enable = html_db != nullptr && has_line;
   mark_ps.html_enable = html_db != nullptr && !has_line;
 
+  if ( marker_show ) {
+    mark_ps.iso_exists.Reserve( std::min( datum_num, max_reserve ) );
+  }
+
   bool at_staircase_corner = false;
   bool adding_segments = false;
 
   Pos tag_direction;
-  if ( axis_x->angle == 0 ) {
+  if ( !Swap ) {
     tag_direction = axis_y->reverse ? Pos::Bottom : Pos::Top;
   } else {
     tag_direction = axis_y->reverse ? Pos::Left : Pos::Right;
   }
-  if ( staircase ) {
-    if ( axis_x->angle == 0 ) {
+  if ( Staircase ) {
+    if ( !Swap ) {
       if ( tag_pos == Pos::Bottom || tag_pos == Pos::Top ) {
         tag_direction = tag_pos;
       }
@@ -1836,7 +2296,7 @@ void Series::BuildLine(
         html_db->CommitSnapPoints( this, true );
       }
       if ( tag_enable ) {
-        if ( staircase ) {
+        if ( Staircase ) {
           main->tag_db->BarTag( this, tag_g, p, p, tag_y, tag_direction );
         } else {
           main->tag_db->LineTag(
@@ -1853,25 +2313,9 @@ void Series::BuildLine(
   auto end_point = [&]( void )
   {
     PrunePolyEnd( line_ps );
-    if ( !line_ps.points.empty() ) {
-      auto it = line_ps.points.cbegin();
-      uint64_t d = (line_ps.points.size() + max_poly - 1) / max_poly;
-      uint64_t n = 0;
-      for ( uint64_t i = 1; i <= d; ++i ) {
-        uint64_t m = line_ps.points.size() * i / d;
-        Poly* poly = new Poly();
-        line_g->Add( poly );
-        while ( n < m ) {
-          poly->Add( *(it++) );
-          ++n;
-        }
-      }
-    }
+    BuildPoly( line_g, line_ps.points, false );
     PrunePointsEnd( mark_ps );
-    for ( auto& p : mark_ps.points ) {
-      if ( marker_show_out ) BuildMarker( mark_g, marker_out, p );
-      if ( marker_show_int ) BuildMarker( hole_g, marker_int, p );
-    }
+    BuildMarkers( mark_g, hole_g, mark_ps.points );
     adding_segments = false;
     main->tag_db->EndLineTag();
   };
@@ -1880,29 +2324,39 @@ void Series::BuildLine(
   Point cur;
   Point old;
 
-  DatumBegin();
-  for ( size_t i = 0; i < datum_num; ++i, DatumNext() ) {
+  // Once a datum beyond the X-axis range has been drawn, the remaining datums
+  // are also beyond it if ordered by X-value.
+  bool ordered = DatumRangeIndexed();
+  size_t end = datum_num;
+
+  for ( size_t i = DatumBeginRange(); i < end; ++i, DatumNext() ) {
     std::string_view svx;
     std::string_view svy;
-    source->GetDatum( svx, svy, datum_no_x, datum_y_idx );
-    double x = datum_cat_ofs + i - (staircase ? 0.5 : 0.0);
-    double y = DatumToDouble( svy );
-    if ( !is_cat ) x = DatumToDouble( svx );
+    double x = datum_cat_ofs + i - (Staircase ? 0.5 : 0.0);
+    double y;
+    GetDatum( svx, svy, x, y );
+
+    if (
+      ordered && map_x.Valid( x ) && !axis_y->Skip( y ) &&
+      BeyondRangeX( x, true )
+    ) {
+      end = i + 1;
+    }
 
-    for ( int sc = (staircase ? -1 : 0); sc <= (staircase ? 1 : 0); sc++ ) {
+    for ( int sc = (Staircase ? -1 : 0); sc <= (Staircase ? 1 : 0); sc++ ) {
       at_staircase_corner = sc != 0;
       old = cur;
-      if ( axis_x->angle == 0 ) {
-        cur.x = axis_x->Coor( x );
-        cur.y = axis_y->Coor( y );
+      if ( !Swap ) {
+        cur.x = map_x.Coor( x );
+        cur.y = map_y.Coor( y );
       } else {
-        cur.y = axis_x->Coor( x );
-        cur.x = axis_y->Coor( y );
+        cur.y = map_x.Coor( x );
+        cur.x = map_y.Coor( y );
       }
-      bool valid = axis_x->Valid( x ) && axis_y->Valid( y );
+      bool valid = map_x.Valid( x ) && map_y.Valid( y );
       bool inside = Inside( cur );
       if ( !valid ) {
-        if ( axis_x->Skip( x ) || (axis_x->Valid( x ) && axis_y->Skip( y )) ) {
+        if ( axis_x->Skip( x ) || (map_x.Valid( x ) && axis_y->Skip( y )) ) {
           cur = old;
         } else {
           end_point();
@@ -1956,6 +2410,95 @@ void Series::BuildLine(
 
 //------------------------------------------------------------------------------
 
+void Series::DensityColor( SVG::Color* color, uint32_t level )
+{
+  color->Set( LineColor() );
+  color->RemoveGradient( 0 )->SetTransparency( 0.0 );
+  color->Lighten( 0.85 * (density_levels - 1 - level) / (density_levels - 1) );
+}
+
+// Bin the points into a 2D histogram with one bin per point (pixel) of the
+// chart area and emit each row as run-length encoded rectangles. The output
+// size thus depends on the chart area and not on the number of data points.
+// Counts are mapped logarithmically onto the color levels.
+void Series::BuildDensity(
+  Group* fill_g
+)
+{
+  U x0 = chart_area.min.x;
+  U y0 = chart_area.min.y;
+  size_t nx = static_cast< size_t >(
+    std::max( 1.0, std::ceil( chart_area.max.x - chart_area.min.x ) )
+  );
+  size_t ny = static_cast< size_t >(
+    std::max( 1.0, std::ceil( chart_area.max.y - chart_area.min.y ) )
+  );
+  std::vector< uint32_t > bins( nx * ny, 0 );
+  uint32_t max_cnt = 0;
+
+  DatumBegin();
+  for ( size_t i = 0; i < datum_num; ++i, DatumNext() ) {
+    std::string_view svx;
+    std::string_view svy;
+    double x = datum_cat_ofs + i;
+    double y;
+    GetDatum( svx, svy, x, y );
+    if ( !axis_x->Valid( x ) || !axis_y->Valid( y ) ) continue;
+    Point p;
+    if ( axis_x->angle == 0 ) {
+      p.x = axis_x->Coor( x );
+      p.y = axis_y->Coor( y );
+    } else {
+      p.y = axis_x->Coor( x );
+      p.x = axis_y->Coor( y );
+    }
+    if ( !Inside( p ) ) continue;
+    UpdateLegendBoxes( p, p, true, false );
+    size_t ix = std::min( nx - 1, static_cast< size_t >( p.x - x0 ) );
+    size_t iy = std::min( ny - 1, static_cast< size_t >( p.y - y0 ) );
+    uint32_t& cnt = bins[ iy * nx + ix ];
+    if ( cnt < std::numeric_limits< uint32_t >::max() ) cnt++;
+    max_cnt = std::max( max_cnt, cnt );
+  }
+  if ( max_cnt == 0 ) return;
+
+  density_max_cnt = max_cnt;
+  density_min_cnt = max_cnt;
+  for ( uint32_t cnt : bins ) {
+    if ( cnt > 0 ) density_min_cnt = std::min( density_min_cnt, cnt );
+  }
+
+  std::vector< SVG::Color > ramp( density_levels );
+  for ( uint32_t l = 0; l < density_levels; ++l ) {
+    DensityColor( &ramp[ l ], l );
+  }
+
+  double scale = (density_levels - 1) / std::log1p( double( max_cnt ) );
+  auto level = [&]( uint32_t cnt ) -> int32_t
+  {
+    if ( cnt == 0 ) return -1;
+    return static_cast< int32_t >( std::log1p( double( cnt ) ) * scale + 0.5 );
+  };
+
+  for ( size_t iy = 0; iy < ny; ++iy ) {
+    const uint32_t* row = bins.data() + iy * nx;
+    size_t ix = 0;
+    while ( ix < nx ) {
+      int32_t l = level( row[ ix ] );
+      size_t beg = ix;
+      while ( ix < nx && level( row[ ix ] ) == l ) ++ix;
+      if ( l < 0 ) continue;
+      Point c1{ x0 + U( beg ), y0 + U( iy     ) };
+      Point c2{ x0 + U( ix  ), y0 + U( iy + 1 ) };
+      fill_g->Add( new Rect( c1, c2 ) );
+      fill_g->Last()->Attr()->LineColor()->Clear();
+      fill_g->Last()->Attr()->FillColor()->Set( &ramp[ l ] );
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+
 void Series::Build(
   SVG::Group* main_g,
   SVG::Group* line_g,
@@ -1969,6 +2512,8 @@ void Series::Build(
   std::vector< SVG::Point >* base_pts
 )
 {
+  Profile::Scope prof( "Series::Build", main->id, id, name );
+
   // Used for extra margin in comparisons to account for precision issues. This
   // may cause an unintended extra clip-detection near the corners, but the
   // points will in that case be very near each other and will thus be detected
@@ -2024,6 +2569,10 @@ void Series::Build(
   tag_g = tag_g->AddNewGroup();
   ApplyTagStyle( tag_g );
 
+  if ( html_db && !density ) {
+    html.preserve_set.Reserve( std::min( datum_num, max_reserve ) );
+  }
+
   if (
     type == SeriesType::Area ||
     type == SeriesType::StackedArea
@@ -2047,6 +2596,9 @@ void Series::Build(
     );
   }
 
+  if ( density ) {
+    BuildDensity( fill_g );
+  } else
   if (
     type == SeriesType::XY ||
     type == SeriesType::Scatter ||
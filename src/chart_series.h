@@ -13,18 +13,20 @@
 
 #pragma once
 
+#include <memory>
+
 #include <chart_common.h>
 #include <chart_source.h>
 #include <chart_legend_box.h>
 #include <chart_tag.h>
-
-#include <unordered_set>
+#include <chart_hash.h>
 
 namespace Chart {
 
 class Main;
 class Axis;
 class HTML;
+class RasterDirect;
 
 class Series
 {
@@ -41,6 +43,13 @@ public:
     this->staircase = staircase && type == SeriesType::Line;
   }
 
+  // Render a Scatter series as a density heatmap instead of individual
+  // markers; points are binned at device resolution in a single pass.
+  void SetDensity( bool density = true )
+  {
+    this->density = density && type == SeriesType::Scatter;
+  }
+
   // Defines if HTML should snap to the series; default is enabled.
   void SetSnap( bool snap_enable = true )
   {
@@ -105,8 +114,24 @@ public:
     if ( prune_dist > 0.0 ) {
       prune_dist_inv = 1.0 / prune_dist;
     }
+    SetMarkerThin( marker_thin );
+  }
+
+  // Keep at most one marker in each square of the given size; only effective
+  // if larger than the prune distance. Default is 0, i.e. no thinning.
+  void SetMarkerThin( SVG::U dist )
+  {
+    marker_thin = dist;
+    SVG::U grid = (prune_dist >= prune_dist_min) ? prune_dist : SVG::U( 0 );
+    if ( marker_thin > grid ) grid = marker_thin;
+    iso_dist_inv = (grid > 0.0) ? (1.0 / grid) : 0.0;
   }
 
+  // Enable M4 decimation, which reduces each pixel column of a poly line or
+  // area outline to its first, minimum, maximum, and last point before the
+  // normal pruning is applied. Intended for series with monotone X-values.
+  void SetPruneM4( bool m4 = true ) { prune_m4 = m4; }
+
   cat_idx_t idx_of_fst_valid = 0;
   cat_idx_t idx_of_lst_valid = 0;
   bool idx_of_valid_defined = false;
@@ -122,7 +147,39 @@ public:
     size_t num, cat_idx_t cat_ofs, bool no_x, uint32_t y_idx
   );
 
+  // Feed the series with n in-memory datums instead of anchoring it in the
+  // source; the values are copied and no text is parsed. For XY and Scatter
+  // series x holds the X-values; for the category based series x is ignored
+  // (and may be nullptr) and the datums go to consecutive categories starting
+  // at cat_ofs. Missing and invalid values are given as num_skip and
+  // num_invalid, corresponding to "-" and "!" in the text format.
+  void SetData(
+    const double* x, const double* y, size_t n, cat_idx_t cat_ofs = 0
+  );
+
+  // Sparse index of the datums recorded when they are first scanned, which
+  // allows BuildLine() to start near the first datum within the X-axis range
+  // and stop after the last one, instead of visiting all datums. Entry k is
+  // for datum k * stride and holds its position in the source (unless the
+  // datums are fed) and the largest valid X-value of the datums before it; the
+  // X-values are only of use if they never decrease.
+  struct datum_index_t {
+    static constexpr size_t stride = 4096;
+    std::vector< Source::position_t > pos;
+    std::vector< double > x;
+    bool x_sorted = true;
+    size_t num = 0;
+    double x_max = -num_hi;
+    void Add( double x, const Source::position_t* pos = nullptr );
+  };
+  void SetDatumIndex( std::shared_ptr< const datum_index_t > index )
+  {
+    datum_index = index;
+  }
+  std::shared_ptr< const datum_index_t > datum_index;
+
   bool datum_defined = false;
+  bool datum_fed = false;
   Source::position_t datum_pos;
   size_t datum_num = 0;
   cat_idx_t datum_cat_ofs = 0;
@@ -138,9 +195,13 @@ public:
   min_max_t recorded_min_max_x;
   min_max_t recorded_min_max_y;
 
-  // Used to iterate through the datums directly in the source.
+  // Used to iterate through the datums directly in the source, or through the
+  // fed datums.
   void DatumBegin()
   {
+    if ( datum_fed ) {
+      fed_idx = 0;
+    } else
     if ( datum_defined ) {
       source->cur_pos = datum_pos;
       source->LoadLine();
@@ -148,10 +209,49 @@ public:
   }
   void DatumNext()
   {
+    if ( datum_fed ) {
+      fed_idx++;
+      return;
+    }
     source->NextLine();
     source->SkipWS( true );
   }
 
+  // Get the current datum. The X-value is only fetched for XY and Scatter
+  // series; for category series x is num_skip. The text of the datum, as used
+  // for tags and HTML snap points, is returned in svx/svy; for fed datums it is
+  // only generated if needed.
+  void GetDatum(
+    std::string_view& svx, std::string_view& svy, double& x, double& y
+  )
+  {
+    if ( datum_fed ) {
+      y = fed_y[ fed_idx ];
+      x = is_cat ? num_skip : fed_x[ fed_idx ];
+      if ( tag_enable || html_db != nullptr ) FedText( svx, svy );
+      return;
+    }
+    source->GetDatum( svx, svy, datum_no_x, datum_y_idx );
+    y = DatumToDouble( svy );
+    x = is_cat ? num_skip : DatumToDouble( svx );
+  }
+
+  // Used by BuildLine() to visit only the datums within the X-axis range.
+  // The coordinate of x lies beyond the chart area before or after the range.
+  bool BeyondRangeX( double x, bool after );
+  bool DatumRangeIndexed( void );
+  void DatumSeek( size_t k );
+  size_t DatumBeginRange( void );
+
+  std::vector< double > fed_x;
+  std::vector< double > fed_y;
+  size_t fed_idx = 0;
+  char fed_buf_x[ num_buf_size ];
+  char fed_buf_y[ num_buf_size ];
+  // Format the current fed datum; X is only formatted for non-category series,
+  // whose fed datums have X-values.
+  void FedText( std::string_view& svx, std::string_view& svy );
+
   Source* source = nullptr;
   Main* main = nullptr;
 
@@ -191,14 +291,28 @@ public:
     SVG::U d2 = 0.0;
 
     // Used when pruning isolated points.
-    std::unordered_map< uint64_t, SVG::Point > iso_exists;
+    FlatMap< uint64_t, SVG::Point > iso_exists;
     std::vector< SVG::Point > iso_points;
 
+    // M4 decimation state; m4_col is the pixel column currently being
+    // collected and m4_min_idx/m4_max_idx are the positions of m4_min/m4_max
+    // within the column.
+    size_t m4_cnt = 0;
+    int64_t m4_col = 0;
+    size_t m4_min_idx = 0;
+    size_t m4_max_idx = 0;
+    SVG::Point m4_fst{ 0.0, 0.0 };
+    SVG::Point m4_min{ 0.0, 0.0 };
+    SVG::Point m4_max{ 0.0, 0.0 };
+    SVG::Point m4_lst{ 0.0, 0.0 };
+
     bool html_enable = false;
   };
 
   void PrunePolyAdd( prune_state_t& ps, SVG::Point p );
+  void PrunePolyPut( prune_state_t& ps, SVG::Point p );
   void PrunePolyEnd( prune_state_t& ps );
+  void PruneM4Flush( prune_state_t& ps );
 
   uint64_t PrunePointsKey( SVG::Point p );
   void PrunePointsAdd( prune_state_t& ps, SVG::Point p );
@@ -263,6 +377,47 @@ public:
     SVG::Group* hole_g,
     SVG::Group* tag_g
   );
+
+  // Bodies of the above specialized on the axis swap and scales, and for
+  // BuildLine() on the staircase, so that these are not tested per datum.
+  template< bool Swap, bool LogY >
+  void BuildAreaT(
+    SVG::Group* fill_g,
+    SVG::Group* line_g,
+    SVG::Group* mark_g,
+    SVG::Group* hole_g,
+    SVG::Group* tag_g,
+    std::vector< double >* base_ofs,
+    std::vector< SVG::Point >* base_pts
+  );
+  template< bool Swap, bool LogY >
+  void BuildBarT(
+    SVG::Group* fill_g,
+    SVG::Group* tbar_g,
+    SVG::Group* line_g,
+    SVG::Group* mark_g,
+    SVG::Group* hole_g,
+    SVG::Group* tag_g,
+    uint32_t bar_num,
+    uint32_t bar_tot,
+    std::vector< double >* ofs_pos,
+    std::vector< double >* ofs_neg
+  );
+  template< bool Swap, bool Staircase, bool LogX, bool LogY >
+  void BuildLineT(
+    SVG::Group* line_g,
+    SVG::Group* mark_g,
+    SVG::Group* hole_g,
+    SVG::Group* tag_g
+  );
+
+  void BuildDensity(
+    SVG::Group* fill_g
+  );
+
+  // Color of the given density level, where 0 is the sparsest and
+  // density_levels-1 the densest.
+  void DensityColor( SVG::Color* color, uint32_t level );
   void Build(
     SVG::Group* main_g,
     SVG::Group* line_g,
@@ -293,6 +448,7 @@ public:
   std::string name;
   bool staircase = false;
   bool snap_enable = true;
+  bool density = false;
   double base;
 
   std::vector< LegendBox >* lb_list;
@@ -309,6 +465,10 @@ public:
 
   HTML* html_db;
 
+  // If set, the geometry of the lines, areas, and markers is handed directly
+  // to the raster backend, and the groups only get placeholders.
+  RasterDirect* raster_db = nullptr;
+
   struct html_t {
     bool has_snap = false;
 
@@ -321,7 +481,7 @@ public:
     std::vector< snap_point_t > uncommitted_snap_points;
     std::vector< snap_point_t > snap_points;
 
-    std::unordered_set< SVG::Point, PointHash > preserve_set;
+    FlatSet< SVG::Point, PointHash > preserve_set;
 
     uint32_t line_color_same_cnt = 0;
     uint32_t fill_color_same_cnt = 0;
@@ -353,11 +513,32 @@ public:
   SVG::U prune_dist = 0.0;
   SVG::U prune_dist_inv = 0.0;
   SVG::U prune_dist_min = 0.001;
+  bool prune_m4 = false;
+
+  // Grid of the isolated point pruning of markers; 0 if disabled.
+  SVG::U marker_thin = 0.0;
+  SVG::U iso_dist_inv = 0.0;
 
   // Some tools have problems with very large poly lines, so break them up
   // based on this limit when possible.
   static constexpr uint64_t max_poly = 4096;
 
+  // Upper limit on the number of entries the pruning and snapping hash tables
+  // are sized for up front based on datum_num; they still grow beyond this.
+  static constexpr size_t max_reserve = size_t( 1 ) << 20;
+
+  // Number of color levels used for density heatmaps.
+  static constexpr uint32_t density_levels = 16;
+
+  // Size of the bin count labels of the density legend relative to the legend
+  // text.
+  static constexpr double density_label_size = 0.7;
+
+  // Smallest and largest non-zero bin count of the density heatmap, shown at
+  // the ends of the color scale in the legend; set by BuildDensity().
+  uint32_t density_min_cnt = 0;
+  uint32_t density_max_cnt = 0;
+
   SVG::U      marker_size;
   MarkerShape marker_shape;
 
@@ -396,6 +577,23 @@ public:
   // Build marker based on marker_* variables.
   void BuildMarker( SVG::Group* g, const MarkerDims& m, SVG::Point p );
 
+  // Build the markers (and their holes) at the given points.
+  void BuildMarkers(
+    SVG::Group* mark_g, SVG::Group* hole_g,
+    const std::vector< SVG::Point >& points
+  );
+
+  // Build a poly line through the points, split into parts of at most
+  // max_poly points, or a closed polygon.
+  void BuildPoly(
+    SVG::Group* g, const std::vector< SVG::Point >& points, bool closed
+  );
+
+  // Placeholder for entry idx of raster_db covering the bounding box bb.
+  void AddRasterPlaceholder(
+    SVG::Group* g, uint32_t idx, const SVG::BoundaryBox& bb
+  );
+
   // Determine min/max data values.
   void DetermineMinMax(
     std::vector< double >& ofs_pos,
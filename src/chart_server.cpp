@@ -0,0 +1,230 @@
+//
+//  MIT No Attribution License
+//
+//  Copyright 2025, Soren Kragh
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the
+//  “Software”), to deal in the Software without restriction, including
+//  without limitation the rights to use, copy, modify, merge, publish,
+//  distribute, sublicense, and/or sell copies of the Software, and to
+//  permit persons to whom the Software is furnished to do so.
+//
+
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chart_server.h>
+
+using namespace Chart;
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+bool WriteAll( int fd, const char* data, size_t n )
+{
+  while ( n > 0 ) {
+    ssize_t w = write( fd, data, n );
+    if ( w < 0 ) {
+      if ( errno == EINTR ) continue;
+      return false;
+    }
+    data += w;
+    n -= w;
+  }
+  return true;
+}
+
+bool Reply( int fd, bool ok, const std::string& out )
+{
+  std::string status =
+    (ok ? "OK " : "ERROR ") + std::to_string( out.size() ) + "\n";
+  return
+    WriteAll( fd, status.data(), status.size() ) &&
+    WriteAll( fd, out.data(), out.size() );
+}
+
+// Serve the request on connection fd; req is scratch space kept by the worker
+// between requests.
+void Serve(
+  int fd, uint64_t max_request, const Server::Handler& handler,
+  std::string& req
+)
+{
+  // The whole request must arrive before the deadline; writing the reply
+  // times out on its own.
+  timeval tv{};
+  tv.tv_sec = Server::timeout;
+  setsockopt( fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof( tv ) );
+  auto deadline =
+    std::chrono::steady_clock::now() + std::chrono::seconds( Server::timeout );
+
+  req.clear();
+  char buf[ 64 * 1024 ];
+  while ( true ) {
+    auto left =
+      std::chrono::duration_cast< std::chrono::milliseconds >(
+        deadline - std::chrono::steady_clock::now()
+      ).count();
+    pollfd pfd{ fd, POLLIN, 0 };
+    int p = (left > 0) ? poll( &pfd, 1, left ) : 0;
+    if ( p < 0 && errno == EINTR ) continue;
+    if ( p == 0 ) {
+      Reply(
+        fd, false,
+        "*** ERROR: request not received within " +
+        std::to_string( Server::timeout ) + " seconds\n"
+      );
+      close( fd );
+      return;
+    }
+    if ( p < 0 ) break;
+    ssize_t r = read( fd, buf, sizeof( buf ) );
+    if ( r < 0 && errno == EINTR ) continue;
+    if ( r <= 0 ) break;
+    if ( req.size() + r > max_request ) {
+      Reply(
+        fd, false,
+        "*** ERROR: request exceeds " + std::to_string( max_request ) +
+        " bytes\n"
+      );
+      close( fd );
+      return;
+    }
+    req.append( buf, r );
+  }
+
+  // Arguments up to the first empty line; the rest is the input.
+  std::vector< std::string > args;
+  size_t pos = 0;
+  while ( pos < req.size() ) {
+    size_t eol = req.find( '\n', pos );
+    if ( eol == std::string::npos ) eol = req.size();
+    size_t end = eol;
+    if ( end > pos && req[ end - 1 ] == '\r' ) end--;
+    std::string arg = req.substr( pos, end - pos );
+    pos = eol + 1;
+    if ( arg.empty() ) break;
+    args.push_back( std::move( arg ) );
+  }
+  std::istringstream input(
+    pos < req.size() ? req.substr( pos ) : std::string()
+  );
+
+  std::string out;
+  bool ok = handler( args, input, out );
+  Reply( fd, ok, out );
+  close( fd );
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Server::Run(
+  const std::string& path, uint32_t max_jobs, uint64_t max_request,
+  const Handler& handler, std::string& err
+)
+{
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if ( path.empty() || path.size() >= sizeof( addr.sun_path ) ) {
+    err = "invalid socket path '" + path + "'";
+    return;
+  }
+  std::memcpy( addr.sun_path, path.c_str(), path.size() + 1 );
+
+  int sock = socket( AF_UNIX, SOCK_STREAM, 0 );
+  if ( sock < 0 ) {
+    err = std::string( "socket: " ) + std::strerror( errno );
+    return;
+  }
+
+  // Replace a stale socket from an earlier run, but nothing else.
+  struct stat st;
+  if ( lstat( path.c_str(), &st ) == 0 && S_ISSOCK( st.st_mode ) ) {
+    unlink( path.c_str() );
+  }
+  // Only the owner may connect, as requests can read any file the daemon can.
+  mode_t old_mask = umask( 0177 );
+  int bound =
+    bind( sock, reinterpret_cast< sockaddr* >( &addr ), sizeof( addr ) );
+  umask( old_mask );
+  if ( bound < 0 || listen( sock, SOMAXCONN ) < 0 ) {
+    err = "cannot listen on '" + path + "': " + std::strerror( errno );
+    close( sock );
+    return;
+  }
+
+  // A client going away must not terminate the server.
+  signal( SIGPIPE, SIG_IGN );
+
+  if ( max_jobs < 1 ) max_jobs = 1;
+
+  // Accepted connections waiting for a worker; at most max_jobs are queued, so
+  // that further clients wait in the listen backlog.
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::deque< int > queue;
+  bool stop = false;
+
+  auto worker = [&]()
+  {
+    std::string req;
+    while ( true ) {
+      int fd;
+      {
+        std::unique_lock< std::mutex > lk( mutex );
+        cond.wait( lk, [&]{ return stop || !queue.empty(); } );
+        if ( queue.empty() ) break;
+        fd = queue.front();
+        queue.pop_front();
+      }
+      cond.notify_all();
+      Serve( fd, max_request, handler, req );
+    }
+  };
+  std::vector< std::thread > workers;
+  for ( uint32_t n = 0; n < max_jobs; ++n ) {
+    workers.emplace_back( worker );
+  }
+
+  while ( true ) {
+    int fd = accept( sock, nullptr, nullptr );
+    if ( fd < 0 ) {
+      if ( errno == EINTR || errno == ECONNABORTED ) continue;
+      err = std::string( "accept: " ) + std::strerror( errno );
+      break;
+    }
+    {
+      std::unique_lock< std::mutex > lk( mutex );
+      cond.wait( lk, [&]{ return queue.size() < max_jobs; } );
+      queue.push_back( fd );
+    }
+    cond.notify_all();
+  }
+
+  // Let the queued requests finish before the locals they refer to go away.
+  {
+    std::lock_guard< std::mutex > lk( mutex );
+    stop = true;
+  }
+  cond.notify_all();
+  for ( auto& t : workers ) t.join();
+  close( sock );
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,63 @@
+//
+//  MIT No Attribution License
+//
+//  Copyright 2025, Soren Kragh
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the
+//  “Software”), to deal in the Software without restriction, including
+//  without limitation the rights to use, copy, modify, merge, publish,
+//  distribute, sublicense, and/or sell copies of the Software, and to
+//  permit persons to whom the Software is furnished to do so.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace Chart {
+
+// Render daemon listening on a Unix domain socket. Each connection carries a
+// single request consisting of the command line arguments, one per line,
+// terminated by an empty line and followed by the data read for the file name
+// "-"; the request ends when the client shuts down its sending side. The reply
+// is a status line "OK <n>" or "ERROR <n>" followed by n bytes of output or
+// error message, after which the connection is closed.
+//
+// The requests are served by a fixed pool of worker threads, which keep their
+// state between requests. The handler reads the files named in a request with
+// the permissions of the daemon, so the socket is created accessible to the
+// owner only (mode 0600). A request not received in full within timeout
+// seconds is rejected, and a reply not taken by the client within as long is
+// abandoned, so that a stalled client does not hold on to a worker.
+class Server
+{
+public:
+
+  static constexpr int timeout = 30;
+
+  // Renders a request; returns true with the output in out, or false with the
+  // error message in out. Called by the worker threads, each making one call
+  // at a time.
+  using Handler =
+    std::function<
+      bool(
+        const std::vector< std::string >& args, std::istream& input,
+        std::string& out
+      )
+    >;
+
+  // Serve requests with max_jobs worker threads. A request larger than
+  // max_request bytes is rejected. Only returns if the socket could not be set
+  // up, in which case err holds the reason.
+  static void Run(
+    const std::string& path, uint32_t max_jobs, uint64_t max_request,
+    const Handler& handler, std::string& err
+  );
+};
+
+}
@@ -0,0 +1,250 @@
+//
+//  MIT No Attribution License
+//
+//  Copyright 2025, Soren Kragh
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the
+//  “Software”), to deal in the Software without restriction, including
+//  without limitation the rights to use, copy, modify, merge, publish,
+//  distribute, sublicense, and/or sell copies of the Software, and to
+//  permit persons to whom the Software is furnished to do so.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <unistd.h>
+
+#include <chart_sidecar.h>
+#include <chart_hash.h>
+
+using namespace Chart;
+
+namespace fs = std::filesystem;
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+constexpr std::string_view magic = "chartus sidecar\n";
+constexpr uint64_t version = 2;
+
+// Bytes fingerprinted at each of the sample offsets.
+constexpr uint64_t sample_size = 64 * 1024;
+constexpr int samples = 5;
+
+std::string SidecarName( const std::string& file_name )
+{
+  return file_name + ".chartus";
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool Sidecar::GetKey(
+  const std::string& file_name, uint64_t buffer_size, key_t& key
+)
+{
+  std::error_code ec;
+  key.path = fs::absolute( file_name, ec ).lexically_normal().string();
+  if ( ec ) return false;
+  key.size = fs::file_size( file_name, ec );
+  if ( ec ) return false;
+  key.mtime = fs::last_write_time( file_name, ec ).time_since_epoch().count();
+  if ( ec ) return false;
+  key.buffer_size = buffer_size;
+
+  // The samples are spread evenly from the start to the end of the file.
+  std::ifstream file( file_name, std::ios::binary );
+  if ( !file ) return false;
+  ContentHash hash;
+  std::string buf;
+  uint64_t next = 0;
+  for ( int i = 0; i < samples; i++ ) {
+    uint64_t ofs = 0;
+    if ( key.size > sample_size ) {
+      ofs = (key.size - sample_size) / (samples - 1) * i;
+      if ( i == samples - 1 ) ofs = key.size - sample_size;
+    }
+    ofs = std::max( ofs, next );
+    uint64_t n = std::min( sample_size, key.size - std::min( ofs, key.size ) );
+    if ( n == 0 ) break;
+    buf.resize( n );
+    file.seekg( ofs, std::ios::beg );
+    file.read( buf.data(), n );
+    if ( uint64_t( file.gcount() ) != n ) return false;
+    hash.Add( buf );
+    next = ofs + n;
+  }
+  key.sample = hash.Hex();
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool Sidecar::Load( const std::string& file_name, const key_t& key )
+{
+  std::ifstream f( SidecarName( file_name ), std::ios::binary );
+  if ( !f ) return false;
+  std::string in(
+    (std::istreambuf_iterator< char >( f )), std::istreambuf_iterator< char >()
+  );
+  if ( f.bad() || in.size() < magic.size() + 4 ) return false;
+  if ( in.compare( 0, magic.size(), magic ) != 0 ) return false;
+
+  // The contents are followed by their CRC-32.
+  uint32_t crc;
+  std::memcpy( &crc, in.data() + in.size() - 4, 4 );
+  in.resize( in.size() - 4 );
+  if ( CRC32( in.data(), in.size() ) != crc ) return false;
+
+  Reader r( std::string_view( in ).substr( magic.size() ) );
+  if ( r.U64() != version ) return false;
+  key_t k;
+  k.path = r.Str();
+  k.size = r.U64();
+  k.mtime = r.U64();
+  k.buffer_size = r.U64();
+  k.sample = r.Str();
+  if ( !r.ok || !(k == key) ) return false;
+
+  // Counts are bounded by the size, so that they are safe to allocate.
+  auto count = [&]()
+  {
+    uint64_t n = r.U64();
+    if ( n > in.size() ) {
+      r.ok = false;
+      n = 0;
+    }
+    return n;
+  };
+
+  this->key = key;
+  hash = r.Str();
+  segments.resize( count() );
+  for ( auto& segment : segments ) {
+    if ( !r.ok ) return false;
+    segment.byte_ofs = r.U64();
+    segment.byte_cnt = r.U64();
+    segment.line_ofs = r.U64();
+  }
+  macro_lines.resize( count() );
+  for ( auto& loc : macro_lines ) {
+    if ( !r.ok ) return false;
+    loc.seg_idx = r.U64();
+    loc.line_idx = r.U64();
+    loc.char_idx = r.U64();
+  }
+  blocks.clear();
+  for ( uint64_t n = count(); n > 0 && r.ok; n-- ) {
+    uint64_t seg_idx = r.U64();
+    uint64_t char_idx = r.U64();
+    blocks[ { seg_idx, char_idx } ] = r.Str();
+  }
+
+  // The segment table must cover exactly the file.
+  uint64_t size = 0;
+  for ( auto& segment : segments ) {
+    if ( segment.byte_ofs != size ) return false;
+    size += segment.byte_cnt;
+  }
+  if ( segments.empty() || (size != key.size && size != key.size + 1) ) {
+    return false;
+  }
+  for ( auto& loc : macro_lines ) {
+    if ( loc.seg_idx >= segments.size() ) return false;
+  }
+
+  return r.ok && r.AtEnd();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Sidecar::Save( const std::string& file_name ) const
+{
+  Writer w;
+  w.out = magic;
+  w.U64( version );
+  w.Str( key.path );
+  w.U64( key.size );
+  w.U64( key.mtime );
+  w.U64( key.buffer_size );
+  w.Str( key.sample );
+  w.Str( hash );
+  w.U64( segments.size() );
+  for ( auto& segment : segments ) {
+    w.U64( segment.byte_ofs );
+    w.U64( segment.byte_cnt );
+    w.U64( segment.line_ofs );
+  }
+  w.U64( macro_lines.size() );
+  for ( auto& loc : macro_lines ) {
+    w.U64( loc.seg_idx );
+    w.U64( loc.line_idx );
+    w.U64( loc.char_idx );
+  }
+  w.U64( blocks.size() );
+  for ( auto& [ beg, blob ] : blocks ) {
+    w.U64( beg.first );
+    w.U64( beg.second );
+    w.Str( blob );
+  }
+  uint32_t crc = CRC32( w.out.data(), w.out.size() );
+  w.out.append( reinterpret_cast< const char* >( &crc ), 4 );
+
+  // Written to a temporary file and renamed into place like the entries of
+  // the output cache, so that concurrent renderings never see a partial
+  // sidecar.
+  static std::atomic< uint64_t > tmp_cnt{ 0 };
+  std::string name = SidecarName( file_name );
+  std::string tmp =
+    name + ".tmp." + std::to_string( getpid() ) + "." +
+    std::to_string( tmp_cnt++ );
+  std::ofstream f( tmp, std::ios::binary );
+  f << w.out;
+  f.close();
+  std::error_code ec;
+  if ( !f ) {
+    fs::remove( tmp, ec );
+    return;
+  }
+  fs::rename( tmp, name, ec );
+  if ( ec ) fs::remove( tmp, ec );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::shared_ptr< const Sidecar > Sidecar::Store::Get( const key_t& key )
+{
+  std::lock_guard< std::mutex > lk( mutex );
+  auto it = map.find( key.path );
+  if ( it == map.end() || !(it->second->key == key) ) return nullptr;
+  return it->second;
+}
+
+void Sidecar::Store::Put( const Sidecar& sidecar )
+{
+  std::lock_guard< std::mutex > lk( mutex );
+  auto& stored = map[ sidecar.key.path ];
+  if ( !stored || !(stored->key == sidecar.key) ) {
+    stored = std::make_shared< const Sidecar >( sidecar );
+    return;
+  }
+  bool added = false;
+  for ( auto& [ beg, blob ] : sidecar.blocks ) {
+    auto it = stored->blocks.find( beg );
+    added = added || it == stored->blocks.end() || it->second != blob;
+  }
+  if ( !added ) return;
+  auto merged = std::make_shared< Sidecar >( *stored );
+  for ( auto& [ beg, blob ] : sidecar.blocks ) {
+    merged->blocks.insert_or_assign( beg, blob );
+  }
+  stored = std::move( merged );
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,170 @@
+//
+//  MIT No Attribution License
+//
+//  Copyright 2025, Soren Kragh
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the
+//  “Software”), to deal in the Software without restriction, including
+//  without limitation the rights to use, copy, modify, merge, publish,
+//  distribute, sublicense, and/or sell copies of the Software, and to
+//  permit persons to whom the Software is furnished to do so.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Chart {
+
+// Persistent record of the first pass over an input file, kept next to the
+// file as FILE.chartus: the segment table, the locations of the macro lines,
+// the content fingerprint, and blobs holding data blocks as parsed by the
+// application. A file with a valid sidecar need not be read before parsing
+// starts. The sidecar is valid only if its key matches the file: the path,
+// size, and modification time, and a fingerprint of samples of the contents
+// (fingerprinting all of the contents would mean reading the whole file).
+class Sidecar
+{
+public:
+
+  struct key_t {
+    std::string path;             // Absolute path of the file.
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    uint64_t buffer_size = 0;     // Segment size of the segment table.
+    std::string sample;           // Fingerprint of samples of the contents.
+
+    bool operator==( const key_t& other ) const {
+      return
+        path == other.path && size == other.size && mtime == other.mtime &&
+        buffer_size == other.buffer_size && sample == other.sample;
+    }
+  };
+
+  // Returns false if the file cannot be examined.
+  static bool GetKey(
+    const std::string& file_name, uint64_t buffer_size, key_t& key
+  );
+
+  struct segment_t {
+    uint64_t byte_ofs = 0;
+    uint64_t byte_cnt = 0;
+    uint64_t line_ofs = 0;
+  };
+
+  struct location_t {
+    uint64_t seg_idx = 0;
+    uint64_t line_idx = 0;
+    uint64_t char_idx = 0;
+  };
+
+  key_t key;
+  std::string hash;               // Fingerprint of all of the contents.
+  std::vector< segment_t > segments;
+  std::vector< location_t > macro_lines;
+
+  // Data blocks keyed by the segment and character index of their start.
+  std::map< std::pair< uint64_t, uint64_t >, std::string > blocks;
+
+  // Returns false unless the sidecar of the file exists, is intact, and
+  // matches key.
+  bool Load( const std::string& file_name, const key_t& key );
+
+  // Write the sidecar of the file; failures are ignored, as the sidecar is
+  // only an optimization.
+  void Save( const std::string& file_name ) const;
+
+  // Sidecars kept in memory and shared by the renderings of one process (see
+  // --batch), so that a file charted by several of them is scanned and its
+  // data blocks parsed only once. Stored sidecars are never modified, so a
+  // sidecar obtained by Get() stays valid while others are added.
+  class Store
+  {
+  public:
+    // Returns nullptr unless a sidecar matching key is stored.
+    std::shared_ptr< const Sidecar > Get( const key_t& key );
+
+    // Add the blocks of sidecar to the stored sidecar of the same file, which
+    // is replaced by sidecar unless the keys match.
+    void Put( const Sidecar& sidecar );
+
+  private:
+    std::mutex mutex;
+    std::unordered_map< std::string, std::shared_ptr< const Sidecar > > map;
+  };
+
+  // Serialization of blobs; values are stored in native byte order.
+  class Writer
+  {
+  public:
+    void U64( uint64_t v ) { Raw( &v, sizeof( v ) ); }
+    void F64( double v ) { Raw( &v, sizeof( v ) ); }
+    void Str( std::string_view s )
+    {
+      U64( s.size() );
+      out.append( s.data(), s.size() );
+    }
+    std::string out;
+  private:
+    void Raw( const void* p, size_t n )
+    {
+      out.append( static_cast< const char* >( p ), n );
+    }
+  };
+
+  // Reading beyond the end yields zeros and clears ok.
+  class Reader
+  {
+  public:
+    explicit Reader( std::string_view in ) : in( in ) {}
+    uint64_t U64( void )
+    {
+      uint64_t v = 0;
+      Raw( &v, sizeof( v ) );
+      return v;
+    }
+    double F64( void )
+    {
+      double v = 0;
+      Raw( &v, sizeof( v ) );
+      return v;
+    }
+    std::string Str( void )
+    {
+      uint64_t n = U64();
+      if ( n > in.size() - pos ) {
+        ok = false;
+        n = 0;
+      }
+      std::string s( in.substr( pos, n ) );
+      pos += n;
+      return s;
+    }
+    bool AtEnd( void ) const { return pos == in.size(); }
+    bool ok = true;
+  private:
+    void Raw( void* p, size_t n )
+    {
+      if ( in.size() - pos < n ) {
+        ok = false;
+        return;
+      }
+      std::memcpy( p, in.data() + pos, n );
+      pos += n;
+    }
+    std::string_view in;
+    size_t pos = 0;
+  };
+};
+
+}
@@ -16,34 +16,144 @@
 #include <string>
 #include <cstring>
 #include <charconv>
+#include <sstream>
 #include <filesystem>
 
 #include <chart_source.h>
+#include <chart_lz.h>
 
 using namespace Chart;
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void Source::Quit( int code )
+namespace {
+
+// Message for a failed read of input; includes the reason if the input is
+// being decompressed.
+std::string ReadError( std::istream& input, const std::string& name )
+{
+  std::string msg = "error while reading '" + name + "'";
+  auto gz = dynamic_cast< Gunzip* >( input.rdbuf() );
+  if ( gz != nullptr && !gz->err.empty() ) msg += ": " + gz->err;
+  return msg;
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Source::~Source()
 {
-  stop_loader = true;
-  loader_cond.notify_one();
+  StopLoader();
+  for ( auto& [ id, buf ] : pool.id2buf ) {
+    free( buf );
+  }
+  for ( char* buf : spare_buffers ) {
+    free( buf );
+  }
+}
+
+char* Source::NewBuffer( void )
+{
+  {
+    std::lock_guard< std::mutex > lk( spare_mutex );
+    if ( !spare_buffers.empty() ) {
+      char* buf = spare_buffers.back();
+      spare_buffers.pop_back();
+      return buf;
+    }
+  }
+  return static_cast< char* >( malloc( buffer_size + 16 ) );
+}
+
+void Source::FreeBuffer( char* buf )
+{
+  if ( buf == nullptr ) return;
+  std::lock_guard< std::mutex > lk( spare_mutex );
+  spare_buffers.push_back( buf );
+}
+
+void Source::Reset( void )
+{
+  StopLoader();
+  stop_loader = false;
+  bool keep = keep_files && files_read && loader_msg.empty() && !hash_content;
+  loader_msg.clear();
+  files_read = false;
+
+  if ( keep ) {
+    kept_list = std::move( file_list );
+  } else {
+    ClearFiles();
+  }
+  file_list.clear();
+
+  active_seg = -1;
+  locked_seg = -1;
+  stats = stats_t{};
+  in_macro_name.clear();
+  ref_idx = 0;
+  cur_pos = {};
+  saved_pos.clear();
+  saved_pos_cnt = 0;
+  content_hash = ContentHash{};
+  line_hash = nullptr;
+}
+
+void Source::ClearFiles( void )
+{
+  for ( auto& [ id, buf ] : pool.id2buf ) {
+    FreeBuffer( buf );
+  }
+  pool = pool_t{};
+
+  segments.clear();
+  packed_bytes = 0;
+  packed_segments = 0;
+  gzip_list.clear();
+  macros.clear();
+  sidecars.clear();
+  kept_list.clear();
+  file_stamps.clear();
+  last_tail.clear();
+}
+
+void Source::StopLoader()
+{
+  {
+    std::lock_guard< std::mutex > lk( loader_mutex );
+    stop_loader = true;
+  }
+  loader_cond.notify_all();
   if ( loader_thread.joinable() ) loader_thread.join();
+}
+
+void Source::Quit( int code )
+{
+  StopLoader();
   exit( code );
 }
 
-void Source::Err( const std::string& msg )
+void Source::Fail( const std::string& txt )
 {
-  std::cerr << "*** ERROR: " << msg << std::endl;
+  if ( throw_errors ) throw Error( txt );
+  std::cerr << txt << std::flush;
   Quit( 1 );
 }
 
+void Source::Err( const std::string& msg )
+{
+  Fail( "*** ERROR: " + msg + "\n" );
+}
+
 void Source::ParseErr( const std::string& msg, bool show_ref )
 {
+  std::ostringstream txt;
+
   auto show_loc = [&]( location_t loc, size_t col, bool stack = false )
   {
     segment_t& segment = segments[ loc.seg_idx ];
-    std::cerr
+    txt
       << segment.name << " ("
       << (segment.line_ofs + loc.line_idx + 1) << ','
       << col << ')'
@@ -51,7 +161,7 @@ void Source::ParseErr( const std::string& msg, bool show_ref )
       << '\n';
   };
 
-  std::cerr << "*** PARSE ERROR: " << msg << "\n";
+  txt << "*** PARSE ERROR: " << msg << "\n";
 
   for ( auto& loc : cur_pos.macro_stack ) {
     show_loc( loc, 0, true );
@@ -60,7 +170,7 @@ void Source::ParseErr( const std::string& msg, bool show_ref )
   size_t idx = show_ref ? ref_idx : cur_pos.loc.char_idx;
 
   if ( AtEOF() ) {
-    std::cerr << "at EOF";
+    txt << "at EOF";
   } else {
     ToSOL();
     const char* p = cur_pos.loc.buf.data() + cur_pos.loc.char_idx;
@@ -68,7 +178,7 @@ void Source::ParseErr( const std::string& msg, bool show_ref )
     show_loc( cur_pos.loc, col );
     idx = cur_pos.loc.char_idx;
     ToEOL();
-    std::cerr << std::string_view( p, cur_pos.loc.char_idx - idx ) << '\n';
+    txt << std::string_view( p, cur_pos.loc.char_idx - idx ) << '\n';
     std::string indent;
     bool show_caret = true;
     for ( size_t i = 0; i < col; ++i ) {
@@ -79,21 +189,20 @@ void Source::ParseErr( const std::string& msg, bool show_ref )
       indent += (p[ i ] == '\t') ? '\t' : ' ';
     }
     if ( show_caret ) {
-      std::cerr << indent << '^';
+      txt << indent << '^';
     }
   }
-  std::cerr << std::endl;
+  txt << '\n';
 
-  Quit( 1 );
+  Fail( txt.str() );
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
 uint32_t Source::SavePos()
 {
-  static uint32_t context = 0;
-  saved_pos[ ++context ] = cur_pos;
-  return context;
+  saved_pos[ ++saved_pos_cnt ] = cur_pos;
+  return saved_pos_cnt;
 }
 
 void Source::RestorePos( uint32_t context )
@@ -137,39 +246,50 @@ void Source::ProcessSegment()
     if ( num == 0 ) break;
     const char* ptr = cur_pos.loc.buf.data() + cur_pos.loc.char_idx;
     if ( num >= 9 && strncmp( ptr, "Macro", 5 ) == 0 ) {
-      bool macro_def = strncmp( ptr + 5, "Def", 3 ) == 0;
-      bool macro_end = strncmp( ptr + 5, "End", 3 ) == 0;
-      auto sol_loc = cur_pos.loc;
-      cur_pos.loc.char_idx += 8;
-      SkipWS();
-      if ( GetChar() == ':' ) {
-        SkipWS();
-        std::string macro_name{ GetIdentifier() };
-        if ( macro_name.empty() ) ParseErr( "macro name expected", true );
-        ExpectEOL();
-        if ( macro_def ) {
-          if ( !in_macro_name.empty() ) ParseErr( "nested MacroDef not allowed" );
-          if ( macros.count( macro_name ) ) {
-            ParseErr( "macro '" + macro_name + "' already defined", true );
-          }
-          macros[ macro_name ] = sol_loc;
-          in_macro_name = macro_name;
-        } else
-        if ( macro_end ) {
-          if ( in_macro_name.empty() ) ParseErr( "not defining macro" );
-          if ( macro_name != in_macro_name ) {
-            ParseErr( "unmatched macro name", true );
-          }
-          in_macro_name.clear();
-        }
-      }
-      cur_pos.loc.char_idx = sol_loc.char_idx;
+      ProcessMacroLine();
     }
     PastEOL();
   }
 }
 
-void Source::ReadStream( std::istream& input, std::string name )
+// Process a line starting with "Macro" and holding at least 9 characters; the
+// current position is left at the start of the line.
+void Source::ProcessMacroLine()
+{
+  const char* ptr = cur_pos.loc.buf.data() + cur_pos.loc.char_idx;
+  bool macro_def = strncmp( ptr + 5, "Def", 3 ) == 0;
+  bool macro_end = strncmp( ptr + 5, "End", 3 ) == 0;
+  auto sol_loc = cur_pos.loc;
+  cur_pos.loc.char_idx += 8;
+  SkipWS();
+  if ( GetChar() == ':' ) {
+    SkipWS();
+    std::string macro_name{ GetIdentifier() };
+    if ( macro_name.empty() ) ParseErr( "macro name expected", true );
+    ExpectEOL();
+    if ( macro_def ) {
+      if ( !in_macro_name.empty() ) ParseErr( "nested MacroDef not allowed" );
+      if ( macros.count( macro_name ) ) {
+        ParseErr( "macro '" + macro_name + "' already defined", true );
+      }
+      sol_loc.buf = std::string_view();
+      macros[ macro_name ] = sol_loc;
+      in_macro_name = macro_name;
+    } else
+    if ( macro_end ) {
+      if ( in_macro_name.empty() ) ParseErr( "not defining macro" );
+      if ( macro_name != in_macro_name ) {
+        ParseErr( "unmatched macro name", true );
+      }
+      in_macro_name.clear();
+    }
+  }
+  cur_pos.loc.char_idx = sol_loc.char_idx;
+}
+
+void Source::ReadStream(
+  std::istream& input, std::string name, size_t byte_ofs, size_t line_ofs
+)
 {
   auto add_segment =
     [&]() {
@@ -186,22 +306,29 @@ void Source::ReadStream( std::istream& input, std::string name )
           pool.dyn_cnt++;
         } else {
           pool_id = pool.LRU_GetID();
-          segments[ pool.id2seg[ pool_id ] ].loaded = false;
-          segments[ pool.id2seg[ pool_id ] ].bufptr = nullptr;
+          // A buffer added for the files not read may hold no segment yet.
+          if ( pool.id2seg[ pool_id ] >= 0 ) {
+            segment_t& old = segments[ pool.id2seg[ pool_id ] ];
+            PackSegment( old, pool.id2buf[ pool_id ] );
+            old.loaded = false;
+            old.bufptr = nullptr;
+            old.pool_id = no_pool;
+            stats.segment_evictions++;
+          }
         }
       }
       segments.back().pool_id = pool_id;
       if ( pool.id2buf.find( pool_id ) == pool.id2buf.end() ) {
-        pool.id2buf[ pool_id ] =
-          static_cast< char* >( malloc( buffer_size + 16 ) );
+        pool.id2buf[ pool_id ] = NewBuffer();
+        stats.peak_buffers =
+          std::max< uint64_t >( stats.peak_buffers, pool.id2buf.size() );
       }
       segments.back().bufptr = pool.id2buf[ pool_id ];
       pool.id2seg[ pool_id ] = segments.size() - 1;
       if ( pool_id >= 0 ) pool.LRU_UseID( pool_id );
     };
 
-  size_t byte_ofs = 0;
-  size_t line_ofs = 0;
+  ContentHash file_hash;
 
   auto do_segment =
     [&]( size_t seg_idx ) {
@@ -214,6 +341,9 @@ void Source::ReadStream( std::istream& input, std::string name )
       segment.loaded = true;
       segment.byte_ofs = byte_ofs;
       segment.line_ofs = line_ofs;
+      if ( hash_content ) {
+        file_hash.Add( segment.bufptr, segment.byte_cnt );
+      }
       ProcessSegment();
       byte_ofs += cur_pos.loc.buf.size();
       line_ofs += cur_pos.loc.line_idx;
@@ -231,6 +361,7 @@ void Source::ReadStream( std::istream& input, std::string name )
     );
     std::streamsize bytes_read = input.gcount();
     segments.back().byte_cnt += bytes_read;
+    stats.first_pass_bytes += bytes_read;
     if ( bytes_read == 0 ) {
       do_segment( segments.size() - 1 );
       break;
@@ -264,31 +395,385 @@ void Source::ReadStream( std::istream& input, std::string name )
   }
 
   if ( input.bad() || (input.fail() && !input.eof()) ) {
-    Err( "error while reading '" + name + "'" );
+    Err( ReadError( input, name ) );
+  }
+
+  // Each file is fingerprinted on its own, so that the fingerprint does not
+  // depend on the files being read serially or concurrently. Including the
+  // size marks the end of the file so that moving lines between files changes
+  // the fingerprint.
+  if ( hash_content ) {
+    content_hash.Add( file_hash.Hex() );
+    content_hash.Add( byte_ofs );
   }
 
   return;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+
+void Source::ScanFile(
+  file_scan_t& scan, std::atomic< size_t >& kept, size_t max_kept
+)
+{
+  std::ifstream file( scan.name, std::ios::binary );
+  if ( !file ) {
+    scan.err = "failed to open file '" + scan.name + "'";
+    return;
+  }
+  std::unique_ptr< Gunzip > gz;
+  if ( Gunzip::IsGzipName( scan.name ) ) {
+    scan.gzip = std::make_unique< Gunzip::index_t >();
+    scan.gzip->spacing = gzip_spacing;
+    gz = std::make_unique< Gunzip >( file, scan.gzip.get() );
+  }
+  std::istream input(
+    gz ? static_cast< std::streambuf* >( gz.get() ) : file.rdbuf()
+  );
+
+  size_t line_ofs = 0;
+
+  // Same as do_segment in ReadStream(), except that the macro lines are only
+  // located; they are processed by MergeScan().
+  auto do_segment =
+    [&]( char* ptr, size_t cnt ) {
+      if ( cnt > 0 && !IsLF( ptr[ cnt - 1 ] ) ) {
+        ptr[ cnt++ ] = '\n';
+      }
+      segment_t segment;
+      segment.name = scan.name;
+      segment.byte_ofs = scan.byte_ofs;
+      segment.byte_cnt = cnt;
+      segment.line_ofs = line_ofs;
+      segment.gzip = scan.gzip.get();
+      if ( hash_content || scan.sidecar ) scan.hash.Add( ptr, cnt );
+      location_t loc;
+      loc.seg_idx = scan.segments.size();
+      while ( loc.char_idx < cnt ) {
+        const char* p = ptr + loc.char_idx;
+        if ( cnt - loc.char_idx >= 9 && strncmp( p, "Macro", 5 ) == 0 ) {
+          scan.macro_lines.push_back( loc );
+        }
+        while ( !IsLF( ptr[ loc.char_idx ] ) ) ++loc.char_idx;
+        if ( ptr[ loc.char_idx++ ] == '\r' ) {
+          if ( loc.char_idx < cnt && ptr[ loc.char_idx ] == '\n' ) {
+            ++loc.char_idx;
+          }
+        }
+        ++loc.line_idx;
+      }
+      scan.byte_ofs += cnt;
+      line_ofs += loc.line_idx;
+      if ( kept++ < max_kept ) {
+        segment.loaded = true;
+        segment.bufptr = ptr;
+      } else {
+        kept--;
+        PackSegment( segment, ptr );
+        FreeBuffer( ptr );
+      }
+      scan.segments.push_back( std::move( segment ) );
+    };
+
+  char* buf = NewBuffer();
+  size_t cnt = 0;
+  while ( true ) {
+    std::streamsize bytes_to_read = buffer_size - cnt;
+    input.read( buf + cnt, bytes_to_read );
+    std::streamsize bytes_read = input.gcount();
+    cnt += bytes_read;
+    scan.bytes += bytes_read;
+    if ( bytes_read == 0 ) {
+      do_segment( buf, cnt );
+      break;
+    }
+    if ( bytes_read < bytes_to_read ) continue;
+
+    size_t to_move = 0;
+    while ( true ) {
+      char c = buf[ cnt - 1 - to_move ];
+      if ( c == '\n' ) break;
+      if ( c == '\r' && to_move > 0 ) break;
+      ++to_move;
+      if ( to_move == cnt ) {
+        FreeBuffer( buf );
+        scan.err = "line too long while reading '" + scan.name + "'";
+        return;
+      }
+    }
+
+    char* next = NewBuffer();
+    memcpy( next, buf + cnt - to_move, to_move );
+    do_segment( buf, cnt - to_move );
+    buf = next;
+    cnt = to_move;
+  }
+
+  if ( input.bad() || (input.fail() && !input.eof()) ) {
+    scan.err = ReadError( input, scan.name );
+  }
+}
+
+void Source::MergeScan( file_scan_t& scan )
+{
+  size_t seg_ofs = segments.size();
+  for ( auto& segment : scan.segments ) {
+    int32_t pool_id = no_pool;
+    if ( segment.loaded ) {
+      pool_id = pool.dyn_cnt++;
+      pool.id2buf[ pool_id ] = segment.bufptr;
+      pool.id2seg[ pool_id ] = segments.size();
+      pool.LRU_UseID( pool_id );
+    } else
+    if ( !scan.cached ) {
+      stats.segment_evictions++;
+    }
+    segment.pool_id = pool_id;
+    segments.push_back( std::move( segment ) );
+  }
+  scan.segments.clear();
+  if ( scan.sidecar && scan.err.empty() ) {
+    if ( scan.cached ) {
+      stats.sidecar_files++;
+    } else {
+      Sidecar& sidecar = *scan.sidecar;
+      for ( size_t i = seg_ofs; i < segments.size(); ++i ) {
+        sidecar.segments.push_back(
+          { segments[ i ].byte_ofs, segments[ i ].byte_cnt,
+            segments[ i ].line_ofs
+          }
+        );
+      }
+      for ( auto& loc : scan.macro_lines ) {
+        sidecar.macro_lines.push_back(
+          { loc.seg_idx, loc.line_idx, loc.char_idx }
+        );
+      }
+      sidecar.hash = scan.hash.Hex();
+    }
+    file_sidecar_t entry;
+    entry.name = scan.name;
+    entry.seg_beg = seg_ofs;
+    entry.seg_end = segments.size();
+    entry.dirty = !scan.cached;
+    entry.sidecar = std::move( scan.sidecar );
+    entry.shared = std::move( scan.shared );
+    sidecars.push_back( std::move( entry ) );
+  }
+  if ( scan.gzip ) gzip_list.push_back( std::move( scan.gzip ) );
+  stats.peak_buffers =
+    std::max< uint64_t >( stats.peak_buffers, pool.id2buf.size() );
+  stats.first_pass_bytes += scan.bytes;
+
+  // A macro line in a segment that was not kept is processed in a temporary
+  // copy of the segment.
+  std::string tmp;
+  size_t tmp_seg = 0;
+  for ( auto loc : scan.macro_lines ) {
+    loc.seg_idx += seg_ofs;
+    segment_t& segment = segments[ loc.seg_idx ];
+    if ( segment.loaded ) {
+      loc.buf = std::string_view( segment.bufptr, segment.byte_cnt );
+    } else {
+      if ( tmp.empty() || tmp_seg != loc.seg_idx ) {
+        std::string msg;
+        tmp.resize( segment.byte_cnt );
+        if ( !ReadSegment( segment, tmp.data(), msg ) ) Err( msg );
+        tmp_seg = loc.seg_idx;
+      }
+      loc.buf = tmp;
+    }
+    cur_pos.loc = loc;
+    ProcessMacroLine();
+  }
+
+  if ( hash_content ) {
+    content_hash.Add(
+      scan.cached ? sidecars.back().sidecar->hash : scan.hash.Hex()
+    );
+    content_hash.Add( scan.byte_ofs );
+  }
+
+  cur_pos.loc = location_t{};
+  cur_pos.loc.seg_idx = segments.size();
+
+  if ( !scan.err.empty() ) Err( scan.err );
+}
+
 void Source::ReadFiles()
 {
   if ( file_list.empty() ) AddFile( "-" );
 
+  // The files are stamped before they are read, so that a change made while
+  // they are read is seen the next time.
+  std::vector< file_stamp_t > stamps( file_list.size() );
+  if ( keep_files ) {
+    for ( size_t i = 0; i < file_list.size(); ++i ) {
+      GetStamp( file_list[ i ], stamps[ i ] );
+    }
+  }
+  bool kept = false;
+  if ( !kept_list.empty() ) {
+    kept = kept_list == file_list && ReadAppended( stamps );
+    kept_list.clear();
+    if ( !kept ) ClearFiles();
+  }
+
+  // With several files, the files (except standard input) are read and
+  // scanned concurrently and then merged in command line order. The segments
+  // kept in memory are limited as if the files were read one by one.
+  size_t files = 0;
   for ( const auto& file_name : file_list ) {
-    if ( file_name == "-" ) {
-      ReadStream( std::cin, file_name );
-    } else {
-      std::ifstream file( file_name, std::ios::binary );
-      if ( !file ) {
-        Err( "failed to open file '" + file_name + "'" );
+    if ( file_name != "-" ) files++;
+  }
+  uint32_t workers =
+    std::min< size_t >(
+      std::max( 1u, std::thread::hardware_concurrency() ), files
+    );
+
+  // Sidecars are made from the scans of the files, so the files are then
+  // scanned even if they are not read concurrently.
+  bool any_sidecar = use_sidecar || sidecar_store != nullptr;
+  if ( kept ) {
+    // Only the lines appended to the last file have been read.
+  } else
+  if ( workers < 2 && !any_sidecar ) {
+    for ( const auto& file_name : file_list ) {
+      if ( file_name == "-" ) {
+        ReadStream( *stdin_stream, file_name );
+      } else {
+        std::ifstream file( file_name, std::ios::binary );
+        if ( !file ) {
+          Err( "failed to open file '" + file_name + "'" );
+        }
+        if ( Gunzip::IsGzipName( file_name ) ) {
+          gzip_list.push_back( std::make_unique< Gunzip::index_t >() );
+          gzip_list.back()->spacing = gzip_spacing;
+          Gunzip gz( file, gzip_list.back().get() );
+          std::istream input( &gz );
+          size_t seg_ofs = segments.size();
+          ReadStream( input, file_name );
+          for ( size_t i = seg_ofs; i < segments.size(); ++i ) {
+            segments[ i ].gzip = gzip_list.back().get();
+          }
+        } else {
+          ReadStream( file, file_name );
+        }
+      }
+    }
+  } else {
+    // The buffers of scans not yet merged are freed if an error is thrown.
+    struct scans_t {
+      Source* source;
+      std::vector< file_scan_t > list;
+      ~scans_t() {
+        for ( auto& scan : list ) {
+          for ( auto& segment : scan.segments ) {
+            source->FreeBuffer( segment.bufptr );
+          }
+        }
+      }
+    } scans{ this, {} };
+    scans.list.resize( file_list.size() );
+    size_t cached_segments = 0;
+    for ( size_t i = 0; i < file_list.size(); ++i ) {
+      file_scan_t& scan = scans.list[ i ];
+      scan.name = file_list[ i ];
+      if (
+        !any_sidecar || scan.name == "-" || Gunzip::IsGzipName( scan.name )
+      ) {
+        continue;
+      }
+      Sidecar::key_t key;
+      if ( !Sidecar::GetKey( scan.name, buffer_size, key ) ) continue;
+      scan.sidecar = std::make_unique< Sidecar >();
+      if ( sidecar_store ) scan.shared = sidecar_store->Get( key );
+      if ( scan.shared ) {
+        // The blocks are looked up in the shared sidecar, so only blocks
+        // added by this source are kept in its own.
+        scan.sidecar->key = key;
+        scan.sidecar->hash = scan.shared->hash;
+        scan.sidecar->segments = scan.shared->segments;
+        scan.sidecar->macro_lines = scan.shared->macro_lines;
+        scan.cached = true;
+      } else {
+        scan.cached = use_sidecar && scan.sidecar->Load( scan.name, key );
+      }
+      if ( !scan.cached ) {
+        scan.sidecar = std::make_unique< Sidecar >();
+        scan.sidecar->key = key;
+        continue;
+      }
+      for ( auto& s : scan.sidecar->segments ) {
+        segment_t segment;
+        segment.name = scan.name;
+        segment.byte_ofs = s.byte_ofs;
+        segment.byte_cnt = s.byte_cnt;
+        segment.line_ofs = s.line_ofs;
+        scan.segments.push_back( std::move( segment ) );
+        scan.byte_ofs = s.byte_ofs + s.byte_cnt;
+      }
+      for ( auto& l : scan.sidecar->macro_lines ) {
+        location_t loc;
+        loc.seg_idx = l.seg_idx;
+        loc.line_idx = l.line_idx;
+        loc.char_idx = l.char_idx;
+        scan.macro_lines.push_back( loc );
+      }
+      cached_segments += scan.segments.size();
+    }
+
+    std::atomic< size_t > next_file{ 0 };
+    std::atomic< size_t > kept{ 0 };
+    size_t max_kept = max_buffers + file_list.size();
+    auto worker = [&]()
+    {
+      while ( true ) {
+        size_t i = next_file++;
+        if ( i >= file_list.size() ) break;
+        if ( file_list[ i ] == "-" || scans.list[ i ].cached ) continue;
+        ScanFile( scans.list[ i ], kept, max_kept );
+      }
+    };
+    std::vector< std::thread > threads;
+    for ( uint32_t n = 0; n < workers; ++n ) {
+      threads.emplace_back( worker );
+    }
+    for ( auto& t : threads ) t.join();
+
+    cur_pos.loc = location_t{};
+    for ( size_t i = 0; i < file_list.size(); ++i ) {
+      if ( file_list[ i ] == "-" ) {
+        ReadStream( *stdin_stream, file_list[ i ] );
+      } else {
+        MergeScan( scans.list[ i ] );
       }
-      ReadStream( file, file_name );
     }
+
+    // The segments of the files not read are loaded by the loader thread,
+    // which needs buffers for them; the buffers added hold no segment.
+    size_t want = std::min( pool.dyn_cnt + cached_segments, max_kept );
+    while ( pool.dyn_cnt < want ) {
+      int32_t pool_id = pool.dyn_cnt++;
+      pool.id2buf[ pool_id ] = NewBuffer();
+      pool.id2seg[ pool_id ] = -1;
+      pool.lru_lst.push_back( pool_id );
+      pool.lru_map[ pool_id ] = std::prev( pool.lru_lst.end() );
+    }
+    stats.peak_buffers =
+      std::max< uint64_t >( stats.peak_buffers, pool.id2buf.size() );
   }
+
   if ( !in_macro_name.empty() ) {
     ParseErr( "macro '" + in_macro_name + "' not ended" );
   }
 
+  if ( keep_files ) {
+    file_stamps = std::move( stamps );
+    KeepTail();
+    files_read = true;
+  }
+
   {
     std::lock_guard< std::mutex > lk( loader_mutex );
   }
@@ -300,6 +785,269 @@ void Source::ReadFiles()
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void Source::GetStamp( const std::string& file_name, file_stamp_t& stamp )
+{
+  stamp = file_stamp_t{};
+  if ( file_name == "-" ) return;
+  std::error_code ec;
+  stamp.size = std::filesystem::file_size( file_name, ec );
+  if ( ec ) return;
+  stamp.mtime =
+    std::filesystem::last_write_time( file_name, ec )
+    .time_since_epoch().count();
+  if ( ec ) return;
+  stamp.ok = true;
+}
+
+void Source::KeepTail( void )
+{
+  last_tail.clear();
+  const std::string& name = file_list.back();
+  if ( segments.empty() || name == "-" || Gunzip::IsGzipName( name ) ) return;
+
+  const segment_t& segment = segments.back();
+  const char* buf = segment.bufptr;
+  std::string tmp;
+  if ( !segment.loaded ) {
+    std::string msg;
+    tmp.resize( segment.byte_cnt );
+    if ( !ReadSegment( segment, tmp.data(), msg ) ) return;
+    buf = tmp.data();
+  }
+  // A carriage return at the end could be the first half of a line break.
+  if ( segment.byte_cnt == 0 || buf[ segment.byte_cnt - 1 ] != '\n' ) return;
+
+  size_t lines = 0;
+  for ( size_t i = 0; i < segment.byte_cnt; ++i ) {
+    if ( buf[ i ] == '\n' ) {
+      lines++;
+    } else
+    if ( buf[ i ] == '\r' && buf[ i + 1 ] != '\n' ) {
+      lines++;
+    }
+  }
+  size_t n = std::min( tail_size, segment.byte_cnt );
+  last_tail.assign( buf + segment.byte_cnt - n, n );
+  last_size = segment.byte_ofs + segment.byte_cnt;
+  last_lines = segment.line_ofs + lines;
+}
+
+bool Source::ReadAppended( const std::vector< file_stamp_t >& stamps )
+{
+  if ( stamps.size() != file_stamps.size() ) return false;
+  for ( size_t i = 0; i < stamps.size(); ++i ) {
+    if ( !stamps[ i ].ok ) return false;
+    if ( i + 1 < stamps.size() && !(stamps[ i ] == file_stamps[ i ]) ) {
+      return false;
+    }
+  }
+  if ( stamps.back() == file_stamps.back() ) return true;
+
+  // The last file is taken to have only grown if its last bytes read are
+  // still in place.
+  const std::string& name = file_list.back();
+  if ( last_tail.empty() || stamps.back().size < last_size ) return false;
+  std::ifstream file( name, std::ios::binary );
+  if ( !file ) return false;
+  std::string tail( last_tail.size(), '\0' );
+  file.seekg( last_size - tail.size(), std::ios::beg );
+  file.read( tail.data(), tail.size() );
+  if ( !file || tail != last_tail ) return false;
+  if ( stamps.back().size == last_size ) return true;
+
+  size_t seg_ofs = segments.size();
+  cur_pos = {};
+  cur_pos.loc.seg_idx = seg_ofs;
+  ReadStream( file, name, last_size, last_lines );
+  cur_pos = {};
+
+  // The sidecar of the file now covers the new segments too; being out of step
+  // with the file, it is no longer stored.
+  file_sidecar_t* entry = FindSidecar( seg_ofs - 1 );
+  if ( entry != nullptr && entry->seg_end == seg_ofs ) {
+    entry->seg_end = segments.size();
+    entry->appended = true;
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Source::file_sidecar_t* Source::FindSidecar( size_t seg_idx )
+{
+  for ( auto& entry : sidecars ) {
+    if ( seg_idx >= entry.seg_beg && seg_idx < entry.seg_end ) return &entry;
+  }
+  return nullptr;
+}
+
+bool Source::SidecarRange( size_t seg_idx, size_t& seg_beg, size_t& seg_end )
+{
+  file_sidecar_t* entry = FindSidecar( seg_idx );
+  if ( entry == nullptr ) return false;
+  seg_beg = entry->seg_beg;
+  seg_end = entry->seg_end;
+  return true;
+}
+
+const std::string* Source::CachedBlock( const location_t& beg )
+{
+  file_sidecar_t* entry = FindSidecar( beg.seg_idx );
+  if ( entry == nullptr ) return nullptr;
+  std::pair< uint64_t, uint64_t > key{
+    beg.seg_idx - entry->seg_beg, beg.char_idx
+  };
+  auto it = entry->sidecar->blocks.find( key );
+  if ( it != entry->sidecar->blocks.end() ) return &it->second;
+  if ( entry->shared ) {
+    auto shared_it = entry->shared->blocks.find( key );
+    if ( shared_it != entry->shared->blocks.end() ) return &shared_it->second;
+  }
+  return nullptr;
+}
+
+void Source::CacheBlock( const location_t& beg, std::string blob )
+{
+  file_sidecar_t* entry = FindSidecar( beg.seg_idx );
+  if ( entry == nullptr ) return;
+  std::pair< uint64_t, uint64_t > key{
+    beg.seg_idx - entry->seg_beg, beg.char_idx
+  };
+  if ( entry->shared ) {
+    auto it = entry->shared->blocks.find( key );
+    if ( it != entry->shared->blocks.end() && it->second == blob ) return;
+  }
+  auto& cached = entry->sidecar->blocks[ key ];
+  if ( cached != blob ) {
+    cached = std::move( blob );
+    entry->dirty = true;
+  }
+}
+
+void Source::WriteSidecars()
+{
+  for ( auto& entry : sidecars ) {
+    if ( entry.appended ) continue;
+    // A sidecar loaded from its file is new to the store.
+    if ( sidecar_store && (entry.dirty || !entry.shared) ) {
+      sidecar_store->Put( *entry.sidecar );
+    }
+    if ( use_sidecar && entry.dirty ) {
+      if ( entry.shared ) {
+        entry.sidecar->blocks.insert(
+          entry.shared->blocks.begin(), entry.shared->blocks.end()
+        );
+      }
+      entry.sidecar->Save( entry.name );
+    }
+    entry.dirty = false;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Source::PrintStats( std::ostream& os )
+{
+  std::lock_guard< std::mutex > lk( loader_mutex );
+  size_t gzip_checkpoints = 0;
+  for ( const auto& index : gzip_list ) gzip_checkpoints += index->list.size();
+  os
+    << "{\"files\":" << file_list.size()
+    << ",\"segments\":" << segments.size()
+    << ",\"buffer_size\":" << buffer_size
+    << ",\"max_buffers\":" << max_buffers
+    << ",\"peak_buffers\":" << stats.peak_buffers
+    << ",\"first_pass_bytes\":" << stats.first_pass_bytes
+    << ",\"reload_bytes\":" << stats.reload_bytes
+    << ",\"segment_loads\":" << stats.segment_loads
+    << ",\"packed_loads\":" << stats.packed_loads
+    << ",\"packed_segments\":" << packed_segments
+    << ",\"packed_bytes\":" << packed_bytes
+    << ",\"segment_evictions\":" << stats.segment_evictions
+    << ",\"load_calls\":" << stats.load_calls
+    << ",\"load_waits\":" << stats.load_waits
+    << ",\"load_wait_ms\":" << stats.load_wait_us / 1000.0
+    << ",\"macro_jumps\":" << stats.macro_jumps
+    << ",\"gzip_files\":" << gzip_list.size()
+    << ",\"gzip_checkpoints\":" << gzip_checkpoints
+    << ",\"sidecar_files\":" << stats.sidecar_files
+    << "}";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// May be called concurrently by the ScanFile() workers, each for segments of
+// its own.
+void Source::PackSegment( segment_t& segment, const char* buf )
+{
+  if ( segment.pack_tried ) return;
+  segment.pack_tried = true;
+  if ( packed_bytes >= max_packed_bytes ) return;
+  std::string packed = LZ::Compress( buf, segment.byte_cnt );
+  // Not worth it unless it saves at least 10%.
+  if ( packed.size() > segment.byte_cnt / 10 * 9 ) return;
+  uint64_t n = packed.size();
+  if ( packed_bytes.fetch_add( n ) + n > max_packed_bytes ) {
+    packed_bytes -= n;
+    return;
+  }
+  packed.shrink_to_fit();
+  segment.packed = std::move( packed );
+  packed_segments++;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool Source::ReadSegment(
+  const segment_t& segment, char* buf, std::string& err
+)
+{
+  if ( !segment.packed.empty() ) {
+    if ( LZ::Decompress( segment.packed, buf, segment.byte_cnt ) ) return true;
+    err = "corrupt compressed segment of '" + segment.name + "'";
+    return false;
+  }
+
+  std::ifstream file( segment.name, std::ios::binary );
+  if ( !file ) {
+    err = "failed to open file '" + segment.name + "'";
+    return false;
+  }
+  size_t bytes_read;
+  if ( segment.gzip != nullptr ) {
+    // Decompress from the nearest checkpoint.
+    std::string msg;
+    bytes_read =
+      Gunzip::Read(
+        file, *segment.gzip, segment.byte_ofs, buf, segment.byte_cnt, msg
+      );
+    if ( !msg.empty() ) {
+      err = "error while reading '" + segment.name + "': " + msg;
+      return false;
+    }
+  } else {
+    file.seekg( segment.byte_ofs, std::ios::beg );
+    if ( !file ) {
+      err = "seek failed in '" + segment.name + "'";
+      return false;
+    }
+    file.read( buf, segment.byte_cnt );
+    bytes_read = file.gcount();
+    if ( file.bad() ) bytes_read = 0;
+  }
+  // The last segment of a file may end with an added newline.
+  if ( bytes_read + 1 == segment.byte_cnt ) {
+    buf[ bytes_read++ ] = '\n';
+  }
+  if ( bytes_read != segment.byte_cnt ) {
+    err = "error while reading '" + segment.name + "'";
+    return false;
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 void Source::LoaderThread()
 {
   int32_t my_active_seg = -1;
@@ -314,37 +1062,34 @@ void Source::LoaderThread()
   auto load_segment = [&]( int32_t seg_idx )
     {
       int32_t pool_id = pool.LRU_GetID();
+      int32_t old_seg = pool.id2seg[ pool_id ];
+      bool was_loaded = false;
       {
         std::lock_guard< std::mutex > lk( loader_mutex );
         my_active_seg = active_seg;
         if ( seg_idx == locked_seg ) return false;
-        if ( pool.id2seg[ pool_id ] == locked_seg ) {
-          return false;
+        // A buffer added for the files not read holds no segment yet.
+        if ( old_seg >= 0 ) {
+          if ( old_seg == locked_seg ) {
+            return false;
+          }
+          was_loaded = segments[ old_seg ].loaded;
+          segments[ old_seg ].loaded = false;
+          segments[ old_seg ].bufptr = nullptr;
+          segments[ old_seg ].pool_id = no_pool;
+          stats.segment_evictions++;
         }
-        segments[ pool.id2seg[ pool_id ] ].loaded = false;
-        segments[ pool.id2seg[ pool_id ] ].bufptr = nullptr;
+      }
+      if ( was_loaded ) {
+        PackSegment( segments[ old_seg ], pool.id2buf[ pool_id ] );
       }
       pool.id2seg[ pool_id ] = seg_idx;
       pool.LRU_UseID( pool_id );
 
-      std::ifstream file( segments[ seg_idx ].name, std::ios::binary );
-      if ( !file ) {
-        err( "failed to open file '" + segments[ seg_idx ].name + "'" );
-        return false;
-      }
-      file.seekg( segments[ seg_idx ].byte_ofs, std::ios::beg );
-      if ( !file ) {
-        err( "seek failed in '" + segments[ seg_idx ].name + "'" );
-        return false;
-      }
-      std::streamsize bytes_to_read = segments[ seg_idx ].byte_cnt;
-      file.read( pool.id2buf[ pool_id ], bytes_to_read );
-      std::streamsize bytes_read = file.gcount();
-      if (
-        bytes_read != bytes_to_read ||
-        file.bad() || (file.fail() && !file.eof())
-      ) {
-        err( "error while reading '" + segments[ seg_idx ].name + "'" );
+      bool packed = !segments[ seg_idx ].packed.empty();
+      std::string msg;
+      if ( !ReadSegment( segments[ seg_idx ], pool.id2buf[ pool_id ], msg ) ) {
+        err( msg );
         return false;
       }
 
@@ -354,6 +1099,12 @@ void Source::LoaderThread()
         segments[ seg_idx ].loaded = true;
         segments[ seg_idx ].bufptr = pool.id2buf[ pool_id ];
         my_active_seg = active_seg;
+        stats.segment_loads++;
+        if ( packed ) {
+          stats.packed_loads++;
+        } else {
+          stats.reload_bytes += segments[ seg_idx ].byte_cnt;
+        }
       }
       loader_cond.notify_one();
 
@@ -410,9 +1161,20 @@ void Source::LoadCurSegment()
     active_seg = cur_pos.loc.seg_idx;
     locked_seg = -1;
     loader_cond.notify_one();
-    loader_cond.wait(
-      lk, [&]{ return !loader_msg.empty() || segments[ active_seg ].loaded; }
-    );
+    stats.load_calls++;
+    if ( !segments[ active_seg ].loaded ) {
+      // The loader thread is behind; wait for it.
+      auto t0 = std::chrono::steady_clock::now();
+      loader_cond.wait(
+        lk, [&]{ return !loader_msg.empty() || segments[ active_seg ].loaded; }
+      );
+      auto t1 = std::chrono::steady_clock::now();
+      stats.load_waits++;
+      stats.load_wait_us +=
+        std::chrono::duration_cast< std::chrono::microseconds >(
+          t1 - t0
+        ).count();
+    }
     locked_seg = active_seg;
     cur_pos.loc.buf =
       std::string_view(
@@ -436,7 +1198,16 @@ void Source::NextLine( bool stay )
 {
   while ( !AtEOF() ) {
     if ( !stay ) {
-      PastEOL();
+      if ( line_hash ) {
+        size_t sol = cur_pos.loc.char_idx;
+        while ( sol > 0 && !IsLF( cur_pos.loc.buf[ sol - 1 ] ) ) sol--;
+        PastEOL();
+        line_hash->Add(
+          cur_pos.loc.buf.substr( sol, cur_pos.loc.char_idx - sol )
+        );
+      } else {
+        PastEOL();
+      }
     }
     stay = false;
     while ( cur_pos.loc.char_idx == segments[ cur_pos.loc.seg_idx ].byte_cnt ) {
@@ -474,6 +1245,7 @@ void Source::NextLine( bool stay )
           if ( macro_end ) {
             if ( cur_pos.macro_stack.empty() ) ParseErr( "not defining macro" );
             cur_pos.loc = cur_pos.macro_stack.back();
+            stats.macro_jumps++;
             LoadCurSegment();
             cur_pos.macro_stack.pop_back();
           } else
@@ -486,6 +1258,7 @@ void Source::NextLine( bool stay )
             }
             cur_pos.macro_stack.push_back( cur_pos.loc );
             cur_pos.loc = macros[ macro_name ];
+            stats.macro_jumps++;
             LoadCurSegment();
           }
         } else {
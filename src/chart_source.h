@@ -15,31 +15,106 @@
 
 #include <unordered_map>
 #include <list>
+#include <istream>
+#include <stdexcept>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
+#include <memory>
+#include <limits>
 
 #include <chart_common.h>
+#include <chart_hash.h>
+#include <chart_gzip.h>
+#include <chart_sidecar.h>
 
 namespace Chart {
 
+// Thrown by Source::Err() and Source::ParseErr() when error throwing is
+// enabled; what() holds the complete message as it would have been printed.
+class Error : public std::runtime_error
+{
+public:
+  using std::runtime_error::runtime_error;
+};
+
 class Source
 {
 public:
 
   Source() = default;
+  ~Source();
 
-  void Quit( int code );
+  // Forget the files, the input read, and the parse state, so that the Source
+  // can be used for another rendering. The settings given by the Set*()
+  // methods are kept, and so are the buffers of the pool for reuse; the input
+  // read may be kept too (see SetKeepFiles()).
+  void Reset( void );
+
+  [[noreturn]] void Quit( int code );
   void Err( const std::string& msg );
   void ParseErr( const std::string& msg, bool show_ref = false );
 
+  // Normally errors are printed on stderr and the program exits; with error
+  // throwing enabled a Chart::Error is thrown instead, so that a single
+  // rendering can fail without terminating the process.
+  void SetThrowErrors( bool enable = true ) { throw_errors = enable; }
+
+  // Stream read for the file name "-"; default is standard input.
+  void SetStdin( std::istream* input ) { stdin_stream = input; }
+
+  // Enable fingerprinting of the input as it is read by ReadFiles(); the
+  // fingerprint covers the contents and the boundaries of the files.
+  void SetHashContent( bool enable = true ) { hash_content = enable; }
+  const ContentHash& GetContentHash( void ) { return content_hash; }
+
+  // Fingerprint each line into hash as NextLine() moves past it; nullptr
+  // disables. Lines visited more than once are added each time.
+  void SetLineHash( ContentHash* hash ) { line_hash = hash; }
+  ContentHash* GetLineHash( void ) { return line_hash; }
+
+  // Files named *.gz are decompressed as they are read. Decoder checkpoints
+  // are recorded at least this many decompressed bytes apart, so that an
+  // evicted segment can be re-read by decompressing from the nearest
+  // checkpoint; each checkpoint holds 32K of memory.
+  void SetGzipSpacing( uint64_t bytes ) { gzip_spacing = bytes; }
+
+  // Segments evicted from the buffer pool are kept compressed in memory up to
+  // this many bytes in total, so that they can be reloaded without reading
+  // the file again; 0 (the default) disables. Segments are compressed as they
+  // are evicted, which only pays off if reading the file again is slow.
+  void SetPackedMax( uint64_t bytes ) { max_packed_bytes = bytes; }
+
+  // Keep the result of the first pass over each input file in a sidecar file
+  // (see Sidecar), and skip reading the files having a valid sidecar; their
+  // segments are read as needed once parsing starts. Standard input and gzip
+  // compressed files are always read.
+  void SetSidecar( bool enable = true ) { use_sidecar = enable; }
+
+  // Likewise keep the sidecars in store, which may be shared with other
+  // sources; they are written to files only if SetSidecar() is also enabled.
+  void SetSidecarStore( Sidecar::Store* store ) { sidecar_store = store; }
+
+  // Keep the input read when the Source is Reset(), so that ReadFiles() of the
+  // same files (see --watch) need not read them again. If the last file has
+  // grown, and its last bytes read are still in place, only the lines appended
+  // are read, into segments following the others; the locations within the
+  // input read before then stay valid, and so do the data blocks kept in the
+  // sidecars (see CachedBlock()). If any other file has changed, the files are
+  // all read again. Not done for standard input or with fingerprinting.
+  void SetKeepFiles( bool enable = true ) { keep_files = enable; }
+
   uint32_t SavePos();
   void RestorePos( uint32_t context );
 
   void AddFile( std::string_view file_name );
   void ProcessSegment();
-  void ReadStream( std::istream& input, std::string name );
+  void ProcessMacroLine();
+  void ReadStream(
+    std::istream& input, std::string name,
+    size_t byte_ofs = 0, size_t line_ofs = 0
+  );
   void ReadFiles();
   void LoadCurSegment();
   void LoadLine();
@@ -153,6 +228,9 @@ public:
 
   void GetAxis( int& axis_y_n );
 
+  // Print the I/O and buffer pool statistics as a JSON object.
+  void PrintStats( std::ostream& os );
+
 //------------------------------------------------------------------------------
 
   // This is spawned as a new thread and is responsible for pre-loading segments
@@ -161,6 +239,7 @@ public:
 
   // Flag to stop LoaderThread().
   std::atomic<bool> stop_loader{ false };
+  void StopLoader();
 
   // Error message from LoaderThread().
   std::string loader_msg;
@@ -174,18 +253,49 @@ public:
   static constexpr size_t buffer_size = 4 * 1024 * 1024;
   size_t max_buffers = 16;
 
+  // Pool ID of a segment that does not hold a buffer from the pool. Negative
+  // IDs are the fixed buffers of standard input and non-negative IDs the
+  // dynamic buffers, so the sentinel is outside both ranges.
+  static constexpr int32_t no_pool = std::numeric_limits< int32_t >::max();
+
   struct segment_t {
     std::string name;
     size_t byte_ofs = 0;
     size_t byte_cnt = 0;
     size_t line_ofs = 0;
-    int32_t pool_id = 0;
+    int32_t pool_id = no_pool;
     bool loaded = false;
     char* bufptr = nullptr;
+    const Gunzip::index_t* gzip = nullptr;
+    std::string packed;       // Compressed contents, if kept.
+    bool pack_tried = false;
   };
 
   std::vector< segment_t > segments;
 
+  // Buffers of buffer_size (+16) bytes, taken from the buffers kept by Reset()
+  // and by the scans when possible; thread safe.
+  char* NewBuffer( void );
+  void FreeBuffer( char* buf );
+  std::vector< char* > spare_buffers;
+  std::mutex spare_mutex;
+
+  // Re-read the contents of segment into buf; returns false with the error
+  // message in err.
+  bool ReadSegment( const segment_t& segment, char* buf, std::string& err );
+
+  // Keep a compressed copy of the contents buf of segment, which is about to
+  // be evicted, if it compresses well and there is room for it.
+  void PackSegment( segment_t& segment, const char* buf );
+
+  uint64_t max_packed_bytes = 0;
+  std::atomic< uint64_t > packed_bytes{ 0 };
+  std::atomic< uint64_t > packed_segments{ 0 };
+
+  // Checkpoint indexes of the gzip compressed files.
+  std::vector< std::unique_ptr< Gunzip::index_t > > gzip_list;
+  uint64_t gzip_spacing = buffer_size;
+
   int32_t active_seg = -1;
   int32_t locked_seg = -1;
 
@@ -205,6 +315,23 @@ public:
   };
   pool_t pool;
 
+  // I/O and buffer pool statistics. Counters updated by the loader thread are
+  // protected by loader_mutex.
+  struct stats_t {
+    uint64_t first_pass_bytes  = 0;   // Bytes read by ReadFiles().
+    uint64_t reload_bytes      = 0;   // Bytes re-read by the loader thread.
+    uint64_t segment_loads     = 0;   // Segments re-read by the loader thread.
+    uint64_t packed_loads      = 0;   // ... of which from a compressed copy.
+    uint64_t segment_evictions = 0;   // Segments whose buffer was reused.
+    uint64_t load_calls        = 0;   // Calls of LoadCurSegment().
+    uint64_t load_waits        = 0;   // ... that had to wait for the loader.
+    uint64_t load_wait_us      = 0;   // Total time spent waiting.
+    uint64_t peak_buffers      = 0;   // Peak number of pool buffers.
+    uint64_t macro_jumps       = 0;   // Macro calls and returns.
+    uint64_t sidecar_files     = 0;   // Files not read due to a sidecar.
+  };
+  stats_t stats;
+
   struct location_t {
     size_t seg_idx = 0;
     size_t line_idx = 0;
@@ -227,10 +354,110 @@ public:
   std::unordered_map< std::string, location_t > macros;
   std::string in_macro_name;
 
+  // Result of reading a file in a worker thread when several files are read
+  // concurrently. The segments and the lines that may hold macro specifiers
+  // (seg_idx relative to the file) are merged in command line order, where
+  // the macro lines are processed and any error reported exactly as if the
+  // file had been read by ReadStream(). Segments beyond the buffer budget are
+  // not kept (bufptr is nullptr) and will be re-read by the loader thread.
+  struct file_scan_t {
+    std::string name;
+    std::vector< segment_t > segments;
+    std::vector< location_t > macro_lines;
+    std::string err;
+    uint64_t bytes = 0;
+    size_t byte_ofs = 0;
+    ContentHash hash;
+    std::unique_ptr< Gunzip::index_t > gzip;
+    std::unique_ptr< Sidecar > sidecar;
+    std::shared_ptr< const Sidecar > shared;  // From the store, if any.
+    bool cached = false;      // From the sidecar; the file is not read.
+  };
+  void ScanFile(
+    file_scan_t& scan, std::atomic< size_t >& kept, size_t max_kept
+  );
+  void MergeScan( file_scan_t& scan );
+
   size_t ref_idx;
   position_t cur_pos;
 
   std::unordered_map< uint32_t, position_t > saved_pos;
+  uint32_t saved_pos_cnt = 0;
+
+  bool throw_errors = false;
+  std::istream* stdin_stream = &std::cin;
+
+  bool hash_content = false;
+  ContentHash content_hash;
+  ContentHash* line_hash = nullptr;
+
+  // Data blocks parsed by the application can be kept in the sidecar of the
+  // file holding them, keyed by the start location of the block. Returns
+  // false unless seg_idx is in a file with a sidecar, whose segments are then
+  // given by [seg_beg;seg_end[.
+  bool SidecarRange( size_t seg_idx, size_t& seg_beg, size_t& seg_end );
+  // Returns nullptr if no block starting at beg is kept.
+  const std::string* CachedBlock( const location_t& beg );
+  void CacheBlock( const location_t& beg, std::string blob );
+
+  // Write the sidecars that are new or have new blocks, and add them to the
+  // store.
+  void WriteSidecars();
+
+  // Sidecars of the files read (or not read) by ReadFiles(). If the sidecar
+  // came from the store, the blocks of the shared sidecar are used along with
+  // the blocks added to sidecar.
+  struct file_sidecar_t {
+    std::string name;
+    size_t seg_beg = 0;
+    size_t seg_end = 0;
+    std::unique_ptr< Sidecar > sidecar;
+    std::shared_ptr< const Sidecar > shared;
+    bool dirty = false;
+    bool appended = false;    // Grown by ReadAppended(); kept in memory only.
+  };
+  std::vector< file_sidecar_t > sidecars;
+  bool use_sidecar = false;
+  Sidecar::Store* sidecar_store = nullptr;
+
+  // Returns nullptr unless segment seg_idx is in a file with a sidecar.
+  file_sidecar_t* FindSidecar( size_t seg_idx );
+
+  // The input kept by Reset() for ReadFiles() if SetKeepFiles() is enabled:
+  // the files read, their stamps taken before they were read, and the last
+  // bytes read of the last file along with its size and line count as read.
+  struct file_stamp_t {
+    bool ok = false;
+    uint64_t size = 0;
+    int64_t mtime = 0;
+
+    bool operator==( const file_stamp_t& other ) const {
+      return
+        ok && other.ok && size == other.size && mtime == other.mtime;
+    }
+  };
+  static void GetStamp( const std::string& file_name, file_stamp_t& stamp );
+  static constexpr size_t tail_size = 4096;
+  bool keep_files = false;
+  bool files_read = false;
+  std::vector< std::string > kept_list;
+  std::vector< file_stamp_t > file_stamps;
+  std::string last_tail;
+  size_t last_size = 0;
+  size_t last_lines = 0;
+
+  // Forget the input read, but not the files to read.
+  void ClearFiles( void );
+
+  // Record the end of the last file read.
+  void KeepTail( void );
+
+  // Read the lines appended to the last file of the input kept, given the
+  // current stamps of the files; returns false if the input cannot be kept.
+  bool ReadAppended( const std::vector< file_stamp_t >& stamps );
+
+  // Report the fully formatted error message txt.
+  [[noreturn]] void Fail( const std::string& txt );
 };
 
 }
@@ -0,0 +1,48 @@
+//
+//  MIT No Attribution License
+//
+//  Copyright 2025, Soren Kragh
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the
+//  “Software”), to deal in the Software without restriction, including
+//  without limitation the rights to use, copy, modify, merge, publish,
+//  distribute, sublicense, and/or sell copies of the Software, and to
+//  permit persons to whom the Software is furnished to do so.
+//
+
+#pragma once
+
+// Public interface of libchartus (make lib), which holds everything except the
+// command line front end. Charts are built directly through the Ensemble,
+// Main, Axis, and Series classes, and data is fed from memory as arrays of
+// doubles with Series::SetData() and as category names with
+// Main::SetCategories(); no text is generated or parsed. Errors are thrown as
+// Chart::Error instead of terminating the process, provided that the Source
+// given to the Ensemble has SetThrowErrors() enabled:
+//
+//   Chart::Source source;
+//   source.SetThrowErrors();
+//   Chart::Ensemble ensemble( &source );
+//   ensemble.NewChart( 0, 0, 0, 0 );
+//   Chart::Main* chart = ensemble.LastChart();
+//   chart->SetChartArea( 1000, 600 );
+//   chart->AxisX()->SetLabel( "Time" );
+//   Chart::Series* series = chart->AddSeries( Chart::SeriesType::XY );
+//   series->SetName( "Load" );
+//   series->SetData( x.data(), y.data(), x.size() );
+//   ensemble.Build( std::cout );
+//
+// Category based series place the fed datums in categories, which are given
+// first, e.g. chart->SetCategories( names.data(), names.size() ) with the
+// names as std::strings, or chart->SetCategoryAnchor( n, true ) for n unnamed
+// categories.
+//
+// The classes are not thread safe, but separate Ensembles (each with its own
+// Source) can be built concurrently in separate threads.
+
+#include <chart_source.h>
+#include <chart_ensemble.h>
+#include <chart_main.h>
+#include <chart_axis.h>
+#include <chart_series.h>
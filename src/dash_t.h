@@ -102,6 +102,7 @@ Series.Data :
 # Series.New: Name of series
 # Series.Staircase: On
 # Series.Snap: Off
+# Series.Density: On
 # Series.Prune: 0.5
 # Series.GlobalLegend: On
 # Series.LegendOutline: Off
@@ -125,6 +126,8 @@ Series.Data :
 # Series.TagFillColor: lightyellow 0 0.3
 # Series.TagLineColor: black
 # Series.Data:
+# Series.DataFrom: MyData 1 2
+# Dataset: MyData
 # MacroDef: MyMacro
 # MacroEnd: MyMacro
 # Macro: MyMacro
@@ -574,7 +574,8 @@ SubSubTitle:
 #   Scatter     Number      Scatter plot. Same as XY but with no lines and
 #                           always with point markers. Using a highly
 #                           transparent LineColor and/or FillColor can achieve a
-#                           density effect.
+#                           density effect; for large data sets use
+#                           Series.Density instead.
 #   Line        Text        Line plot. Regard X-values as text and draw lines
 #                           between data points, possibly with point markers.
 #                           Recommended for very large data sets (do not enable
@@ -633,6 +634,17 @@ SubSubTitle:
 # series, or until it is redefined.
 #Series.Snap: On
 
+# Render Scatter series as a density heatmap; may be On or Off, default is Off.
+# Instead of drawing a marker for each data point, the points are counted per
+# point (pixel) of the chart area and each point of the chart area is colored
+# according to the logarithm of the count, using the LineColor lightened for
+# sparse areas. The legend shows the color scale. The output size then depends
+# on the chart area rather than the number of data points, which makes this the
+# preferred way to show very large scatter data sets. Tags and HTML snapping
+# are not available for density series. This attribute applies to the current
+# series and all subsequent series, or until it is redefined.
+#Series.Density: Off
+
 # Set the prune distance in points. For very large data sets, graphical details
 # are removed if it is judged that they do not contribute significantly to the
 # final render. While Chartus itself can handle large data sets, the subsequent
@@ -645,6 +657,12 @@ SubSubTitle:
 # pruning algorithm is NOT a smoothing operation. Thin spikes are preserved and
 # the overall shape of the series is generally preserved, while at the same time
 # drastically reducing the number of SVG elements in e.g. noisy sensor data etc.
+# The distance may be preceded by M4, which enables M4 decimation for Line, XY,
+# Area, and StackedArea plots: each pixel column is first reduced to its first,
+# minimum, maximum, and last point, so that the output is bounded by the chart
+# width no matter how many data points there are. This is visually lossless but
+# only effective when the X-values are monotone. A distance given without M4
+# disables M4 decimation; M4 given without a distance keeps the current one.
 #Series.Prune: 0.3
 
 # Set the series legend to be global; may be On or Off, default is Off. Global
@@ -780,6 +798,18 @@ Series.Data:
         80              14              -17
         "Fruit Cake"    -42             88
 
+# A Dataset defines a named block of data in the same format as Series.Data; it
+# does not by itself show up in any chart. The block is parsed only once, and
+# any number of series in any chart can then take their data from it with
+# Series.DataFrom, which works like Series.Data except that the data comes from
+# the named Dataset. By default a series is created for each of the Y-value
+# columns of the Dataset, but specific Y-value columns can be selected by
+# listing their numbers (counting from 1). A Dataset must be defined before it
+# is used.
+#Dataset: MyData
+#<data lines>
+#Series.DataFrom: MyData 1 2
+
 # A macro is defined with MacroDef and must end with MacroEnd; the macro name
 # must match. The macro is called with Macro. A macro can call other macros but
 # cannot itself define a macro.
@@ -14,32 +14,47 @@
 #include <csignal>
 #include <csetjmp>
 #include <cfenv>
+#include <sys/resource.h>
 #include <fstream>
+#include <filesystem>
+#include <sstream>
 #include <unordered_map>
 #include <stack>
 #include <functional>
 #include <random>
+#include <thread>
+#include <new>
+#include <atomic>
+#include <mutex>
 #include <chart_source.h>
 #include <chart_ensemble.h>
+#include <chart_server.h>
+#include <chart_cache.h>
+#include <chart_budget.h>
 
 ////////////////////////////////////////////////////////////////////////////////
 
-Chart::Source source;
-Chart::Ensemble ensemble{ &source };
+// The state of a rendering is thread local, so that concurrent renderings (see
+// --serve) each run in their own thread; a thread rendering more than one chart
+// ensemble resets the state in between (see reset_render_state()).
 
-bool grid_max_defined = false;
-uint32_t grid_max_row = 0;
-uint32_t grid_max_col = 0;
+thread_local Chart::Source source;
+thread_local Chart::Ensemble ensemble{ &source };
+thread_local Chart::Budget budget{ &ensemble };
 
-bool cur_chart_in_chart = false;
-uint32_t embedding_row1 = 0;
-uint32_t embedding_col1 = 0;
-uint32_t embedding_row2 = 0;
-uint32_t embedding_col2 = 0;
-int64_t chart_area_w = 1000;
-int64_t chart_area_h = 600;
+thread_local bool grid_max_defined = false;
+thread_local uint32_t grid_max_row = 0;
+thread_local uint32_t grid_max_col = 0;
 
-Chart::Pos footnote_pos = Chart::Pos::Auto;
+thread_local bool cur_chart_in_chart = false;
+thread_local uint32_t embedding_row1 = 0;
+thread_local uint32_t embedding_col1 = 0;
+thread_local uint32_t embedding_row2 = 0;
+thread_local uint32_t embedding_col2 = 0;
+thread_local int64_t chart_area_w = 1000;
+thread_local int64_t chart_area_h = 600;
+
+thread_local Chart::Pos footnote_pos = Chart::Pos::Auto;
 
 struct state_t {
   std::vector< Chart::Series* > series_list;
@@ -50,7 +65,9 @@ struct state_t {
   Chart::SeriesType series_type = Chart::SeriesType::Line;
   bool staircase = false;
   bool snap = true;
+  bool density = false;
   double prune_dist = 0.3;
+  bool prune_m4 = false;
   Chart::cat_idx_t category_idx = 0;
   bool global_legend = false;
   bool legend_outline = true;
@@ -73,13 +90,16 @@ struct state_t {
   SVG::Color tag_line_color;
 };
 
-state_t state;
+thread_local state_t state;
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Also part of the output cache key.
+const char* chartus_version = "chartus v2.0.1";
+
 void show_version( void )
 {
-  std::cout << R"EOF(chartus v2.0.1
+  std::cout << chartus_version << R"EOF(
 This is free software: you are free to change and redistribute it.
 
 Written by Soren Kragh
@@ -91,11 +111,58 @@ Written by Soren Kragh
 void show_help( void )
 {
   std::cout << R"EOF(Usage: chartus [OPTION]... [FILE]...
-Generate a chart in SVG or HTML format from FILE(s) to standard output.
+Generate a chart in SVG, HTML, or PNG format from FILE(s) to standard output.
 
-With no FILE, or when FILE is -, read standard input.
+With no FILE, or when FILE is -, read standard input. A FILE ending in .gz is
+decompressed as it is read.
 
   -H                Output interactive HTML instead of SVG.
+  -P                Output PNG image instead of SVG.
+  --svg=FILE        Write SVG to FILE instead of standard output.
+  --html=FILE       Write interactive HTML to FILE instead of standard output.
+  --png=FILE        Write PNG image to FILE instead of standard output.
+                    Any combination of --svg, --html, and --png is generated
+                    from a single parse and build of the input.
+  --split=PATTERN   Write each chart to a file of its own, named by replacing
+                    %d in PATTERN with the chart number, and the shared legend
+                    to the file named by replacing %d with "legend"; the
+                    files are PNG if PATTERN ends with .png, otherwise SVG.
+  --profile=FILE    Write phase timings to FILE as Chrome trace-event JSON
+                    and print a summary on standard error.
+  --stats           Print input I/O and buffer pool statistics as JSON on
+                    standard error.
+  --gzip-spacing=MB Decompressed distance between the checkpoints recorded
+                    when reading a FILE ending in .gz; smaller makes
+                    re-reading faster but uses 32K of memory per checkpoint;
+                    default 4.
+  --packed-max=MB   Memory for keeping input that does not fit in the
+                    buffer pool compressed, so that it need not be read
+                    from the file again; default 0 (disabled). Useful for
+                    input on slow or network file systems.
+  --budget-ms=MS    Lower the level of detail of large series as needed for
+                    the rendering to take at most MS milliseconds; the
+                    chosen settings are reported on standard error.
+  --budget-bytes=N  Likewise lower the level of detail for the output to be
+                    at most N bytes.
+  --sidecar         Keep the result of the first pass over each FILE in
+                    FILE.chartus, so that charting FILE again need not read
+                    all of it before building starts.
+  --gen=SPEC        Output a synthetic benchmark input; SPEC is
+                    WORKLOAD[,ROWS[,COLS]] (see bin/bench).
+  --serve=SOCKET    Run as a render daemon accepting requests on the Unix
+                    domain socket SOCKET (see README). Requests read
+                    files with the permissions of the daemon, so SOCKET is
+                    accessible to its owner only.
+  --serve-max=MB    Maximum size of a --serve request; default 256.
+  --batch=FILE      Render the jobs listed in FILE, one per line as an output
+                    file name followed by input files; the format is given
+                    by the output file extension (.svg, .html, or .png).
+  --watch=OUT       Write the output to OUT and keep running; the output is
+                    rendered again whenever an input FILE changes. Lines
+                    appended to the last FILE are read incrementally.
+  --cache=DIR       Reuse output previously generated from identical input
+                    and options; the cache is kept in directory DIR.
+  --cache-max=MB    Maximum size of the cache directory; default 1000.
   -t                Output a simple template file; a good starting point.
   -T                Output a full documentation file.
   -eN               Output example N; good for inspiration.
@@ -415,6 +482,171 @@ void gen_example( int N )
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Generate a synthetic benchmark input. The spec has the form
+// WORKLOAD[,ROWS[,COLS]] where WORKLOAD is a series type, optionally suffixed
+// with +Tag to enable tags, or one of Grid (COLS charts of ROWS points each)
+// and Macro (data lines delivered through nested macro calls). The data is
+// deterministic for a given spec.
+void gen_bench( const std::string& spec )
+{
+  std::string workload = spec;
+  size_t rows = 100000;
+  size_t cols = 4;
+  {
+    std::vector< std::string > fields;
+    size_t p = 0;
+    while ( true ) {
+      size_t q = spec.find( ',', p );
+      fields.push_back( spec.substr( p, q - p ) );
+      if ( q == std::string::npos ) break;
+      p = q + 1;
+    }
+    auto get_num = [&]( size_t idx, size_t& n )
+    {
+      if ( fields.size() <= idx ) return;
+      auto [ptr, ec] =
+        std::from_chars(
+          fields[ idx ].data(), fields[ idx ].data() + fields[ idx ].size(), n
+        );
+      if (
+        ec != std::errc() || ptr != fields[ idx ].data() + fields[ idx ].size()
+        || n == 0
+      ) {
+        source.Err( "invalid benchmark spec '" + spec + "'" );
+      }
+    };
+    workload = fields[ 0 ];
+    get_num( 1, rows );
+    get_num( 2, cols );
+  }
+
+  bool tags = false;
+  if ( workload.size() > 4 && workload.substr( workload.size() - 4 ) == "+Tag" ) {
+    tags = true;
+    workload.resize( workload.size() - 4 );
+  }
+
+  bool grid = workload == "Grid";
+  bool macro = workload == "Macro";
+  std::string type = (grid || macro) ? "XY" : workload;
+  bool is_cat =
+    type == "Line" || type == "Point" || type == "Lollipop" ||
+    type == "Bar" || type == "StackedBar" || type == "LayeredBar" ||
+    type == "Area" || type == "StackedArea";
+  bool is_num = type == "XY" || type == "Scatter";
+  bool positive = type.rfind( "Stacked", 0 ) == 0;
+  if ( !is_cat && !is_num ) {
+    source.Err( "unknown benchmark workload '" + workload + "'" );
+  }
+
+  std::mt19937 gen{ 16 };
+  std::normal_distribution< double > step{ 0.0, 1.0 };
+  std::uniform_real_distribution< double > rnd{ 0.0, 1000.0 };
+
+  std::string out;
+  char buf[ Chart::num_buf_size ];
+  auto flush = [&]( bool force )
+  {
+    if ( force || out.size() >= (1 << 20) ) {
+      std::cout.write( out.data(), out.size() );
+      out.clear();
+    }
+  };
+
+  std::vector< double > level( cols, 0.0 );
+  auto data_row = [&]( size_t i )
+  {
+    out += ' ';
+    if ( is_cat ) {
+      out += 'c';
+      Chart::AppendInt( out, i );
+    } else
+    if ( type == "Scatter" ) {
+      out += Chart::FmtFixed( buf, rnd( gen ), 3 );
+    } else {
+      Chart::AppendInt( out, i );
+    }
+    for ( size_t c = 0; c < cols; ++c ) {
+      level[ c ] += step( gen );
+      double y = positive ? std::abs( level[ c ] ) + 1 : level[ c ];
+      out += ' ';
+      out += Chart::FmtFixed( buf, y, 3 );
+    }
+    out += '\n';
+    flush( false );
+  };
+
+  auto series_setup = [&]( size_t n )
+  {
+    out += "Series.Type: " + type + "\n";
+    if ( tags ) out += "Series.Tag: On\n";
+    for ( size_t c = 0; c < n; ++c ) {
+      out += "Series.New: S";
+      Chart::AppendInt( out, c + 1 );
+      out += '\n';
+    }
+  };
+
+  out += "# Benchmark workload " + spec + "\n";
+  if ( !grid ) out += "ChartArea: 1200 600\n";
+
+  if ( grid ) {
+    size_t n = 1;
+    while ( n * n < cols ) n++;
+    level.assign( 2, 0.0 );
+    size_t charts = cols;
+    cols = 2;
+    for ( size_t ch = 0; ch < charts; ++ch ) {
+      out += "NewChartInGrid: ";
+      Chart::AppendInt( out, ch / n );
+      out += ' ';
+      Chart::AppendInt( out, ch % n );
+      out += "\nChartArea: 400 200\nTitle: Chart ";
+      Chart::AppendInt( out, ch + 1 );
+      out += '\n';
+      series_setup( cols );
+      out += "Series.Data:\n";
+      for ( size_t i = 0; i < rows; ++i ) data_row( i );
+    }
+  } else
+  if ( macro ) {
+    // Blocks of 100 lines are defined as macros and then called repeatedly
+    // from a second level of macros.
+    size_t blocks = 16;
+    for ( size_t b = 0; b < blocks; ++b ) {
+      out += "MacroDef: B";
+      Chart::AppendInt( out, b );
+      out += '\n';
+      for ( size_t i = 0; i < 100; ++i ) data_row( b * 100 + i );
+      out += "MacroEnd: B";
+      Chart::AppendInt( out, b );
+      out += '\n';
+    }
+    out += "MacroDef: All\n";
+    for ( size_t b = 0; b < blocks; ++b ) {
+      out += "Macro: B";
+      Chart::AppendInt( out, b );
+      out += '\n';
+    }
+    out += "MacroEnd: All\n";
+    out += "Title: Macro\n";
+    series_setup( cols );
+    out += "Series.Data:\n";
+    for ( size_t i = 0; i < rows; i += blocks * 100 ) {
+      out += "Macro: All\n";
+    }
+  } else {
+    out += "Title: " + workload + "\n";
+    series_setup( cols );
+    out += "Series.Data:\n";
+    for ( size_t i = 0; i < rows; ++i ) data_row( i );
+  }
+
+  flush( true );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 void do_Pos(
   Chart::Pos& pos, int& axis_y_n
 )
@@ -495,9 +727,9 @@ bool do_GridPos(
 ////////////////////////////////////////////////////////////////////////////////
 
 // Indicates if a chart has been started without a preceding New.
-bool non_newed_chart = false;
+thread_local bool non_newed_chart = false;
 
-uint32_t context_chart;
+thread_local uint32_t context_chart;
 
 Chart::Main* CurChart( void )
 {
@@ -1560,7 +1792,9 @@ void AddSeries( std::string name = "" )
   series->SetName( name );
   series->SetStaircase( state.staircase );
   series->SetSnap( state.snap );
+  series->SetDensity( state.density );
   series->SetPruneDist( state.prune_dist );
+  series->SetPruneM4( state.prune_m4 );
   series->SetGlobalLegend( state.global_legend );
   series->SetLegendOutline( state.legend_outline );
   series->SetAxisY( state.axis_y_n );
@@ -1639,17 +1873,36 @@ void do_Series_Snap( void )
   }
 }
 
+void do_Series_Density( void )
+{
+  source.GetSwitch( state.density );
+  source.ExpectEOL();
+  if ( state.defining_series ) {
+    state.series_list.back()->SetDensity( state.density );
+  }
+}
+
 void do_Series_Prune( void )
 {
   source.SkipWS();
   if ( source.AtEOL() ) source.ParseErr( "prune distance expected" );
-  source.GetDouble( state.prune_dist );
-  if ( state.prune_dist < 0 || state.prune_dist > 100 ) {
-    source.ParseErr( "prune distance out of range [0;100]", true );
+  state.prune_m4 = false;
+  if ( source.AtLetter() ) {
+    std::string_view id = source.GetIdentifier();
+    if ( id == "M4" ) state.prune_m4 = true; else
+    source.ParseErr( "unknown prune mode '" + std::string( id ) + "'", true );
+    source.SkipWS();
+  }
+  if ( !source.AtEOL() ) {
+    source.GetDouble( state.prune_dist );
+    if ( state.prune_dist < 0 || state.prune_dist > 100 ) {
+      source.ParseErr( "prune distance out of range [0;100]", true );
+    }
   }
   source.ExpectEOL();
   if ( state.defining_series ) {
     state.series_list.back()->SetPruneDist( state.prune_dist );
+    state.series_list.back()->SetPruneM4( state.prune_m4 );
   }
 }
 
@@ -1969,20 +2222,222 @@ void do_Series_TagLineColor( void )
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void parse_series_data( bool implicit = false )
-{
-  state.defining_series = false;
-
-  bool column0_is_txt = false;
+// A block of data lines as given by Series.Data or Dataset. Series are
+// anchored in the block itself, so the block need only be scanned once to be
+// referenced by any number of series.
+struct data_block_t {
+  Chart::Source::position_t pos;
   size_t rows = 0;
   uint32_t max_columns = 1;
+  bool column0_is_txt = false;
 
-  std::vector< Chart::min_max_t > column_min_max( 1 );
+  // The category indices recorded are relative to the start of the block.
+  std::vector< Chart::min_max_t > column_min_max;
+  Chart::Main::cat_summary_t cat_summary;
 
-  Chart::Main::parse_cat_t saved_parse_cat;
-  bool spc_defined = false;
+  std::shared_ptr< Chart::Series::datum_index_t > index;
+
+  // Fingerprint of the lines of the block; empty if not computed.
+  std::string hash;
+};
+
+// Named data blocks defined by Dataset.
+thread_local std::unordered_map< std::string, data_block_t > datasets;
+
+// Fingerprints of the specifier lines and of the data blocks of each chart
+// (indexed by Main::id), from which the Main::reuse_key of the charts is made
+// when charts are reused (see --serve and --watch). A data block without a
+// fingerprint makes the chart fingerprint unknown.
+struct chart_data_t {
+  Chart::ContentHash hash;
+  bool known = true;
+};
+thread_local Chart::ContentHash spec_hash;
+thread_local std::vector< chart_data_t > chart_data;
+
+// A data block at the top level of a file with a sidecar (--sidecar) is kept
+// in the sidecar along with the location after the block, and whether that was
+// the end of the input; the segments of the locations are relative to
+// seg_base, the first segment of the file.
+std::string pack_data_block(
+  const data_block_t& data, const Chart::Source::location_t& end,
+  bool at_eof, size_t seg_base
+)
+{
+  Chart::Sidecar::Writer w;
+  auto loc = [&]( const Chart::Source::location_t& l )
+  {
+    w.U64( l.seg_idx - seg_base );
+    w.U64( l.line_idx );
+    w.U64( l.char_idx );
+  };
+  loc( end );
+  w.U64( at_eof );
+  loc( data.pos.loc );
+  w.U64( data.rows );
+  w.U64( data.max_columns );
+  w.U64( data.column0_is_txt );
+  w.U64( data.column_min_max.size() );
+  for ( const auto& mm : data.column_min_max ) {
+    w.U64( mm.def_pos );
+    w.U64( mm.def );
+    w.F64( mm.min_pos );
+    w.F64( mm.min );
+    w.F64( mm.max );
+    w.U64( mm.idx_of_fst_valid );
+    w.U64( mm.idx_of_lst_valid );
+    w.U64( mm.idx_of_valid_defined );
+  }
+  const auto& cs = data.cat_summary;
+  w.U64( cs.rows );
+  w.U64( cs.non_empty_seen );
+  w.U64( cs.fst );
+  w.U64( cs.lst );
+  w.U64( cs.min_stride );
+  w.U64( cs.normal_width );
+  const auto& index = *data.index;
+  w.U64( index.x_sorted );
+  w.U64( index.num );
+  w.F64( index.x_max );
+  w.U64( index.pos.size() );
+  for ( const auto& pos : index.pos ) loc( pos.loc );
+  w.U64( index.x.size() );
+  for ( double x : index.x ) w.F64( x );
+  w.Str( data.hash );
+  return w.out;
+}
+
+// Returns false unless blob holds a data block of the file whose segments are
+// [seg_base;seg_end[.
+bool unpack_data_block(
+  const std::string& blob, size_t seg_base, size_t seg_end,
+  data_block_t& data, Chart::Source::location_t& end, bool& at_eof
+)
+{
+  Chart::Sidecar::Reader r( blob );
+  bool ok = true;
+  auto loc = [&]( Chart::Source::location_t& l, bool at_end = false )
+  {
+    l = {};
+    l.seg_idx = seg_base + r.U64();
+    l.line_idx = r.U64();
+    l.char_idx = r.U64();
+    // Only the end may be at the end of the file, which must then be the end
+    // of the last file.
+    if (
+      l.seg_idx > seg_end ||
+      (l.seg_idx == seg_end && !(at_end && seg_end == source.segments.size()))
+    ) {
+      ok = false;
+    }
+  };
+  // Counts are bounded by the size, so that they are safe to allocate.
+  auto count = [&]()
+  {
+    uint64_t n = r.U64();
+    if ( n > blob.size() ) {
+      ok = false;
+      n = 0;
+    }
+    return n;
+  };
+  loc( end, true );
+  at_eof = r.U64();
+  loc( data.pos.loc );
+  data.rows = r.U64();
+  data.max_columns = r.U64();
+  data.column0_is_txt = r.U64();
+  data.column_min_max.resize( count() );
+  for ( auto& mm : data.column_min_max ) {
+    mm.def_pos = r.U64();
+    mm.def = r.U64();
+    mm.min_pos = r.F64();
+    mm.min = r.F64();
+    mm.max = r.F64();
+    mm.idx_of_fst_valid = r.U64();
+    mm.idx_of_lst_valid = r.U64();
+    mm.idx_of_valid_defined = r.U64();
+  }
+  auto& cs = data.cat_summary;
+  cs.rows = r.U64();
+  cs.non_empty_seen = r.U64();
+  cs.fst = r.U64();
+  cs.lst = r.U64();
+  cs.min_stride = r.U64();
+  cs.normal_width = r.U64();
+  data.index = std::make_shared< Chart::Series::datum_index_t >();
+  auto& index = *data.index;
+  index.x_sorted = r.U64();
+  index.num = r.U64();
+  index.x_max = r.F64();
+  index.pos.resize( count() );
+  for ( auto& pos : index.pos ) loc( pos.loc );
+  index.x.resize( count() );
+  for ( double& x : index.x ) x = r.F64();
+  data.hash = r.Str();
+  return ok && r.ok && r.AtEnd() && !data.column_min_max.empty();
+}
+
+// Scan the data lines at the current position in the source, which is left at
+// the start of the data (or where it is if the block is kept in a sidecar);
+// returns the saved position after the data. A kept block that ran to the end
+// of the input, which has since grown (see Source::SetKeepFiles()), is resumed
+// where it ended.
+uint32_t scan_data_block( data_block_t& data )
+{
+  auto beg_loc = source.cur_pos.loc;
+  size_t seg_beg = 0;
+  size_t seg_end = 0;
+  bool sidecar =
+    !source.AtEOF() && source.cur_pos.macro_stack.empty() &&
+    source.SidecarRange( beg_loc.seg_idx, seg_beg, seg_end );
+  bool resume = false;
+  Chart::Source::position_t end;
+  if ( sidecar ) {
+    const std::string* blob = source.CachedBlock( beg_loc );
+    bool at_eof = false;
+    if (
+      blob != nullptr &&
+      unpack_data_block( *blob, seg_beg, seg_end, data, end.loc, at_eof )
+    ) {
+      resume = at_eof && end.loc.seg_idx < source.segments.size();
+      if ( !resume ) {
+        auto saved_cur_pos = source.cur_pos;
+        source.cur_pos = end;
+        auto data_end_pos = source.SavePos();
+        source.cur_pos = saved_cur_pos;
+        return data_end_pos;
+      }
+    } else {
+      data = data_block_t{};
+    }
+  }
+  auto macro_jumps = source.stats.macro_jumps;
+
+  if ( !resume ) {
+    data.column_min_max.resize( 1 );
+    data.index = std::make_shared< Chart::Series::datum_index_t >();
+  }
+
+  // The lines of the block are fingerprinted apart from the specifier lines
+  // if these are fingerprinted, and always if the block is kept in a sidecar.
+  struct line_hash_t {
+    Chart::ContentHash hash;
+    Chart::ContentHash* saved = source.GetLineHash();
+    bool enabled = false;
+    ~line_hash_t() { source.SetLineHash( saved ); }
+  } line_hash;
+  line_hash.enabled = sidecar || line_hash.saved != nullptr;
+  if ( line_hash.enabled ) {
+    if ( resume ) line_hash.hash.Add( data.hash );
+    source.SetLineHash( &line_hash.hash );
+  }
 
   auto data_beg_pos = source.SavePos();
+  if ( resume ) {
+    source.cur_pos = end;
+    source.LoadLine();
+  }
 
   while ( !source.AtEOF() ) {
     source.SkipWS( true );
@@ -1997,61 +2452,106 @@ void parse_series_data( bool implicit = false )
     std::string_view cat;
     bool quoted;
     source.GetCategory( cat, quoted );
-    if ( !spc_defined ) {
-      saved_parse_cat = CurChart()->parse_cat;
-      spc_defined = true;
-    }
-    CurChart()->ParsedCat( state.category_idx + rows, cat );
+    data.cat_summary.Add( cat );
     size_t idx2 = source.cur_pos.loc.char_idx;
-    if ( !column0_is_txt ) {
+    double x = Chart::num_skip;
+    if ( !data.column0_is_txt ) {
       source.cur_pos.loc.char_idx = idx1;
       double d = 0.0;
-      column0_is_txt = !source.TryGetDoubleOrNone( d );
-      column_min_max[ 0 ].Update( d );
-      source.cur_pos.loc.char_idx = idx2;
+      data.column0_is_txt = !source.TryGetDoubleOrNone( d );
+      data.column_min_max[ 0 ].Update( d );
+      if ( !data.column0_is_txt ) x = d;
     }
+    source.cur_pos.loc.char_idx = idx1;
+    source.ToSOL();
+    data.index->Add( x, &source.cur_pos );
+    source.cur_pos.loc.char_idx = idx2;
     uint32_t columns = 1;
     while ( source.AtWS() ) {
       source.SkipWS();
       if ( source.AtEOL() ) break;
       double d;
       source.GetDoubleOrNone( d );
-      if ( columns >= column_min_max.size() ) {
-        column_min_max.emplace_back();
+      if ( columns >= data.column_min_max.size() ) {
+        data.column_min_max.emplace_back();
       }
-      column_min_max[ columns ].Update( d, state.category_idx + rows );
+      data.column_min_max[ columns ].Update( d, data.rows );
       columns++;
     }
-    max_columns = std::max( max_columns, columns );
+    data.max_columns = std::max( data.max_columns, columns );
     source.ExpectEOL();
-    rows++;
+    data.rows++;
   }
 
+  if ( data.column0_is_txt ) data.index->x_sorted = false;
+
+  auto end_loc = source.cur_pos.loc;
   auto data_end_pos = source.SavePos();
   source.RestorePos( data_beg_pos );
 
-  if ( implicit && rows == 0 ) return;
+  if ( data.rows > 0 ) {
+    source.SkipWS( true );
+    source.ToSOL();
+  }
+  data.pos = source.cur_pos;
+
+  source.SetLineHash( line_hash.saved );
+  if ( line_hash.enabled ) data.hash = line_hash.hash.Hex();
 
-  bool no_x_value = false;
-  if ( state.series_type_defined ) {
-    auto type = state.series_type;
-    if ( !state.series_list.empty() ) {
-      if ( !state.series_list.back()->datum_defined ) {
-        type = state.series_list.back()->type;
-      }
+  // The block is only kept if it lies within the file and does not depend on
+  // macros, which may be defined elsewhere.
+  if (
+    sidecar && data.rows > 0 && source.stats.macro_jumps == macro_jumps &&
+    (
+      end_loc.seg_idx < seg_end ||
+      (end_loc.seg_idx == seg_end && seg_end == source.segments.size())
+    )
+  ) {
+    bool at_eof = end_loc.seg_idx == source.segments.size();
+    source.CacheBlock(
+      beg_loc, pack_data_block( data, end_loc, at_eof, seg_beg )
+    );
+  }
+
+  return data_end_pos;
+}
+
+// Determine if the first column of the data holds Y-values rather than
+// X-values, based on the type of the series to receive the data.
+bool data_no_x_value( const data_block_t& data )
+{
+  if ( !state.series_type_defined ) return !data.column0_is_txt;
+  auto type = state.series_type;
+  if ( !state.series_list.empty() ) {
+    if ( !state.series_list.back()->datum_defined ) {
+      type = state.series_list.back()->type;
     }
-    no_x_value =
-      !column0_is_txt && max_columns == 1 &&
-      type != Chart::SeriesType::XY &&
-      type != Chart::SeriesType::Scatter;
-  } else {
-    no_x_value = !column0_is_txt;
+  }
+  return
+    !data.column0_is_txt && data.max_columns == 1 &&
+    type != Chart::SeriesType::XY &&
+    type != Chart::SeriesType::Scatter;
+}
+
+uint32_t data_y_values( const data_block_t& data )
+{
+  uint32_t y_values = data.max_columns - (data_no_x_value( data ) ? 0 : 1);
+  return (y_values == 0) ? 1 : y_values;
+}
+
+// Anchor series in the data; columns selects the Y-values (numbered from 1)
+// of each series, or all of them if empty.
+void anchor_series_data(
+  const data_block_t& data, const std::vector< uint32_t >& columns
+)
+{
+  bool no_x_value = data_no_x_value( data );
+  if ( !state.series_type_defined ) {
     state.series_type = Chart::SeriesType::Line;
     state.series_type_defined = true;
   }
 
-  uint32_t y_values = max_columns - (no_x_value ? 0 : 1);
-  if ( y_values == 0 ) y_values = 1;
+  uint32_t y_values = columns.empty() ? data_y_values( data ) : columns.size();
 
   // Auto-add new series if needed.
   for ( uint32_t i = 0; i < y_values; i++ ) {
@@ -2081,30 +2581,50 @@ void parse_series_data( bool implicit = false )
     );
   }
 
-  if ( rows > 0 ) {
-    source.SkipWS( true );
-    source.ToSOL();
-  }
+  uint32_t chart_id = CurChart()->id;
+  if ( chart_data.size() <= chart_id ) chart_data.resize( chart_id + 1 );
+  auto& cd = chart_data[ chart_id ];
+  cd.hash.Add( data.hash );
+  cd.known = cd.known && !data.hash.empty();
+
+  auto saved_cur_pos = source.cur_pos;
+  source.cur_pos = data.pos;
   for ( uint32_t i = 0; i < y_values; i++ ) {
     auto series = state.series_list[ state.series_list.size() + i - y_values ];
-    series->SetDatumAnchor( rows, state.category_idx, no_x_value, i );
-    series->RecordMinMax(
-      column_min_max[ 0 ], column_min_max[ (no_x_value ? 0 : 1) + i ]
-    );
+    uint32_t y_idx = columns.empty() ? i : columns[ i ] - 1;
+    series->SetDatumAnchor( data.rows, state.category_idx, no_x_value, y_idx );
+    series->SetDatumIndex( data.index );
+    size_t col = (no_x_value ? 0 : 1) + y_idx;
+    Chart::min_max_t mm_y;
+    if ( col < data.column_min_max.size() ) mm_y = data.column_min_max[ col ];
+    mm_y.idx_of_fst_valid += state.category_idx;
+    mm_y.idx_of_lst_valid += state.category_idx;
+    series->RecordMinMax( data.column_min_max[ 0 ], mm_y );
   }
   if ( x_is_txt ) {
-    CurChart()->SetCategoryAnchor( rows, no_x_value );
-    state.category_idx += rows;
-  }
-
-  if ( x_is_num || no_x_value ) {
-    if ( spc_defined ) {
-      CurChart()->parse_cat = saved_parse_cat;
-    }
-    if ( x_is_txt && rows > 0 ) {
-      CurChart()->ParsedCat( state.category_idx - 1, "" );
+    CurChart()->SetCategoryAnchor( data.rows, no_x_value );
+    if ( no_x_value ) {
+      if ( data.rows > 0 ) {
+        CurChart()->ParsedCat( state.category_idx + data.rows - 1, "" );
+      }
+    } else {
+      CurChart()->ParsedCats( state.category_idx, data.cat_summary );
     }
+    state.category_idx += data.rows;
   }
+  source.cur_pos = saved_cur_pos;
+}
+
+void parse_series_data( bool implicit = false )
+{
+  state.defining_series = false;
+
+  data_block_t data;
+  auto data_end_pos = scan_data_block( data );
+
+  if ( implicit && data.rows == 0 ) return;
+
+  anchor_series_data( data, {} );
 
   source.RestorePos( data_end_pos );
 
@@ -2121,6 +2641,51 @@ void do_Series_Data( void )
   parse_series_data();
 }
 
+void do_Series_DataFrom( void )
+{
+  source.SkipWS();
+  std::string name{ source.GetIdentifier() };
+  if ( name.empty() ) source.ParseErr( "dataset name expected", true );
+  auto it = datasets.find( name );
+  if ( it == datasets.end() ) {
+    source.ParseErr( "unknown dataset '" + name + "'", true );
+  }
+  const data_block_t& data = it->second;
+
+  uint32_t y_values = data_y_values( data );
+  std::vector< uint32_t > columns;
+  while ( true ) {
+    source.SkipWS();
+    if ( source.AtEOL() ) break;
+    int64_t col;
+    if ( !source.GetInt64( col ) ) source.ParseErr( "malformed column" );
+    if ( col < 1 || col > y_values ) {
+      source.ParseErr(
+        "column out of range [1;" + std::to_string( y_values ) + "]", true
+      );
+    }
+    columns.push_back( col );
+  }
+  source.ExpectEOL();
+
+  anchor_series_data( data, columns );
+  state.defining_series = false;
+}
+
+void do_Dataset( void )
+{
+  source.SkipWS();
+  std::string name{ source.GetIdentifier() };
+  if ( name.empty() ) source.ParseErr( "dataset name expected", true );
+  if ( datasets.count( name ) ) {
+    source.ParseErr( "dataset '" + name + "' already defined", true );
+  }
+  source.ExpectEOL();
+  source.NextLine();
+  auto data_end_pos = scan_data_block( datasets[ name ] );
+  source.RestorePos( data_end_pos );
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 using ChartAction = std::function< void() >;
@@ -2184,6 +2749,7 @@ std::unordered_map< std::string_view, ChartAction > chart_actions = {
   { "Series.New"             , do_Series_New              },
   { "Series.Staircase"       , do_Series_Staircase        },
   { "Series.Snap"            , do_Series_Snap             },
+  { "Series.Density"         , do_Series_Density          },
   { "Series.Prune"           , do_Series_Prune            },
   { "Series.GlobalLegend"    , do_Series_GlobalLegend     },
   { "Series.LegendOutline"   , do_Series_LegendOutline    },
@@ -2207,6 +2773,8 @@ std::unordered_map< std::string_view, ChartAction > chart_actions = {
   { "Series.TagFillColor"    , do_Series_TagFillColor     },
   { "Series.TagLineColor"    , do_Series_TagLineColor     },
   { "Series.Data"            , do_Series_Data             },
+  { "Series.DataFrom"        , do_Series_DataFrom         },
+  { "Dataset"                , do_Dataset                 },
 };
 
 using AxisAction = std::function< void( Chart::Axis* ) >;
@@ -2312,6 +2880,559 @@ void parse_lines( void )
   parse_series_data( true );
 
   while ( parse_spec() ) {}
+
+  source.WriteSidecars();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Handle the options selecting the output format; returns false if a is not
+// such an option.
+bool do_format_option( const std::string& a )
+{
+  if ( a == "-H" ) {
+    ensemble.EnableHTML( true );
+    ensemble.SetMargin( 10 );
+    return true;
+  }
+  if ( a == "-P" ) {
+    ensemble.EnablePNG( true );
+    return true;
+  }
+  return false;
+}
+
+// Handle the options giving the rendering budget; returns false if a is not
+// such an option.
+bool do_budget_option( const std::string& a, double& ms, uint64_t& bytes )
+{
+  if ( a.rfind( "--budget-ms=", 0 ) == 0 ) {
+    char* end;
+    ms = std::strtod( a.c_str() + 12, &end );
+    if ( *end != '\0' || a.size() == 12 || !(ms >= 0) ) {
+      source.Err( "invalid time budget '" + a.substr( 12 ) + "'" );
+    }
+    return true;
+  }
+  if ( a.rfind( "--budget-bytes=", 0 ) == 0 ) {
+    char* end;
+    bytes = std::strtoull( a.c_str() + 15, &end, 10 );
+    if ( *end != '\0' || a.size() == 15 ) {
+      source.Err( "invalid size budget '" + a.substr( 15 ) + "'" );
+    }
+    return true;
+  }
+  return false;
+}
+
+// Rendering budget given on the command line; 0 means no limit. A --serve
+// request or --batch job may give its own.
+double budget_ms = 0;
+uint64_t budget_bytes = 0;
+
+// Set the rendering budget; returns the corresponding options, which are part
+// of the output cache key.
+std::string set_budget( double ms, uint64_t bytes )
+{
+  budget.SetTime( ms );
+  budget.SetBytes( bytes );
+  std::string options;
+  if ( ms > 0 ) options += "--budget-ms=" + std::to_string( ms ) + ' ';
+  if ( bytes > 0 ) options += "--budget-bytes=" + std::to_string( bytes ) + ' ';
+  return options;
+}
+
+// Lower the level of detail as needed for the rendering started at t0 to stay
+// within the budget; the chosen settings are reported on stderr.
+void apply_budget( std::chrono::steady_clock::time_point t0 )
+{
+  if ( !budget.Enabled() ) return;
+  Chart::Profile::Scope prof( "Budget" );
+  std::chrono::duration< double, std::milli > elapsed =
+    std::chrono::steady_clock::now() - t0;
+  budget.Apply( elapsed.count(), std::cerr );
+}
+
+// Output cache shared by all renderings; nullptr if disabled.
+Chart::Cache* output_cache = nullptr;
+
+// Spacing of the checkpoints recorded for gzip compressed input files.
+uint64_t gzip_spacing = Chart::Source::buffer_size;
+
+// Memory for keeping evicted input segments compressed.
+uint64_t packed_max = 0;
+
+// Keep the first pass over the input files in sidecar files.
+bool use_sidecar = false;
+
+// Sidecars shared by the jobs of --batch or the renderings of --watch.
+Chart::Sidecar::Store* sidecar_store = nullptr;
+
+// Reuse the built charts from one rendering to the next on the same thread;
+// only enabled for --serve and --watch.
+bool reuse_charts = false;
+thread_local Chart::Ensemble::reuse_t kept_charts;
+
+// Give each chart a key for reuse made from the options, the specifier lines,
+// and the data blocks of the chart. Any change to the specifiers changes the
+// key of all charts, as they may affect any chart.
+void set_reuse_keys( const std::string& options )
+{
+  std::string spec = spec_hash.Hex();
+  for ( auto& elem : ensemble.grid.element_list ) {
+    Chart::Main* chart = elem.chart;
+    if ( chart == nullptr ) continue;
+    chart->reuse_key.clear();
+    Chart::ContentHash hash;
+    hash.Add( std::string_view( chartus_version ) );
+    hash.Add( options );
+    hash.Add( spec );
+    if ( chart->id < chart_data.size() ) {
+      if ( !chart_data[ chart->id ].known ) continue;
+      hash.Add( chart_data[ chart->id ].hash.Hex() );
+    }
+    chart->reuse_key = hash.Hex();
+  }
+}
+
+// Read the files added to the source, parse them, and build the output. The
+// options are the output affecting command line options, which together with
+// the input make up the output cache key.
+std::string render( const std::string& options )
+{
+  auto t0 = std::chrono::steady_clock::now();
+  if ( output_cache ) source.SetHashContent();
+
+  {
+    Chart::Profile::Scope prof( "ReadFiles" );
+    source.ReadFiles();
+  }
+
+  std::string key;
+  if ( output_cache ) {
+    Chart::ContentHash hash{ source.GetContentHash() };
+    hash.Add( std::string_view( chartus_version ) );
+    hash.Add( options );
+    key = hash.Hex();
+    std::string out;
+    if ( output_cache->Get( key, out ) ) return out;
+  }
+
+  // The level of detail chosen by a budget depends on all of the charts, so
+  // charts are then not reused.
+  bool reuse = reuse_charts && !budget.Enabled();
+  if ( reuse ) source.SetLineHash( &spec_hash );
+  {
+    Chart::Profile::Scope prof( "parse_lines" );
+    parse_lines();
+  }
+  source.SetLineHash( nullptr );
+  apply_budget( t0 );
+
+  if ( reuse ) {
+    set_reuse_keys( options );
+    ensemble.SetReuse( &kept_charts );
+  }
+
+  std::string out;
+  {
+    Chart::Profile::Scope prof( "Ensemble::Build" );
+    out = ensemble.Build();
+  }
+
+  if ( output_cache ) output_cache->Put( key, out );
+  return out;
+}
+
+// Read and parse the input once and write the output to each of the given
+// files (empty names are skipped) from a single build. The output cache is not
+// used, as the SVG and PNG outputs are drawn with HTML enabled if an HTML file
+// is requested too.
+void render_files(
+  const std::string& svg_name,
+  const std::string& html_name,
+  const std::string& png_name
+)
+{
+  auto t0 = std::chrono::steady_clock::now();
+  if ( !html_name.empty() ) {
+    ensemble.EnableHTML( true );
+    ensemble.SetMargin( 10 );
+  }
+
+  {
+    Chart::Profile::Scope prof( "ReadFiles" );
+    source.ReadFiles();
+  }
+  {
+    Chart::Profile::Scope prof( "parse_lines" );
+    parse_lines();
+  }
+  apply_budget( t0 );
+
+  std::ofstream svg_file;
+  std::ofstream html_file;
+  std::ofstream png_file;
+  auto open = [&]( std::ofstream& f, const std::string& name )
+  {
+    if ( name.empty() ) return static_cast< std::ofstream* >( nullptr );
+    f.open( name, std::ios::binary );
+    if ( !f ) source.Err( "failed to open file '" + name + "'" );
+    return &f;
+  };
+  std::ofstream* svg = open( svg_file, svg_name );
+  std::ofstream* html = open( html_file, html_name );
+  std::ofstream* png = open( png_file, png_name );
+
+  {
+    Chart::Profile::Scope prof( "Ensemble::Build" );
+    ensemble.Build( svg, html, png );
+  }
+
+  auto close = [&]( std::ofstream& f, const std::string& name )
+  {
+    if ( name.empty() ) return;
+    f.close();
+    if ( !f ) source.Err( "failed to write file '" + name + "'" );
+  };
+  close( svg_file, svg_name );
+  close( html_file, html_name );
+  close( png_file, png_name );
+}
+
+// Read and parse the input once and write each chart to a file of its own,
+// named by replacing %d in pattern with the chart number (0 for the first
+// chart), and the shared legend, if any, to the file named by replacing %d
+// with "legend". The output is PNG if pattern ends with .png, otherwise SVG.
+void render_split( const std::string& pattern )
+{
+  auto t0 = std::chrono::steady_clock::now();
+  size_t pos = pattern.find( "%d" );
+  if ( pos == std::string::npos ) {
+    source.Err( "--split pattern '" + pattern + "' must contain %d" );
+  }
+  bool png =
+    pattern.size() >= 4 &&
+    pattern.compare( pattern.size() - 4, 4, ".png" ) == 0;
+
+  {
+    Chart::Profile::Scope prof( "ReadFiles" );
+    source.ReadFiles();
+  }
+  {
+    Chart::Profile::Scope prof( "parse_lines" );
+    parse_lines();
+  }
+  apply_budget( t0 );
+
+  std::vector< std::string > docs;
+  std::string legend;
+  {
+    Chart::Profile::Scope prof( "Ensemble::BuildSplit" );
+    try {
+      docs = ensemble.BuildSplit( png, legend );
+    } catch ( const std::exception& e ) {
+      source.Err( std::string( "--split failed: " ) + e.what() );
+    }
+  }
+
+  Chart::Profile::Scope prof( "Output" );
+  auto write = [&]( const std::string& id, const std::string& doc )
+  {
+    std::string name = pattern;
+    name.replace( pos, 2, id );
+    std::ofstream f( name, std::ios::binary );
+    f << doc;
+    f.close();
+    if ( !f ) source.Err( "failed to write file '" + name + "'" );
+  };
+  for ( size_t i = 0; i < docs.size(); ++i ) {
+    write( std::to_string( i ), docs[ i ] );
+  }
+  if ( !legend.empty() ) write( "legend", legend );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Return the thread local rendering state to that of a fresh thread, except
+// that the buffers of the source are kept for reuse.
+void reset_render_state( void )
+{
+  budget.~Budget();
+  ensemble.~Ensemble();
+  source.Reset();
+  new ( &ensemble ) Chart::Ensemble{ &source };
+  new ( &budget ) Chart::Budget{ &ensemble };
+
+  grid_max_defined = false;
+  grid_max_row = 0;
+  grid_max_col = 0;
+  cur_chart_in_chart = false;
+  embedding_row1 = 0;
+  embedding_col1 = 0;
+  embedding_row2 = 0;
+  embedding_col2 = 0;
+  chart_area_w = 1000;
+  chart_area_h = 600;
+  footnote_pos = Chart::Pos::Auto;
+  state.~state_t();
+  new ( &state ) state_t{};
+  non_newed_chart = false;
+  context_chart = 0;
+  datasets.clear();
+  spec_hash = Chart::ContentHash{};
+  chart_data.clear();
+}
+
+// Render a single --serve request or --batch job given by the command line
+// style arguments in args; the input stream is read for the file name "-".
+// May be called repeatedly on the same thread, as the thread local rendering
+// state is reset first. Returns true with the output in out, or false with the
+// error message in out.
+bool render_request(
+  const std::vector< std::string >& args, std::istream& input,
+  std::string& out
+)
+{
+  reset_render_state();
+  source.SetThrowErrors();
+  source.SetStdin( &input );
+  source.SetGzipSpacing( gzip_spacing );
+  source.SetPackedMax( packed_max );
+  source.SetSidecar( use_sidecar );
+  source.SetSidecarStore( sidecar_store );
+
+  // The SIGFPE handler can only recover the main thread, so floating point
+  // exceptions are detected after the fact instead of trapped.
+  fedisableexcept( FE_ALL_EXCEPT );
+  feclearexcept( FE_ALL_EXCEPT );
+
+  try {
+    bool out_of_options = false;
+    std::string options;
+    double ms = budget_ms;
+    uint64_t bytes = budget_bytes;
+    for ( const auto& a : args ) {
+      if ( a == "--" && !out_of_options ) {
+        out_of_options = true;
+        continue;
+      }
+      if ( !out_of_options ) {
+        if ( do_format_option( a ) ) {
+          options += a + ' ';
+          continue;
+        }
+        if ( do_budget_option( a, ms, bytes ) ) continue;
+        if ( a != "-" && a[ 0 ] == '-' ) {
+          source.Err( "Unsupported option '" + a + "' in request" );
+        }
+      }
+      source.AddFile( a );
+    }
+    options += set_budget( ms, bytes );
+    out = render( options );
+    if ( fetestexcept( FE_DIVBYZERO | FE_INVALID ) ) {
+      source.Err( "Floating point exception" );
+    }
+  } catch ( const Chart::Error& e ) {
+    out = e.what();
+    return false;
+  } catch ( const std::exception& e ) {
+    out = std::string( "*** ERROR: " ) + e.what() + "\n";
+    return false;
+  }
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Render the jobs listed in file_name. Each line holds an output file name
+// followed by one or more input files; the output format is given by the
+// extension of the output file name. Jobs are picked up dynamically by one
+// runner per CPU, and a failing job is reported without affecting the others.
+// The first pass over an input file and its parsed data blocks are shared by
+// the jobs reading it through an in-memory sidecar store. Returns the number
+// of failed jobs.
+size_t do_batch( const std::string& file_name )
+{
+  struct job_t {
+    std::string out_name;
+    std::vector< std::string > args;
+  };
+  std::vector< job_t > jobs;
+
+  std::ifstream file( file_name );
+  if ( !file ) {
+    source.Err( "failed to open file '" + file_name + "'" );
+  }
+  std::string line;
+  for ( size_t line_num = 1; std::getline( file, line ); ++line_num ) {
+    std::istringstream words( line );
+    std::string word;
+    job_t job;
+    while ( words >> word ) {
+      if ( word[ 0 ] == '#' ) break;
+      if ( job.out_name.empty() ) {
+        job.out_name = word;
+        auto ends_with = [&]( const std::string& ext )
+        {
+          return
+            word.size() >= ext.size() &&
+            word.compare( word.size() - ext.size(), ext.size(), ext ) == 0;
+        };
+        if ( ends_with( ".html" ) || ends_with( ".htm" ) ) {
+          job.args.push_back( "-H" );
+        } else
+        if ( ends_with( ".png" ) ) {
+          job.args.push_back( "-P" );
+        }
+        job.args.push_back( "--" );
+        continue;
+      }
+      if ( word == "-" ) {
+        source.Err(
+          file_name + " line " + std::to_string( line_num ) +
+          ": standard input cannot be used in batch jobs"
+        );
+      }
+      job.args.push_back( word );
+    }
+    if ( job.out_name.empty() ) continue;
+    if ( job.args.back() == "--" ) {
+      source.Err(
+        file_name + " line " + std::to_string( line_num ) +
+        ": input file expected"
+      );
+    }
+    jobs.push_back( std::move( job ) );
+  }
+
+  std::mutex err_mutex;
+  std::atomic< size_t > next_job{ 0 };
+  std::atomic< size_t > failed{ 0 };
+
+  auto runner = [&]()
+  {
+    while ( true ) {
+      size_t i = next_job++;
+      if ( i >= jobs.size() ) break;
+      const job_t& job = jobs[ i ];
+      std::istringstream no_input;
+      std::string out;
+      bool ok = render_request( job.args, no_input, out );
+      if ( ok ) {
+        std::ofstream f( job.out_name, std::ios::binary );
+        f << out;
+        if ( !f.flush() ) {
+          out = "*** ERROR: failed to write file '" + job.out_name + "'\n";
+          ok = false;
+        }
+      }
+      if ( !ok ) {
+        failed++;
+        std::lock_guard< std::mutex > lk( err_mutex );
+        std::cerr << job.out_name << ":\n" << out << std::flush;
+      }
+    }
+  };
+
+  Chart::Sidecar::Store store;
+  sidecar_store = &store;
+
+  std::vector< std::thread > runners;
+  uint32_t num = std::max( 1u, std::thread::hardware_concurrency() );
+  num = std::min< size_t >( num, jobs.size() );
+  for ( uint32_t n = 0; n < num; ++n ) {
+    runners.emplace_back( runner );
+  }
+  for ( auto& t : runners ) t.join();
+  sidecar_store = nullptr;
+
+  if ( failed > 0 ) {
+    std::cerr
+      << "*** " << failed << " of " << jobs.size() << " jobs failed"
+      << std::endl;
+  }
+  return failed;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Render the given input files to out_name, and render again whenever one of
+// the input files changes (as indicated by size and modification time). The
+// output file is replaced atomically, so readers never see a partial file.
+// The input read is kept between renderings, so that only the lines appended
+// to the last file are read and scanned, and the data blocks parsed are kept
+// in sidecars held in memory; charts whose data blocks are unchanged are
+// reused as built. Never returns.
+void do_watch(
+  const std::string& out_name,
+  const std::vector< std::string >& format_args,
+  const std::vector< std::string >& file_args
+)
+{
+  if ( file_args.empty() ) {
+    source.Err( "--watch requires input files" );
+  }
+  for ( const auto& f : file_args ) {
+    if ( f == "-" ) source.Err( "--watch cannot watch standard input" );
+  }
+
+  Chart::Sidecar::Store store;
+  sidecar_store = &store;
+  source.SetKeepFiles();
+
+  std::vector< std::string > args{ format_args };
+  args.push_back( "--" );
+  args.insert( args.end(), file_args.begin(), file_args.end() );
+
+  struct stamp_t {
+    std::uintmax_t size = 0;
+    std::filesystem::file_time_type time;
+    bool operator==( const stamp_t& other ) const {
+      return size == other.size && time == other.time;
+    }
+  };
+  auto get_stamps = [&]()
+  {
+    std::vector< stamp_t > stamps;
+    for ( const auto& f : file_args ) {
+      std::error_code ec;
+      stamp_t stamp;
+      stamp.size = std::filesystem::file_size( f, ec );
+      stamp.time = std::filesystem::last_write_time( f, ec );
+      stamps.push_back( stamp );
+    }
+    return stamps;
+  };
+
+  std::vector< stamp_t > rendered;
+  bool first = true;
+  while ( true ) {
+    std::vector< stamp_t > stamps = get_stamps();
+    if ( first || stamps != rendered ) {
+      first = false;
+      rendered = stamps;
+      std::istringstream no_input;
+      std::string out;
+      bool ok = render_request( args, no_input, out );
+      if ( ok ) {
+        std::string tmp_name = out_name + ".tmp";
+        std::ofstream f( tmp_name, std::ios::binary );
+        f << out;
+        f.close();
+        if ( !f || std::rename( tmp_name.c_str(), out_name.c_str() ) != 0 ) {
+          std::cerr
+            << "*** ERROR: failed to write file '" << out_name << "'"
+            << std::endl;
+        }
+      } else {
+        std::cerr << out << std::flush;
+      }
+    }
+    std::this_thread::sleep_for( std::chrono::milliseconds( 250 ) );
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -2346,6 +3467,19 @@ int main( int argc, char* argv[] )
   feenableexcept( FE_DIVBYZERO | FE_INVALID );
 
   bool out_of_options = false;
+  bool show_stats = false;
+  std::string watch_out;
+  std::string batch_file;
+  std::string serve_path;
+  std::string svg_name;
+  std::string html_name;
+  std::string png_name;
+  std::string split_pattern;
+  std::string cache_dir;
+  uint64_t cache_max_mb = 1000;
+  uint64_t serve_max_mb = 256;
+  std::vector< std::string > format_args;
+  std::vector< std::string > file_args;
   for ( int i = 1; i < argc; i++ ) {
     std::string a( argv[ i ] );
     if ( a == "--" ) {
@@ -2353,9 +3487,93 @@ int main( int argc, char* argv[] )
       continue;
     }
     if ( !out_of_options ) {
-      if ( a == "-H" ) {
-        ensemble.EnableHTML( true );
-        ensemble.SetMargin( 10 );
+      if ( do_format_option( a ) ) {
+        format_args.push_back( a );
+        continue;
+      }
+      if ( do_budget_option( a, budget_ms, budget_bytes ) ) continue;
+      if ( a.rfind( "--watch=", 0 ) == 0 ) {
+        watch_out = a.substr( 8 );
+        continue;
+      }
+      if ( a.rfind( "--svg=", 0 ) == 0 ) {
+        svg_name = a.substr( 6 );
+        continue;
+      }
+      if ( a.rfind( "--html=", 0 ) == 0 ) {
+        html_name = a.substr( 7 );
+        continue;
+      }
+      if ( a.rfind( "--png=", 0 ) == 0 ) {
+        png_name = a.substr( 6 );
+        continue;
+      }
+      if ( a.rfind( "--split=", 0 ) == 0 ) {
+        split_pattern = a.substr( 8 );
+        ensemble.EnableSplit();
+        continue;
+      }
+      if ( a.rfind( "--cache=", 0 ) == 0 ) {
+        cache_dir = a.substr( 8 );
+        continue;
+      }
+      if ( a.rfind( "--cache-max=", 0 ) == 0 ) {
+        char* end;
+        cache_max_mb = std::strtoull( a.c_str() + 12, &end, 10 );
+        if ( *end != '\0' || a.size() == 12 ) {
+          source.Err( "invalid cache size '" + a.substr( 12 ) + "'" );
+        }
+        continue;
+      }
+      if ( a.rfind( "--serve-max=", 0 ) == 0 ) {
+        char* end;
+        serve_max_mb = std::strtoull( a.c_str() + 12, &end, 10 );
+        if ( *end != '\0' || a.size() == 12 ) {
+          source.Err( "invalid request size '" + a.substr( 12 ) + "'" );
+        }
+        continue;
+      }
+      if ( a.rfind( "--gzip-spacing=", 0 ) == 0 ) {
+        char* end;
+        gzip_spacing = std::strtoull( a.c_str() + 15, &end, 10 ) << 20;
+        if ( *end != '\0' || a.size() == 15 ) {
+          source.Err( "invalid gzip spacing '" + a.substr( 15 ) + "'" );
+        }
+        source.SetGzipSpacing( gzip_spacing );
+        continue;
+      }
+      if ( a.rfind( "--packed-max=", 0 ) == 0 ) {
+        char* end;
+        packed_max = std::strtoull( a.c_str() + 13, &end, 10 ) << 20;
+        if ( *end != '\0' || a.size() == 13 ) {
+          source.Err( "invalid packed size '" + a.substr( 13 ) + "'" );
+        }
+        source.SetPackedMax( packed_max );
+        continue;
+      }
+      if ( a == "--sidecar" ) {
+        use_sidecar = true;
+        source.SetSidecar( use_sidecar );
+        continue;
+      }
+      if ( a.rfind( "--profile=", 0 ) == 0 ) {
+        Chart::Profile::Enable( a.substr( 10 ) );
+        continue;
+      }
+      if ( a.rfind( "--gen=", 0 ) == 0 ) {
+        gen_bench( a.substr( 6 ) );
+        return 0;
+      }
+      if ( a.rfind( "--batch=", 0 ) == 0 ) {
+        batch_file = a.substr( 8 );
+        continue;
+      }
+      if ( a.rfind( "--serve=", 0 ) == 0 ) {
+        serve_path = a.substr( 8 );
+        continue;
+      }
+      if ( a == "--stats" ) {
+        show_stats = true;
         continue;
       }
       if ( a == "-v" || a == "--version" ) {
@@ -2423,14 +3641,79 @@ int main( int argc, char* argv[] )
       }
     }
     source.AddFile( a );
+    file_args.push_back( a );
+  }
+
+  bool to_files = !svg_name.empty() || !html_name.empty() || !png_name.empty();
+  if ( to_files ) {
+    if ( !serve_path.empty() || !batch_file.empty() || !watch_out.empty() ) {
+      source.Err(
+        "--svg, --html, and --png cannot be combined with "
+        "--serve, --batch, or --watch"
+      );
+    }
+    if ( !format_args.empty() ) {
+      source.Err( "--svg, --html, and --png cannot be combined with -H or -P" );
+    }
+  }
+  if ( !split_pattern.empty() ) {
+    if (
+      to_files || !format_args.empty() || !serve_path.empty() ||
+      !batch_file.empty() || !watch_out.empty()
+    ) {
+      source.Err( "--split cannot be combined with other output options" );
+    }
   }
 
-  source.ReadFiles();
+  if ( !cache_dir.empty() ) {
+    output_cache = new Chart::Cache( cache_dir, cache_max_mb << 20 );
+  }
 
-  parse_lines();
+  if ( !serve_path.empty() ) {
+    reuse_charts = true;
+    std::string err;
+    Chart::Server::Run(
+      serve_path, std::max( 1u, std::thread::hardware_concurrency() ),
+      serve_max_mb << 20,
+      render_request, err
+    );
+    source.Err( err );
+  }
 
-  std::cout << ensemble.Build();
+  if ( !batch_file.empty() ) {
+    source.Quit( (do_batch( batch_file ) > 0) ? 1 : 0 );
+  }
 
+  if ( !watch_out.empty() ) {
+    reuse_charts = true;
+    do_watch( watch_out, format_args, file_args );
+  }
+
+  if ( !split_pattern.empty() ) {
+    set_budget( budget_ms, budget_bytes );
+    render_split( split_pattern );
+  } else
+  if ( to_files ) {
+    set_budget( budget_ms, budget_bytes );
+    render_files( svg_name, html_name, png_name );
+  } else {
+    std::string options;
+    for ( const auto& a : format_args ) options += a + ' ';
+    options += set_budget( budget_ms, budget_bytes );
+    std::string out = render( options );
+    Chart::Profile::Scope prof( "Output" );
+    std::cout << out;
+  }
+
+  Chart::Profile::Finish();
+  if ( show_stats ) {
+    // Note that ru_maxrss is in kilobytes on Linux but in bytes on macOS.
+    struct rusage usage;
+    getrusage( RUSAGE_SELF, &usage );
+    std::cerr << "{\"source\":";
+    source.PrintStats( std::cerr );
+    std::cerr << ",\"peak_rss_kb\":" << usage.ru_maxrss << "}" << std::endl;
+  }
   source.Quit( 0 );
 }
 